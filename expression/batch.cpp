@@ -0,0 +1,629 @@
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iostream>
+#include <type_traits>
+#include <utility>
+
+#include "batch.h"
+#include "operations.h"
+#include "operators.h"
+
+namespace
+{
+	template <size_t... I>
+	constexpr std::array<size_t, sizeof...(I)> make_value_sizes(std::index_sequence<I...>)
+	{
+		return { sizeof(value_t<I>)... };
+	}
+
+	constexpr auto value_sizes = make_value_sizes(std::make_index_sequence<value_type_count>{});
+
+	template <size_t I>
+	token_value load_value(const void* data, size_t row)
+	{
+		return static_cast<const value_t<I>*>(data)[row];
+	}
+
+	template <size_t... I>
+	constexpr std::array<token_value (*)(const void*, size_t), sizeof...(I)> make_value_loaders(std::index_sequence<I...>)
+	{
+		return { &load_value<I>... };
+	}
+
+	constexpr auto value_loaders = make_value_loaders(std::make_index_sequence<value_type_count>{});
+
+	// The value of a row that skips the operation, without an error. The rows
+	// that skip && and || are those their left operand decides, which get its
+	// value as the vm does.
+	template <typename operation, typename T1, typename T2>
+	auto skipped_value(T1 a, T2 b)
+	{
+		using R = operators::binary_result_t<operation, T1, T2>;
+		if constexpr (std::is_same_v<operation, operators::logical_and> || std::is_same_v<operation, operators::logical_or>)
+		{
+			return static_cast<R>(std::is_same_v<operation, operators::logical_or>);
+		}
+		else if constexpr (!operation::template defined<T1, T2>)
+		{
+			return static_cast<R>(operation::fallback(a, b));
+		}
+		else
+		{
+			if (operation::check(a, b))
+				return static_cast<R>(operation::fallback(a, b));
+			return static_cast<R>(operation::apply(a, b));
+		}
+	}
+
+	template <typename operation, typename T1, typename T2, bool scalar>
+	const char* binary_kernel(const void* left, const void* right, void* result, size_t count, const bool* active)
+	{
+		using R = operators::binary_result_t<operation, T1, T2>;
+		auto a = static_cast<const T1*>(left);
+		auto b = static_cast<const T2*>(right);
+		auto r = static_cast<R*>(result);
+		const char* message{ nullptr };
+		for (size_t i = 0; i < count; ++i)
+		{
+			T2 rhs = scalar ? b[0] : b[i];
+			if (active && !active[i])
+			{
+				r[i] = skipped_value<operation>(a[i], rhs);
+				continue;
+			}
+			if constexpr (operation::template defined<T1, T2>)
+			{
+				if (auto failed = operation::check(a[i], rhs))
+				{
+					message = failed;
+					r[i] = static_cast<R>(operation::fallback(a[i], rhs));
+					continue;
+				}
+				r[i] = operation::apply(a[i], rhs);
+			}
+			else
+			{
+				r[i] = static_cast<R>(operation::fallback(a[i], rhs));
+			}
+		}
+		return message;
+	}
+
+	template <typename operation, typename T>
+	void unary_kernel(const void* value, void* result, size_t count)
+	{
+		using R = operators::unary_result_t<operation, T>;
+		auto a = static_cast<const T*>(value);
+		auto r = static_cast<R*>(result);
+		for (size_t i = 0; i < count; ++i)
+		{
+			if constexpr (operation::template defined<T>)
+				r[i] = operation::apply(a[i]);
+			else
+				r[i] = static_cast<R>(operation::fallback(a[i]));
+		}
+	}
+
+	// Kernels, result types and validity of an operator for every pair of
+	// operand types, indexed by left type * value_type_count + right type.
+	template <typename operation>
+	struct binary_kernels
+	{
+		template <bool scalar, size_t... I>
+		static constexpr std::array<batch::binary_kernel, sizeof...(I)> kernels(std::index_sequence<I...>)
+		{
+			return { &binary_kernel<operation, value_t<I / value_type_count>, value_t<I % value_type_count>, scalar>... };
+		}
+		static constexpr auto pairs = std::make_index_sequence<value_type_count * value_type_count>{};
+		static constexpr auto vector_kernels = kernels<false>(pairs);
+		static constexpr auto scalar_kernels = kernels<true>(pairs);
+		static constexpr auto& result_types = operators::binary_types<operation>::result;
+		static constexpr auto& defined_types = operators::binary_types<operation>::defined;
+	};
+
+	template <typename operation>
+	struct unary_kernels
+	{
+		template <size_t... I>
+		static constexpr std::array<batch::unary_kernel, sizeof...(I)> kernels(std::index_sequence<I...>)
+		{
+			return { &unary_kernel<operation, value_t<I>>... };
+		}
+		static constexpr auto values = std::make_index_sequence<value_type_count>{};
+		static constexpr auto unary_kernels_ = kernels(values);
+		static constexpr auto& result_types = operators::unary_types<operation>::result;
+		static constexpr auto& defined_types = operators::unary_types<operation>::defined;
+	};
+
+	struct binary_plan
+	{
+		batch::binary_kernel kernel;
+		simd_binary_kernel simd;
+		size_t type;
+		bool defined;
+		const char* message;
+		token_kind op;
+		size_t left_type;
+		size_t right_type;
+	};
+
+	template <typename operation>
+	binary_plan plan_binary(token_kind kind, size_t left_type, size_t right_type, bool scalar)
+	{
+		using table = binary_kernels<operation>;
+		auto index = left_type * value_type_count + right_type;
+		simd_binary_kernel simd{ nullptr };
+		if (table::defined_types[index] && left_type == right_type)
+			simd = find_simd_binary_kernel(kind, simd_type_of(left_type), scalar);
+		auto kernel = scalar ? table::scalar_kernels[index] : table::vector_kernels[index];
+		return { kernel, simd, table::result_types[index], table::defined_types[index], operation::message, kind,
+			left_type, right_type };
+	}
+
+	struct unary_plan
+	{
+		batch::unary_kernel kernel;
+		simd_unary_kernel simd;
+		size_t type;
+		bool defined;
+		const char* message;
+		token_kind op;
+		size_t value_type;
+	};
+
+	template <typename operation>
+	unary_plan plan_unary(token_kind kind, size_t type)
+	{
+		using table = unary_kernels<operation>;
+		simd_unary_kernel simd{ nullptr };
+		if (table::defined_types[type])
+			simd = find_simd_unary_kernel(kind, simd_type_of(type));
+		return { table::unary_kernels_[type], simd, table::result_types[type], table::defined_types[type], operation::message,
+			kind, type };
+	}
+
+	template <typename T>
+	void truth_kernel(const void* value, void* result, size_t count)
+	{
+		auto a = static_cast<const T*>(value);
+		auto r = static_cast<bool*>(result);
+		for (size_t i = 0; i < count; ++i)
+			r[i] = static_cast<bool>(a[i]);
+	}
+
+	template <size_t... I>
+	constexpr std::array<batch::unary_kernel, sizeof...(I)> make_truth_kernels(std::index_sequence<I...>)
+	{
+		return { &truth_kernel<value_t<I>>... };
+	}
+
+	constexpr auto truth_kernels = make_truth_kernels(std::make_index_sequence<value_type_count>{});
+
+	// Values are selected as unsigned integers of their size.
+	template <typename T>
+	void select_kernel(const bool* condition, const void* then_values, const void* else_values, void* result, size_t count)
+	{
+		auto t = static_cast<const T*>(then_values);
+		auto e = static_cast<const T*>(else_values);
+		auto r = static_cast<T*>(result);
+		for (size_t i = 0; i < count; ++i)
+			r[i] = condition[i] ? t[i] : e[i];
+	}
+
+	void select(const bool* condition, const void* then_values, const void* else_values, void* result, size_t count,
+		size_t width)
+	{
+		switch (width)
+		{
+		case 1:
+			select_kernel<std::uint8_t>(condition, then_values, else_values, result, count);
+			break;
+		case 2:
+			select_kernel<std::uint16_t>(condition, then_values, else_values, result, count);
+			break;
+		case 4:
+			select_kernel<std::uint32_t>(condition, then_values, else_values, result, count);
+			break;
+		default:
+			select_kernel<std::uint64_t>(condition, then_values, else_values, result, count);
+			break;
+		}
+	}
+
+	// The rows of parent, all if it is nullptr, for which truth is not negate.
+	void mask_kernel(const bool* parent, const bool* truth, bool negate, bool* result, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+			result[i] = truth[i] != negate && (!parent || parent[i]);
+	}
+
+	bool any_active(const bool* active, size_t count)
+	{
+		return !active || std::find(active, active + count, true) != active + count;
+	}
+
+	const void* value_address(const token_value& value)
+	{
+		return std::visit([](const auto& alternative) -> const void*
+		{
+			return &alternative;
+		}, value);
+	}
+
+	const void* column_data(const column& column, size_t row)
+	{
+		return static_cast<const std::byte*>(column.data()) + row * value_sizes[column.type()];
+	}
+
+	const void* advance(const void* data, size_t bytes)
+	{
+		return static_cast<const std::byte*>(data) + bytes;
+	}
+
+	void* advance(void* data, size_t bytes)
+	{
+		return static_cast<std::byte*>(data) + bytes;
+	}
+}
+
+token_value result_column::value(size_t row) const
+{
+	return value_loaders[_type](_storage.data(), row);
+}
+
+bool batch::execute(const bytecode& program, std::span<const column> columns, result_column& result)
+{
+	_errors = 0;
+	if (program.code().empty())
+		return false;
+	if (!check_columns(program, columns))
+	{
+		write_own_diagnostics();
+		return false;
+	}
+	auto rows = columns.empty() ? 0 : columns[0].size();
+	plan(program, columns);
+
+	_buffers.resize(program.register_count());
+	for (auto& buffer : _buffers)
+		buffer.resize(batch_size);
+	_scratch.resize(batch_size);
+	_registers.resize(program.register_count());
+	result._type = _steps.back().type;
+	result._size = rows;
+	auto size = value_sizes[result._type];
+	result._storage.resize((rows * size + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t));
+	auto out = reinterpret_cast<std::byte*>(result._storage.data());
+
+	for (size_t start = 0; start < rows; start += batch_size)
+	{
+		auto count = std::min(batch_size, rows - start);
+		for (size_t index = 0; index < _steps.size(); ++index)
+		{
+			auto& step = _steps[index];
+			switch (step.kind)
+			{
+			case step_kind::LOAD_CONST:
+				_registers[step.dst] = step.constant;
+				break;
+			case step_kind::LOAD_VAR:
+				_registers[step.dst] = column_data(columns[step.a], start);
+				break;
+			case step_kind::MOVE:
+				// Copied, as the buffer of the source register is reused.
+				std::memcpy(_buffers[step.dst].data(), _registers[step.a], count * step.width);
+				_registers[step.dst] = _buffers[step.dst].data();
+				break;
+			case step_kind::BINARY:
+			{
+				EXPRESSION_PROFILE_ROWS(step.op, step.left_type, step.right_type, _errors, count);
+				auto active = mask(step);
+				if (step.message && !step.reported && any_active(active, count))
+				{
+					error(program, step.instruction, step.message);
+					step.reported = true;
+				}
+				auto left = step.left == source::COLUMN ? column_data(columns[step.a], start) : _registers[step.a];
+				auto right = step.right == source::CONSTANT ? step.constant : _registers[step.b];
+				size_t done{ 0 };
+				if (step.simd_binary)
+				{
+					done = step.simd_binary(left, right, _scratch.data(), count);
+					left = advance(left, done * step.width);
+					if (step.right != source::CONSTANT)
+						right = advance(right, done * step.width);
+				}
+				auto message = step.binary(left, right, advance(_scratch.data(), done * value_sizes[step.type]), count - done,
+					active ? active + done : nullptr);
+				if (message && !step.reported)
+				{
+					error(program, step.instruction, message);
+					step.reported = true;
+				}
+				std::swap(_buffers[step.dst], _scratch);
+				_registers[step.dst] = _buffers[step.dst].data();
+				break;
+			}
+			case step_kind::UNARY:
+			{
+				EXPRESSION_PROFILE_ROWS(step.op, step.left_type, step.right_type, _errors, count);
+				if (step.message && !step.reported && any_active(mask(step), count))
+				{
+					error(program, step.instruction, step.message);
+					step.reported = true;
+				}
+				size_t done{ 0 };
+				if (step.simd_unary)
+					done = step.simd_unary(_registers[step.a], _scratch.data(), count);
+				step.unary(advance(_registers[step.a], done * step.width), advance(_scratch.data(), done * value_sizes[step.type]), count - done);
+				std::swap(_buffers[step.dst], _scratch);
+				_registers[step.dst] = _buffers[step.dst].data();
+				break;
+			}
+			case step_kind::TEST:
+				step.unary(_registers[step.a], _saved[step.b].data(), count);
+				break;
+			case step_kind::SAVE:
+				std::memcpy(_saved[step.b].data(), _registers[step.a], count * step.width);
+				break;
+			case step_kind::SELECT:
+				select(reinterpret_cast<const bool*>(_saved[step.a].data()), _saved[step.b].data(), _registers[step.dst],
+					_scratch.data(), count, step.width);
+				std::swap(_buffers[step.dst], _scratch);
+				_registers[step.dst] = _buffers[step.dst].data();
+				break;
+			case step_kind::MASK:
+				mask_kernel(mask(step), reinterpret_cast<const bool*>(_saved[step.a].data()), step.negate,
+					reinterpret_cast<bool*>(_saved[step.b].data()), count);
+				break;
+			case step_kind::RETURN:
+				std::memcpy(out + start * size, _registers[step.a], count * size);
+				break;
+			}
+		}
+	}
+	write_own_diagnostics();
+	return _errors == 0;
+}
+
+// A column for every slot, of its type, and all with as many rows as the
+// first. Errors are at the variable reading the column, or at the root if
+// none of the expression does.
+bool batch::check_columns(const bytecode& program, std::span<const column> columns)
+{
+	if (!check_slot_values(program.slot_types(), program.slot_positions(), columns.size(),
+		[&columns](size_t slot) { return columns[slot].type(); }, *_diagnostics))
+		return false;
+	for (size_t slot = 0; slot < columns.size(); ++slot)
+	{
+		if (columns[slot].size() != columns[0].size())
+		{
+			auto position = program.position(program.code().size() - 1);
+			if (slot < program.slot_count() && program.slot_positions()[slot].line != 0)
+				position = program.slot_positions()[slot];
+			_diagnostics->add("Column has another number of rows than the first.", position.line, position.column);
+			return false;
+		}
+	}
+	return true;
+}
+
+void batch::write_own_diagnostics()
+{
+	if (!_own_diagnostics.empty())
+	{
+		_own_diagnostics.write(std::cerr, {});
+		_own_diagnostics.clear();
+	}
+}
+
+bool batch::plan(const bytecode& program, std::span<const column> columns)
+{
+	const auto& code = program.code();
+	const auto& constants = program.constants();
+	std::vector<size_t> types(program.register_count());
+	// Conditionals whose values are not selected yet, the innermost last.
+	struct conditional
+	{
+		std::uint32_t reg;             // register of the value
+		std::uint32_t condition;       // saved buffer of the truth of the condition
+		std::uint32_t then_values;     // saved buffer of the values of the then branch
+		size_t then_type;
+		size_t jump;                   // the JUMP after the then branch, 0 before it
+		std::uint32_t mask;            // rows that compute the conditional
+	};
+	std::vector<conditional> conditionals;
+	// Where the operands and branches some rows skip end, and the rows that
+	// compute them, the innermost last.
+	struct region
+	{
+		size_t end;
+		std::uint32_t mask;
+	};
+	std::vector<region> skipped;
+	auto save = [&]()
+	{
+		_saved.emplace_back(batch_size);
+		return static_cast<std::uint32_t>(_saved.size() - 1);
+	};
+	// Adds the step that masks the rows of parent for which truth is not negate.
+	auto add_mask = [&](size_t index, std::uint32_t parent, std::uint32_t truth, bool negate)
+	{
+		step mask{ step_kind::MASK, source::REGISTER, source::REGISTER, 0, truth, save(), 0, nullptr, nullptr, nullptr,
+			nullptr, 0, nullptr, false };
+		mask.instruction = static_cast<std::uint32_t>(index);
+		mask.mask = parent;
+		mask.negate = negate;
+		_steps.push_back(mask);
+		return mask.b;
+	};
+	_steps.clear();
+	_broadcasts.clear();
+	_saved.clear();
+	for (size_t index = 0; index < code.size(); ++index)
+	{
+		const auto& instruction = code[index];
+		std::erase_if(skipped, [index](const region& region) { return region.end <= index; });
+		auto active = skipped.empty() ? no_mask : skipped.back().mask;
+		// The else branch of a conditional ends where its JUMP continues.
+		while (!conditionals.empty() && conditionals.back().jump != 0 && code[conditionals.back().jump].b == index)
+		{
+			const auto& conditional = conditionals.back();
+			auto type = types[conditional.reg];
+			if (type == conditional.then_type)
+			{
+				step select{ step_kind::SELECT, source::REGISTER, source::REGISTER, conditional.reg, conditional.condition,
+					conditional.then_values, type, nullptr, nullptr, nullptr, nullptr, value_sizes[type], nullptr, false };
+				select.instruction = static_cast<std::uint32_t>(conditional.jump);
+				_steps.push_back(select);
+			}
+			else
+			{
+				error(program, conditional.jump, "Conditional branches of different types");
+			}
+			conditionals.pop_back();
+		}
+		step step{ step_kind::BINARY, source::REGISTER, source::REGISTER, instruction.dst, instruction.a, instruction.b,
+			0, nullptr, nullptr, nullptr, nullptr, 0, nullptr, false };
+		step.instruction = static_cast<std::uint32_t>(index);
+		binary_plan binary{ nullptr, nullptr, 0, true, nullptr, token_kind::UNDEFINED, 0, 0 };
+		unary_plan unary{ nullptr, nullptr, 0, true, nullptr, token_kind::UNDEFINED, 0 };
+		switch (instruction.op)
+		{
+		case opcode::LOAD_CONST:
+		{
+			const auto& constant = constants[instruction.a];
+			auto& broadcast = _broadcasts.emplace_back(batch_size);
+			std::visit([&](auto value)
+			{
+				std::fill_n(reinterpret_cast<decltype(value)*>(broadcast.data()), batch_size, value);
+			}, constant);
+			step.kind = step_kind::LOAD_CONST;
+			step.type = constant.index();
+			step.constant = broadcast.data();
+			break;
+		}
+		case opcode::LOAD_VAR:
+			step.kind = step_kind::LOAD_VAR;
+			step.type = columns[instruction.a].type();
+			break;
+		case opcode::MOVE:
+			step.kind = step_kind::MOVE;
+			step.type = types[instruction.a];
+			step.width = value_sizes[step.type];
+			break;
+#define X(name, member, kind) \
+		case opcode::name: \
+			step.width = value_sizes[types[instruction.a]]; \
+			binary = plan_binary<operators::member>(token_kind::kind, types[instruction.a], types[instruction.b], false); \
+			break; \
+		case opcode::name##_K: \
+			step.right = source::CONSTANT; \
+			step.width = value_sizes[types[instruction.a]]; \
+			binary = plan_binary<operators::member>(token_kind::kind, types[instruction.a], constants[instruction.b].index(), true); \
+			break; \
+		case opcode::name##_VK: \
+			step.left = source::COLUMN; \
+			step.right = source::CONSTANT; \
+			step.width = value_sizes[columns[instruction.a].type()]; \
+			binary = plan_binary<operators::member>(token_kind::kind, columns[instruction.a].type(), constants[instruction.b].index(), true); \
+			break;
+		EXPRESSION_BINARY_OPERATIONS(X)
+#undef X
+#define X(name, member, kind) \
+		case opcode::name: \
+			step.width = value_sizes[types[instruction.a]]; \
+			unary = plan_unary<operators::member>(token_kind::kind, types[instruction.a]); \
+			break;
+		EXPRESSION_UNARY_OPERATIONS(X)
+#undef X
+		case opcode::JUMP_IF_FALSE:
+			step.kind = step_kind::TEST;
+			step.unary = truth_kernels[types[instruction.a]];
+			step.b = save();
+			_steps.push_back(step);
+			conditionals.push_back({ instruction.dst, step.b, 0, 0, 0, active });
+			skipped.push_back({ instruction.b, add_mask(index, active, step.b, false) });
+			continue;
+		case opcode::JUMP:
+		{
+			auto& conditional = conditionals.back();
+			conditional.then_values = save();
+			conditional.then_type = types[conditional.reg];
+			conditional.jump = index;
+			step.kind = step_kind::SAVE;
+			step.a = conditional.reg;
+			step.b = conditional.then_values;
+			step.width = value_sizes[conditional.then_type];
+			_steps.push_back(step);
+			skipped.push_back({ instruction.b, add_mask(index, conditional.mask, conditional.condition, true) });
+			continue;
+		}
+		case opcode::AND_JUMP:
+		case opcode::OR_JUMP:
+			// Both operands are computed, which gives the same values, but
+			// only the rows the left operand does not decide compute the
+			// right one. Operands && and || are not defined for decide nothing.
+			if (operations::is_logical_type(types[instruction.a]))
+			{
+				step.kind = step_kind::TEST;
+				step.unary = truth_kernels[types[instruction.a]];
+				step.b = save();
+				_steps.push_back(step);
+				active = add_mask(index, active, step.b, instruction.op == opcode::OR_JUMP);
+			}
+			skipped.push_back({ instruction.b, active });
+			continue;
+		case opcode::RETURN:
+			step.kind = step_kind::RETURN;
+			step.type = types[instruction.a];
+			break;
+		}
+		if (binary.kernel)
+		{
+			step.binary = binary.kernel;
+			step.simd_binary = binary.simd;
+			step.type = binary.type;
+			if (step.right == source::CONSTANT)
+				step.constant = value_address(constants[instruction.b]);
+			if (!binary.defined && active == no_mask)
+				error(program, index, binary.message);
+			else if (!binary.defined)
+				step.message = binary.message;
+#if EXPRESSION_PROFILE
+			step.op = binary.op;
+			step.left_type = binary.left_type;
+			step.right_type = binary.right_type;
+#endif
+		}
+		if (unary.kernel)
+		{
+			step.kind = step_kind::UNARY;
+			step.unary = unary.kernel;
+			step.simd_unary = unary.simd;
+			step.type = unary.type;
+			if (!unary.defined && active == no_mask)
+				error(program, index, unary.message);
+			else if (!unary.defined)
+				step.message = unary.message;
+#if EXPRESSION_PROFILE
+			step.op = unary.op;
+			step.left_type = unary.value_type;
+			step.right_type = profile_timer::no_operand;
+#endif
+		}
+		step.mask = active;
+		if (step.kind != step_kind::RETURN)
+			types[step.dst] = step.type;
+		_steps.push_back(step);
+	}
+	return _errors == 0;
+}
+
+void batch::error(const bytecode& program, size_t index, const char* message)
+{
+	const auto& position = program.position(index);
+	_diagnostics->add(message, position.line, position.column);
+	_errors++;
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "bytecode.h"
+#include "diagnostics.h"
+#include "profile.h"
+#include "simd.h"
+#include "token.h"
+
+// Number of rows every instruction processes at a time.
+constexpr size_t batch_size = 1024;
+
+// A contiguous array of values of one type, bound to a variable slot. The
+// column does not own the values.
+class column
+{
+public:
+	template <typename T>
+	column(std::span<const T> values) : _type{ value_index<T> }, _data{ values.data() }, _size{ values.size() }
+	{}
+	template <typename T>
+	column(const std::vector<T>& values) : column(std::span<const T>{ values })
+	{}
+	size_t type() const
+	{
+		return _type;
+	}
+	const void* data() const
+	{
+		return _data;
+	}
+	size_t size() const
+	{
+		return _size;
+	}
+private:
+	size_t _type;
+	const void* _data;
+	size_t _size;
+};
+
+// The values a program computed for every row. The type is the result type of
+// the program for the types of the bound columns.
+class result_column
+{
+public:
+	size_t type() const
+	{
+		return _type;
+	}
+	size_t size() const
+	{
+		return _size;
+	}
+	template <typename T>
+	std::span<const T> values() const
+	{
+		if (value_index<T> != _type)
+			return {};
+		return { reinterpret_cast<const T*>(_storage.data()), _size };
+	}
+	token_value value(size_t row) const;
+private:
+	friend class batch;
+	size_t _type{ 0 };
+	size_t _size{ 0 };
+	std::vector<std::uint64_t> _storage;
+};
+
+// Evaluates a program over columns instead of single values. Every
+// instruction runs over batch_size rows at a time with a kernel chosen once
+// for the types of its operands, so the per-row cost is the arithmetic only.
+// The kernels use the element-wise rules in operators.h and give the same
+// values as the vm; rows with errors hold the fallback value converted to the
+// result type of the instruction. Where both operands have the same type and
+// the processor has a vector kernel for the operation, it computes as many rows
+// as it can and the element-wise kernel finishes the rest.
+//
+// Both operands of && and || and both branches of a conditional are computed
+// for every row, and the conditional selects the values of a row from them. A
+// mask of the rows that do not skip an operand or branch goes with it to the
+// kernels, which report no errors for the other rows, so execute succeeds or
+// fails as the vm would for every row. Branches of different types are
+// reported as an error, and all rows then hold the values of the else branch.
+class batch
+{
+public:
+	bool execute(const bytecode& program, std::span<const column> columns, result_column& result);
+	// Where the errors of execute are recorded; the caller clears it. Unless
+	// set, they are written to std::cerr at the end of every execute.
+	void set_diagnostics(diagnostic_buffer& diagnostics)
+	{
+		_diagnostics = &diagnostics;
+	}
+
+	// active tells which rows the operation is computed for, nullptr for all;
+	// the others hold a value but report no error.
+	using binary_kernel = const char* (*)(const void* left, const void* right, void* result, size_t count,
+		const bool* active);
+	using unary_kernel = void (*)(const void* value, void* result, size_t count);
+private:
+	enum class step_kind : unsigned char
+	{
+		LOAD_CONST,
+		LOAD_VAR,
+		MOVE,
+		BINARY,
+		UNARY,
+		TEST,      // truth of the condition of a conditional, into saved buffer b
+		SAVE,      // values of the then branch, into saved buffer b
+		SELECT,    // dst = saved a ? saved b : dst
+		MASK,      // saved b = rows of mask for which saved a is not negate
+		RETURN,
+	};
+	static constexpr std::uint32_t no_mask = ~std::uint32_t{ 0 };
+	enum class source : unsigned char
+	{
+		REGISTER,
+		COLUMN,
+		CONSTANT,
+	};
+	struct step
+	{
+		step_kind kind;
+		source left;
+		source right;
+		std::uint32_t dst;
+		std::uint32_t a;
+		std::uint32_t b;
+		size_t type;                   // type of the value the step produces
+		binary_kernel binary;
+		unary_kernel unary;
+		simd_binary_kernel simd_binary;
+		simd_unary_kernel simd_unary;
+		size_t width;                  // size of an operand, for the rows a vector kernel skips
+		const void* constant;          // scalar right operand or broadcast LOAD_CONST value
+		bool reported;                 // a value error of this step has been reported
+		std::uint32_t instruction{ 0 };   // the step was planned from, for diagnostics
+		std::uint32_t mask{ no_mask };    // saved buffer of the rows that compute the step
+		bool negate{ false };
+		const char* message{ nullptr };   // type error, reported if a row of mask computes the step
+#if EXPRESSION_PROFILE
+		token_kind op{ token_kind::UNDEFINED };
+		size_t left_type{ 0 };
+		size_t right_type{ 0 };        // profile_timer::no_operand for unary steps
+#endif
+	};
+	std::vector<step> _steps;
+	std::vector<std::vector<std::uint64_t>> _buffers;        // one per register
+	std::vector<std::uint64_t> _scratch;
+	std::vector<std::vector<std::uint64_t>> _broadcasts;     // LOAD_CONST values
+	std::vector<std::vector<std::uint64_t>> _saved;          // conditions, then branches and row masks
+	std::vector<const void*> _registers;                     // data of every register for the current rows
+	unsigned int _errors{ 0 };
+	diagnostic_buffer _own_diagnostics;
+	diagnostic_buffer* _diagnostics{ &_own_diagnostics };
+	bool plan(const bytecode& program, std::span<const column> columns);
+	bool check_columns(const bytecode& program, std::span<const column> columns);
+	void write_own_diagnostics();
+	// The rows that compute step, nullptr for all.
+	const bool* mask(const step& step) const
+	{
+		return step.mask == no_mask ? nullptr : reinterpret_cast<const bool*>(_saved[step.mask].data());
+	}
+	void error(const bytecode& program, size_t index, const char* message);
+};
@@ -0,0 +1,531 @@
+// benchmark.cpp : Measures lexing, parsing and evaluation of generated or given
+// expressions and writes the throughput and latencies of each phase as JSON.
+//
+// expression_benchmark [options]
+//   --depth N          levels of operators in each expression (3)
+//   --width N          operands each level combines (2)
+//   --count N          expressions in the workload (10000)
+//   --repeat N         times each phase runs over the workload (5)
+//   --seed N           seed of the generator (1)
+//   --variables R      share of operands that are variables (0.3)
+//   --unary R          share of operands with a unary operator (0.1)
+//   --operators SPEC   weighted binary operators, as "+:4,*:2,<<:1"
+//   --types SPEC       weighted literal types, as "int:3,double:1,unsigned long:1"
+//   --input FILE       measure the expressions of FILE, one per line
+//   --write FILE       write the generated workload to FILE and exit
+//   --output FILE      write the results to FILE instead of the standard output
+//
+// The values every evaluation phase computes are checked against those of the
+// tree, and the run fails if any differ.
+//
+// Profiling builds add the operator counters of the whole run to the results.
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "bytecode.h"
+#include "expression_tree.h"
+#include "incremental_evaluator.h"
+#include "jit.h"
+#include "lexer.h"
+#include "line_evaluator.h"
+#include "mapped_file.h"
+#include "parser.h"
+#include "profile.h"
+#include "scanner.h"
+#include "simd.h"
+#include "variables.h"
+#include "vm.h"
+#include "workload.h"
+
+namespace
+{
+	using clock = std::chrono::steady_clock;
+
+	// Latencies and totals of one phase.
+	struct phase
+	{
+		std::string name;
+		std::vector<double> latencies{};   // nanoseconds per item
+		size_t bytes{ 0 };
+		size_t failures{ 0 };
+		size_t mismatches{ 0 };   // values that differ from the tree's
+		double seconds{ 0 };
+	};
+
+	// The value of every valid expression an evaluation phase computed last,
+	// and whether it succeeded.
+	struct results
+	{
+		std::vector<token_value> values;
+		std::vector<char> succeeded;
+		explicit results(size_t count) : values(count), succeeded(count)
+		{}
+	};
+
+	// Same type and bits; NaNs compare equal whatever their payload.
+	bool same_value(const token_value& a, const token_value& b)
+	{
+		if (a.index() != b.index())
+			return false;
+		return std::visit([&b](auto value)
+		{
+			auto other = std::get<decltype(value)>(b);
+			if constexpr (std::is_floating_point_v<decltype(value)>)
+			{
+				if (std::isnan(value) && std::isnan(other))
+					return true;
+			}
+			return std::memcmp(&value, &other, sizeof(value)) == 0;
+		}, a);
+	}
+
+	// Evaluations that succeeded where the expected one failed, or the other
+	// way round, or that computed another value.
+	size_t mismatches(const results& expected, const results& actual)
+	{
+		size_t count{ 0 };
+		for (size_t i{ 0 }; i < expected.values.size(); i++)
+		{
+			if (expected.succeeded[i] != actual.succeeded[i]
+				|| (expected.succeeded[i] && !same_value(expected.values[i], actual.values[i])))
+				count++;
+		}
+		return count;
+	}
+
+	// Runs measure once per item of every repeat and times each call. measure
+	// returns false if the item failed.
+	template <typename F>
+	phase run(std::string name, size_t items, size_t repeat, size_t item_bytes, F&& measure)
+	{
+		phase result{ std::move(name) };
+		result.latencies.reserve(items * repeat);
+		// Errors the workload provokes are counted, not printed.
+		std::cerr.setstate(std::ios::failbit);
+		for (size_t r{ 0 }; r < repeat; r++)
+			for (size_t i{ 0 }; i < items; i++)
+			{
+				auto start{ clock::now() };
+				auto ok{ measure(i) };
+				std::chrono::duration<double, std::nano> elapsed{ clock::now() - start };
+				result.latencies.push_back(elapsed.count());
+				result.failures += !ok;
+			}
+		std::cerr.clear();
+		result.bytes = item_bytes * repeat;
+		result.seconds = std::accumulate(result.latencies.begin(), result.latencies.end(), 0.0) / 1e9;
+		return result;
+	}
+
+	double percentile(const std::vector<double>& sorted, double p)
+	{
+		if (sorted.empty())
+			return 0;
+		auto index{ static_cast<size_t>(p / 100 * static_cast<double>(sorted.size() - 1) + 0.5) };
+		return sorted[index];
+	}
+
+	void write_json(std::ostream& output, std::string_view text)
+	{
+		output << '"';
+		for (auto ch : text)
+			if (ch == '"' || ch == '\\')
+				output << '\\' << ch;
+			else
+				output << ch;
+		output << '"';
+	}
+
+	void write_phase(std::ostream& output, phase& phase)
+	{
+		std::sort(phase.latencies.begin(), phase.latencies.end());
+		auto items{ phase.latencies.size() };
+		auto per_second = [&](double amount) { return phase.seconds > 0 ? amount / phase.seconds : 0.0; };
+		output << "    {\"name\": ";
+		write_json(output, phase.name);
+		output << ", \"items\": " << items << ", \"bytes\": " << phase.bytes << ", \"failures\": " << phase.failures
+			<< ", \"mismatches\": " << phase.mismatches
+			<< ", \"seconds\": " << phase.seconds
+			<< ", \"items_per_second\": " << per_second(static_cast<double>(items))
+			<< ", \"bytes_per_second\": " << per_second(static_cast<double>(phase.bytes))
+			<< ", \"latency_ns\": {\"mean\": " << (items ? phase.seconds * 1e9 / static_cast<double>(items) : 0.0)
+			<< ", \"p50\": " << percentile(phase.latencies, 50) << ", \"p90\": " << percentile(phase.latencies, 90)
+			<< ", \"p99\": " << percentile(phase.latencies, 99)
+			<< ", \"max\": " << (items ? phase.latencies.back() : 0.0) << "}}";
+	}
+
+	const char* instruction_set_name(instruction_set set)
+	{
+		switch (set)
+		{
+		case instruction_set::SSE42: return "sse4.2";
+		case instruction_set::AVX2: return "avx2";
+		case instruction_set::AVX512: return "avx512";
+		default: return "scalar";
+		}
+	}
+
+	// Parses "key:weight,key:weight" into pairs, converting keys with parse_key.
+	template <typename T, typename F>
+	bool parse_weights(std::string_view spec, std::vector<std::pair<T, double>>& weights, F&& parse_key)
+	{
+		while (!spec.empty())
+		{
+			auto end{ std::min(spec.find(','), spec.size()) };
+			auto entry{ spec.substr(0, end) };
+			spec.remove_prefix(std::min(end + 1, spec.size()));
+			auto colon{ entry.rfind(':') };
+			auto weight{ 1.0 };
+			if (colon != std::string_view::npos)
+			{
+				auto text{ entry.substr(colon + 1) };
+				if (std::from_chars(text.data(), text.data() + text.size(), weight).ptr != text.data() + text.size()
+					|| weight < 0)
+					return false;
+				entry = entry.substr(0, colon);
+			}
+			T key;
+			if (!parse_key(entry, key))
+				return false;
+			weights.emplace_back(key, weight);
+		}
+		return true;
+	}
+
+	template <typename T>
+	bool parse_number(const char* text, T& value)
+	{
+		std::string_view view{ text };
+		return std::from_chars(view.data(), view.data() + view.size(), value).ptr == view.data() + view.size();
+	}
+
+	std::vector<std::string_view> split_lines(std::string_view source)
+	{
+		std::vector<std::string_view> lines;
+		while (!source.empty())
+		{
+			auto end{ std::min(source.find('\n'), source.size()) };
+			auto line{ source.substr(0, end) };
+			if (!line.empty() && line.back() == '\r')
+				line.remove_suffix(1);
+			if (line.find_first_not_of(" \t") != std::string_view::npos)
+				lines.push_back(line);
+			source.remove_prefix(std::min(end + 1, source.size()));
+		}
+		return lines;
+	}
+
+	class null_buffer : public std::streambuf
+	{
+	protected:
+		int_type overflow(int_type ch) override
+		{
+			return ch;
+		}
+		std::streamsize xsputn(const char*, std::streamsize count) override
+		{
+			return count;
+		}
+	};
+}
+
+int main(int argc, char* argv[])
+{
+	workload_options options;
+	size_t count{ 10000 };
+	size_t repeat{ 5 };
+	std::string input_name;
+	std::string write_name;
+	std::string output_name;
+	for (int i{ 1 }; i < argc; i++)
+	{
+		std::string_view option{ argv[i] };
+		if (i + 1 >= argc)
+		{
+			std::cerr << "Missing value of " << option << std::endl;
+			return EXIT_FAILURE;
+		}
+		auto value{ argv[++i] };
+		auto ok{ true };
+		if (option == "--depth")
+			ok = parse_number(value, options.depth);
+		else if (option == "--width")
+			ok = parse_number(value, options.width);
+		else if (option == "--count")
+			ok = parse_number(value, count);
+		else if (option == "--repeat")
+			ok = parse_number(value, repeat) && repeat > 0;
+		else if (option == "--seed")
+			ok = parse_number(value, options.seed);
+		else if (option == "--variables")
+			ok = parse_number(value, options.variable_share);
+		else if (option == "--unary")
+			ok = parse_number(value, options.unary_share);
+		else if (option == "--operators")
+			ok = parse_weights(value, options.operators, workload_generator::binary_operator);
+		else if (option == "--types")
+			ok = parse_weights(value, options.types, [](std::string_view name, size_t& type) {
+				type = workload_generator::type_index(name);
+				return type != dynamic_type;
+				});
+		else if (option == "--input")
+			input_name = value;
+		else if (option == "--write")
+			write_name = value;
+		else if (option == "--output")
+			output_name = value;
+		else
+		{
+			std::cerr << "Unknown option " << option << std::endl;
+			return EXIT_FAILURE;
+		}
+		if (!ok)
+		{
+			std::cerr << "Invalid value of " << option << ": " << value << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	workload_generator generator{ options };
+	std::string generated;
+	std::optional<mapped_file> input;
+	std::string_view source;
+	if (input_name.empty())
+	{
+		generated = generator.file(count);
+		source = generated;
+	}
+	else
+	{
+		input.emplace(input_name);
+		if (!input->is_open())
+		{
+			std::cerr << "File not found" << std::endl;
+			return EXIT_FAILURE;
+		}
+		source = input->contents();
+	}
+	if (!write_name.empty())
+	{
+		std::ofstream file{ write_name, std::ios::binary };
+		file << source;
+		if (!file)
+		{
+			std::cerr << "Cannot write " << write_name << std::endl;
+			return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+	}
+
+	auto expressions{ split_lines(source) };
+	size_t expression_bytes{ 0 };
+	for (auto expression : expressions)
+		expression_bytes += expression.size();
+	variables names;
+	generator.declare(names);
+	names.seal();
+	std::vector<token_value> slots{ generator.values() };
+	std::vector<phase> phases;
+
+	scanner scanner;
+	phases.push_back(run("lex", expressions.size(), repeat, expression_bytes, [&](size_t i) {
+		scanner.set_source(expressions[i]);
+		auto ok{ true };
+		for (auto token{ scanner.next() }; token.kind != token_kind::END_OF_FILE; token = scanner.next())
+			ok &= token.kind != token_kind::INVALID_CHARACTER;
+		return ok;
+		}));
+
+	std::vector<lexeme> lexemes;
+	phases.push_back(run("lex_file", 1, repeat, source.size(), [&](size_t) {
+		lexemes.clear();
+		return lex(source, lexemes);
+		}));
+
+	parser parser;
+	std::vector<expression_tree> trees(expressions.size());
+	std::vector<bool> compiled(expressions.size());
+	phases.push_back(run("parse", expressions.size(), repeat, expression_bytes, [&](size_t i) {
+		trees[i].clear();
+		parser.reset(expressions[i]);
+		compiled[i] = parser.compile(trees[i], names);
+		return compiled[i];
+		}));
+
+	// Expressions that did not compile are left out of evaluation.
+	std::vector<size_t> valid;
+	for (size_t i{ 0 }; i < expressions.size(); i++)
+		if (compiled[i])
+			valid.push_back(i);
+	size_t valid_bytes{ 0 };
+	for (auto i : valid)
+		valid_bytes += expressions[i].size();
+
+	// Every evaluation phase stores what it computes in actual, which is then
+	// compared with expected, the values of the tree.
+	results expected{ valid.size() };
+	results actual{ valid.size() };
+	auto record = [&actual](size_t i, bool ok) {
+		actual.succeeded[i] = ok;
+		return ok;
+	};
+	phases.push_back(run("evaluate", valid.size(), repeat, valid_bytes, [&](size_t i) {
+		return record(i, trees[valid[i]].evaluate(actual.values[i], slots));
+		}));
+	expected = actual;
+
+	std::vector<bytecode> programs(valid.size());
+	for (size_t i{ 0 }; i < valid.size(); i++)
+		programs[i].compile(trees[valid[i]]);
+	vm machine;
+	phases.push_back(run("evaluate_vm", valid.size(), repeat, valid_bytes, [&](size_t i) {
+		return record(i, machine.execute(programs[i], actual.values[i], slots));
+		}));
+	phases.back().mismatches = mismatches(expected, actual);
+
+	// Every evaluation changes one variable, alternating between its value
+	// and that value plus one.
+	std::vector<std::unique_ptr<incremental_evaluator>> incremental(valid.size());
+	for (size_t i{ 0 }; i < valid.size(); i++)
+	{
+		incremental[i] = std::make_unique<incremental_evaluator>(trees[valid[i]]);
+		incremental[i]->reset(slots);
+	}
+	std::vector<token_value> changed_slots;
+	for (const auto& slot : slots)
+		changed_slots.push_back(std::visit([](auto v) { return token_value{ static_cast<decltype(v)>(v + 1) }; }, slot));
+	size_t tick{ 0 };
+	phases.push_back(run("evaluate_incremental", valid.size(), repeat, valid_bytes, [&](size_t i) {
+		if (!slots.empty())
+		{
+			auto slot = tick++ % slots.size();
+			auto changed = tick / slots.size() % 2 != 0;
+			incremental[i]->set(slot, changed ? changed_slots[slot] : slots[slot]);
+		}
+		return incremental[i]->evaluate(actual.values[i]);
+		}));
+	// The variables changed in an order the tree does not follow, so every
+	// evaluator is set to all changed values and back, and checked for both.
+	results expected_changed{ valid.size() };
+	std::cerr.setstate(std::ios::failbit);
+	for (size_t i{ 0 }; i < valid.size(); i++)
+	{
+		expected_changed.succeeded[i] = trees[valid[i]].evaluate(expected_changed.values[i], changed_slots);
+		for (size_t slot{ 0 }; slot < slots.size(); slot++)
+			incremental[i]->set(slot, changed_slots[slot]);
+		auto ok = incremental[i]->evaluate(actual.values[i]);
+		auto& phase = phases.back();
+		phase.mismatches += expected_changed.succeeded[i] != ok
+			|| (ok && !same_value(expected_changed.values[i], actual.values[i]));
+		for (size_t slot{ 0 }; slot < slots.size(); slot++)
+			incremental[i]->set(slot, slots[slot]);
+		actual.succeeded[i] = incremental[i]->evaluate(actual.values[i]);
+	}
+	std::cerr.clear();
+	phases.back().mismatches += mismatches(expected, actual);
+
+#if EXPRESSION_JIT
+	std::vector<jit> functions(valid.size());
+	for (size_t i{ 0 }; i < valid.size(); i++)
+		functions[i].compile(trees[valid[i]]);
+	phases.push_back(run("evaluate_jit", valid.size(), repeat, valid_bytes, [&](size_t i) {
+		return record(i, functions[i].evaluate(actual.values[i], slots));
+		}));
+	phases.back().mismatches = mismatches(expected, actual);
+#endif
+
+	// The whole pipeline over the source, as the expression program runs it.
+	// It has no variables, so a source that uses them counts as failed.
+	null_buffer discard;
+	std::ostream null_output{ &discard };
+	phases.push_back(run("line_evaluator", 1, repeat, source.size(), [&](size_t) {
+		line_evaluator evaluator{ null_output };
+		evaluator.evaluate(source);
+		evaluator.flush();
+		return evaluator.failures() == 0;
+		}));
+
+	std::ofstream file;
+	if (!output_name.empty())
+	{
+		file.open(output_name, std::ios::binary);
+		if (!file)
+		{
+			std::cerr << "Cannot write " << output_name << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+	auto& output{ output_name.empty() ? std::cout : static_cast<std::ostream&>(file) };
+	output.precision(6);
+	output << "{\n  \"workload\": {\"source\": ";
+	write_json(output, input_name.empty() ? "generated" : input_name);
+	output << ", \"expressions\": " << expressions.size() << ", \"bytes\": " << source.size()
+		<< ", \"repeat\": " << repeat;
+	if (input_name.empty())
+	{
+		const auto& options{ generator.options() };
+		output << ", \"depth\": " << options.depth << ", \"width\": " << options.width << ", \"seed\": " << options.seed
+			<< ", \"variables\": " << options.variable_share << ", \"unary\": " << options.unary_share;
+		output << ", \"operators\": {";
+		for (size_t i{ 0 }; i < options.operators.size(); i++)
+		{
+			output << (i ? ", " : "");
+			write_json(output, workload_generator::spelling(options.operators[i].first));
+			output << ": " << options.operators[i].second;
+		}
+		output << "}, \"types\": {";
+		for (size_t i{ 0 }; i < options.types.size(); i++)
+		{
+			output << (i ? ", " : "");
+			write_json(output, workload_generator::type_name(options.types[i].first));
+			output << ": " << options.types[i].second;
+		}
+		output << "}";
+	}
+	output << "},\n  \"instruction_set\": \"" << instruction_set_name(simd_instruction_set()) << "\",\n  \"phases\": [\n";
+	for (size_t i{ 0 }; i < phases.size(); i++)
+	{
+		write_phase(output, phases[i]);
+		output << (i + 1 < phases.size() ? ",\n" : "\n");
+	}
+	output << "  ]";
+#if EXPRESSION_PROFILE
+	output << ",\n  \"profile\": [";
+	auto entries{ profile::entries() };
+	for (size_t i{ 0 }; i < entries.size(); i++)
+	{
+		const auto& entry{ entries[i] };
+		output << (i ? ",\n" : "\n") << "    {\"operator\": \"" << profile::name(entry) << "\", \"left\": \""
+			<< value_type_names[entry.left] << "\", \"right\": \"" << (entry.unary ? "" : value_type_names[entry.right])
+			<< "\", \"count\": " << entry.count << ", \"cycles\": " << entry.cycles << ", \"errors\": " << entry.errors << "}";
+	}
+	output << "\n  ]";
+#endif
+	output << "\n}\n";
+	auto result{ EXIT_SUCCESS };
+	for (const auto& phase : phases)
+	{
+		if (phase.mismatches != 0)
+		{
+			std::cerr << phase.name << ": " << phase.mismatches << " values differ from the tree's" << std::endl;
+			result = EXIT_FAILURE;
+		}
+	}
+	return result;
+}
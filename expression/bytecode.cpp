@@ -0,0 +1,298 @@
+#include <algorithm>
+
+#include "bytecode.h"
+
+bool bytecode::compile(const expression_tree& tree)
+{
+	_code.clear();
+	_constants.clear();
+	_positions.clear();
+	_lowered.clear();
+	_register_count = 0;
+	_top = 0;
+	_slot_count = tree.slot_count();
+	_slot_types.assign(tree.slot_types().begin(), tree.slot_types().end());
+	_slot_positions.assign(tree.slot_positions().begin(), tree.slot_positions().end());
+	if (tree.empty())
+		return false;
+	auto uses = tree.operand_uses();
+	_shared.assign(tree.size(), no_register);
+	_computed.assign(tree.size(), false);
+	for (size_t index = 0; index < tree.size(); ++index)
+	{
+		auto kind = tree.node(index).kind;
+		if (uses[index] > 1 && kind != node_kind::LITERAL && kind != node_kind::VARIABLE)
+			_shared[index] = _top++;
+	}
+	_register_count = _top;
+	const auto& root = tree.position(tree.root());
+	auto result = materialize(compile(tree, tree.root()), root);
+	emit(opcode::RETURN, 0, result, 0, root);
+	return true;
+}
+
+// Compiles the nodes reachable from index. Nodes wait for their operands on
+// _compile_stack, so deep trees take no stack, and value is the operand of
+// the node compiled last. The first use of a shared node computes it into its
+// register.
+bytecode::operand bytecode::compile(const expression_tree& tree, size_t index)
+{
+	_compile_stack.clear();
+	_compile_stack.push_back({ static_cast<std::uint32_t>(index) });
+	operand value{ operand::kind::REGISTER, 0 };
+	while (!_compile_stack.empty())
+	{
+		auto& frame = _compile_stack.back();
+		auto shared = _shared[frame.index];
+		if (frame.operands == 0 && shared != no_register && _computed[frame.index])
+		{
+			value = { operand::kind::SHARED, shared };
+			_compile_stack.pop_back();
+			continue;
+		}
+		auto next = compile_node(tree, frame, value);
+		if (next != no_node)
+		{
+			++frame.operands;
+			_compile_stack.push_back({ next });
+			continue;
+		}
+		if (shared != no_register)
+		{
+			const auto& node = tree.node(frame.index);
+			auto reg = value.index;
+			auto logical = node.op == token_kind::AMP_AMP || node.op == token_kind::BAR_BAR;
+			if ((node.kind == node_kind::UNARY || (node.kind == node_kind::BINARY && !logical)) && _code.back().dst == reg)
+				_code.back().dst = shared;
+			else
+				emit(opcode::MOVE, shared, reg, 0, tree.position(frame.index));
+			--_top;
+			_computed[frame.index] = true;
+			value = { operand::kind::SHARED, shared };
+		}
+		_compile_stack.pop_back();
+	}
+	return value;
+}
+
+// Returns the operand of the node to compile next, or no_node once the node
+// is compiled and value is its operand. value is the operand compiled last.
+std::uint32_t bytecode::compile_node(const expression_tree& tree, compile_frame& frame, operand& value)
+{
+	const auto& node = tree.node(frame.index);
+	const auto& position = tree.position(frame.index);
+	switch (node.kind)
+	{
+	case node_kind::LITERAL:
+		_constants.push_back(tree.literal(frame.index));
+		value = { operand::kind::CONSTANT, static_cast<std::uint32_t>(_constants.size() - 1) };
+		return no_node;
+	case node_kind::VARIABLE:
+		value = { operand::kind::VARIABLE, static_cast<std::uint32_t>(node.slot) };
+		return no_node;
+	case node_kind::UNARY:
+	{
+		if (frame.operands == 0)
+			return node.left;
+		auto value_reg = materialize(value, position);
+		auto reg = value.kind == operand::kind::SHARED ? push() : value_reg;
+		switch (node.op)
+		{
+#define X(name, member, kind) \
+		case token_kind::kind: \
+			emit(opcode::name, reg, value_reg, 0, position, node.lowered); \
+			break;
+		EXPRESSION_UNARY_OPERATIONS(X)
+#undef X
+		default:
+			break;
+		}
+		value = { operand::kind::REGISTER, reg };
+		return no_node;
+	}
+	case node_kind::CONDITIONAL:
+		return compile_conditional(tree, frame, value);
+	case node_kind::BINARY:
+	default:
+	{
+		if (node.op == token_kind::AMP_AMP)
+			return compile_logical(tree, frame, value, opcode::LOGICAL_AND);
+		if (node.op == token_kind::BAR_BAR)
+			return compile_logical(tree, frame, value, opcode::LOGICAL_OR);
+		if (frame.operands == 0)
+			return node.left;
+		if (frame.operands == 1)
+		{
+			frame.left = value;
+			return node.right;
+		}
+		auto left = frame.left;
+		auto right = value;
+		opcode op;
+		switch (node.op)
+		{
+#define X(name, member, kind) \
+		case token_kind::kind: \
+			op = opcode::name; \
+			break;
+		EXPRESSION_BINARY_OPERATIONS(X)
+#undef X
+		default:
+			op = opcode::ADD;
+			break;
+		}
+		if (right.kind == operand::kind::CONSTANT)
+		{
+			if (left.kind == operand::kind::VARIABLE)
+			{
+				auto dst = push();
+				emit(static_cast<opcode>(static_cast<unsigned>(op) + 2), dst, left.index, right.index, position, node.lowered);
+				value = { operand::kind::REGISTER, dst };
+				return no_node;
+			}
+			auto left_reg = materialize(left, position);
+			auto reg = left.kind == operand::kind::SHARED ? push() : left_reg;
+			emit(static_cast<opcode>(static_cast<unsigned>(op) + 1), reg, left_reg, right.index, position, node.lowered);
+			value = { operand::kind::REGISTER, reg };
+			return no_node;
+		}
+		// Registers are used as a stack: the operands that are not shared are
+		// the topmost registers, the result goes to the lowest of them and the
+		// other one is freed.
+		auto right_reg = materialize(right, position);
+		auto left_reg = materialize(left, position);
+		auto left_shared = left.kind == operand::kind::SHARED;
+		auto right_shared = right.kind == operand::kind::SHARED;
+		std::uint32_t dst;
+		if (left_shared && right_shared)
+			dst = push();
+		else if (left_shared)
+			dst = right_reg;
+		else if (right_shared)
+			dst = left_reg;
+		else
+			dst = std::min(left_reg, right_reg);
+		emit(op, dst, left_reg, right_reg, position, node.lowered);
+		if (!left_shared && !right_shared)
+			--_top;
+		value = { operand::kind::REGISTER, dst };
+		return no_node;
+	}
+	}
+}
+
+// The left operand goes to a register first, so the jump past the right one
+// leaves the result where the operator would.
+std::uint32_t bytecode::compile_logical(const expression_tree& tree, compile_frame& frame, operand& value, opcode op)
+{
+	const auto& node = tree.node(frame.index);
+	const auto& position = tree.position(frame.index);
+	if (frame.operands == 0)
+		return node.left;
+	if (frame.operands == 1)
+	{
+		frame.left_reg = materialize(value, position);
+		frame.reg = value.kind == operand::kind::SHARED ? push() : frame.left_reg;
+		frame.jump = _code.size();
+		emit(op == opcode::LOGICAL_AND ? opcode::AND_JUMP : opcode::OR_JUMP, frame.reg, frame.left_reg, 0, position);
+		return node.right;
+	}
+	if (value.kind == operand::kind::CONSTANT)
+	{
+		emit(static_cast<opcode>(static_cast<unsigned>(op) + 1), frame.reg, frame.left_reg, value.index, position, node.lowered);
+	}
+	else
+	{
+		emit(op, frame.reg, frame.left_reg, materialize(value, position), position, node.lowered);
+		if (value.kind != operand::kind::SHARED)
+			--_top;
+	}
+	patch(frame.jump);
+	value = { operand::kind::REGISTER, frame.reg };
+	return no_node;
+}
+
+// Both branches leave their value in the register the condition was in.
+std::uint32_t bytecode::compile_conditional(const expression_tree& tree, compile_frame& frame, operand& value)
+{
+	const auto& node = tree.node(frame.index);
+	const auto& position = tree.position(frame.index);
+	switch (frame.operands)
+	{
+	case 0:
+		return node.condition;
+	case 1:
+	{
+		auto condition_reg = materialize(value, position);
+		frame.reg = _top;
+		if (value.kind != operand::kind::SHARED)
+			frame.reg = --_top;
+		frame.jump = _code.size();
+		emit(opcode::JUMP_IF_FALSE, frame.reg, condition_reg, 0, position);
+		return node.left;
+	}
+	case 2:
+	{
+		push_value(value, position);
+		auto test = frame.jump;
+		frame.jump = _code.size();
+		emit(opcode::JUMP, 0, 0, 0, position);
+		patch(test);
+		--_top;
+		return node.right;
+	}
+	default:
+		push_value(value, position);
+		patch(frame.jump);
+		value = { operand::kind::REGISTER, frame.reg };
+		return no_node;
+	}
+}
+
+std::uint32_t bytecode::materialize(operand operand, const source_position& position)
+{
+	switch (operand.kind)
+	{
+	case operand::kind::CONSTANT:
+	{
+		auto reg = push();
+		emit(opcode::LOAD_CONST, reg, operand.index, 0, position);
+		return reg;
+	}
+	case operand::kind::VARIABLE:
+	{
+		auto reg = push();
+		emit(opcode::LOAD_VAR, reg, operand.index, 0, position);
+		return reg;
+	}
+	case operand::kind::REGISTER:
+	case operand::kind::SHARED:
+	default:
+		return operand.index;
+	}
+}
+
+// Like materialize, but copies the value of a shared node to the stack.
+std::uint32_t bytecode::push_value(operand operand, const source_position& position)
+{
+	if (operand.kind != operand::kind::SHARED)
+		return materialize(operand, position);
+	auto reg = push();
+	emit(opcode::MOVE, reg, operand.index, 0, position);
+	return reg;
+}
+
+std::uint32_t bytecode::push()
+{
+	auto reg = _top++;
+	_register_count = std::max<size_t>(_register_count, _top);
+	return reg;
+}
+
+void bytecode::emit(opcode op, std::uint32_t dst, std::uint32_t a, std::uint32_t b, const source_position& position,
+	operations::typed_operation lowered)
+{
+	_code.push_back({ op, dst, a, b });
+	_positions.push_back(position);
+	_lowered.push_back(lowered);
+}
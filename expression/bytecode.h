@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "expression_tree.h"
+#include "operations.h"
+#include "operators.h"
+#include "token.h"
+
+// Every binary operator comes in three forms:
+//   OP     dst = reg[a] op reg[b]
+//   OP_K   dst = reg[a] op constant[b]          (load constant + op)
+//   OP_VK  dst = slot[a] op constant[b]         (load variable + load constant + op)
+#define EXPRESSION_BINARY_OPCODES(name, member, kind) X(name) X(name##_K) X(name##_VK)
+#define EXPRESSION_UNARY_OPCODES(name, member, kind) X(name)
+
+// Jumps continue at instruction b:
+//   JUMP           always
+//   JUMP_IF_FALSE  if reg[a] is zero; dst is the register of the value of the conditional
+//   AND_JUMP       if reg[a] is a false logical operand, with dst = false
+//   OR_JUMP        if reg[a] is a true logical operand, with dst = true
+#define EXPRESSION_JUMP_OPCODES \
+	X(JUMP) \
+	X(JUMP_IF_FALSE) \
+	X(AND_JUMP) \
+	X(OR_JUMP)
+
+// Expands X(name) for every opcode; define X before use.
+#define EXPRESSION_OPCODES \
+	X(LOAD_CONST) \
+	X(LOAD_VAR) \
+	X(MOVE) \
+	EXPRESSION_BINARY_OPERATIONS(EXPRESSION_BINARY_OPCODES) \
+	EXPRESSION_UNARY_OPERATIONS(EXPRESSION_UNARY_OPCODES) \
+	EXPRESSION_JUMP_OPCODES \
+	X(RETURN)
+
+enum class opcode : std::uint8_t
+{
+#define X(name) name,
+	EXPRESSION_OPCODES
+#undef X
+};
+
+struct instruction
+{
+	opcode        op;
+	std::uint32_t dst;   // destination register
+	std::uint32_t a;     // register, slot or constant index depending on op
+	std::uint32_t b;     // register or constant index depending on op
+};
+
+// Register based instruction stream compiled from an expression_tree. The
+// program is immutable once compiled; all scratch state lives in the vm.
+// Nodes the tree shares are computed once into a register of their own, below
+// the registers used as a stack, and read from there by every use.
+class bytecode
+{
+public:
+	bool compile(const expression_tree& tree);
+	const std::vector<instruction>& code() const
+	{
+		return _code;
+	}
+	const std::vector<token_value>& constants() const
+	{
+		return _constants;
+	}
+	// Operator of an instruction lowered to its operand types, nullptr if the
+	// types are only known at evaluation.
+	operations::typed_operation lowered(size_t index) const
+	{
+		return _lowered[index];
+	}
+	const std::vector<operations::typed_operation>& lowered() const
+	{
+		return _lowered;
+	}
+	// Position of the operator an instruction was compiled from, for diagnostics.
+	const source_position& position(size_t index) const
+	{
+		return _positions[index];
+	}
+	size_t register_count() const
+	{
+		return _register_count;
+	}
+	size_t slot_count() const
+	{
+		return _slot_count;
+	}
+	// Declared type of the values of a slot, dynamic_type if it has none.
+	size_t slot_type(size_t slot) const
+	{
+		return _slot_types[slot];
+	}
+	std::span<const size_t> slot_types() const
+	{
+		return _slot_types;
+	}
+	std::span<const source_position> slot_positions() const
+	{
+		return _slot_positions;
+	}
+private:
+	struct operand
+	{
+		enum class kind : unsigned char
+		{
+			REGISTER,
+			CONSTANT,
+			VARIABLE,
+			SHARED,     // register of a shared node, not on the stack
+		};
+		kind          kind;
+		std::uint32_t index;
+	};
+	std::vector<instruction> _code;
+	std::vector<token_value> _constants;
+	std::vector<source_position> _positions;
+	std::vector<operations::typed_operation> _lowered;
+	std::vector<size_t> _slot_types;
+	std::vector<source_position> _slot_positions;
+	size_t _register_count{ 0 };
+	size_t _slot_count{ 0 };
+	std::uint32_t _top{ 0 };   // next free register, registers are used as a stack
+	static constexpr std::uint32_t no_register = ~std::uint32_t{ 0 };
+	std::vector<std::uint32_t> _shared;   // register of every shared node, no_register for the others
+	std::vector<bool> _computed;          // the shared node is in its register
+	// A node waiting for its operands to be compiled.
+	struct compile_frame
+	{
+		std::uint32_t index;
+		std::uint32_t operands{ 0 };   // operands requested so far
+		operand left{};                // left operand of a binary operator
+		std::uint32_t left_reg{ 0 };   // register of the left operand of && and ||
+		std::uint32_t reg{ 0 };        // register of the value of && and || and conditionals
+		size_t jump{ 0 };              // jump to patch once the operand is compiled
+	};
+	static constexpr std::uint32_t no_node = ~std::uint32_t{ 0 };
+	std::vector<compile_frame> _compile_stack;
+	operand compile(const expression_tree& tree, size_t index);
+	std::uint32_t compile_node(const expression_tree& tree, compile_frame& frame, operand& value);
+	std::uint32_t compile_logical(const expression_tree& tree, compile_frame& frame, operand& value, opcode op);
+	std::uint32_t compile_conditional(const expression_tree& tree, compile_frame& frame, operand& value);
+	std::uint32_t materialize(operand operand, const source_position& position);
+	std::uint32_t push_value(operand operand, const source_position& position);
+	std::uint32_t push();
+	// Makes the jump at instruction index continue at the next instruction emitted.
+	void patch(size_t index)
+	{
+		_code[index].b = static_cast<std::uint32_t>(_code.size());
+	}
+	void emit(opcode op, std::uint32_t dst, std::uint32_t a, std::uint32_t b, const source_position& position,
+		operations::typed_operation lowered = nullptr);
+};
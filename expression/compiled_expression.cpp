@@ -0,0 +1,37 @@
+#include <iostream>
+
+#include "compiled_expression.h"
+#include "parser.h"
+
+compiled_expression::compiled_expression(expression_tree tree) : _tree{ std::move(tree) }
+{
+	_program.compile(_tree);
+}
+
+std::shared_ptr<const compiled_expression> compiled_expression::compile(std::string_view source, variables& variables,
+	diagnostic_buffer& diagnostics)
+{
+	parser parser;
+	parser.set_diagnostics(diagnostics);
+	parser.reset(source);
+	expression_tree tree;
+	if (!parser.compile(tree, variables))
+		return nullptr;
+	return std::make_shared<const compiled_expression>(std::move(tree));
+}
+
+std::shared_ptr<const compiled_expression> compiled_expression::compile(std::string_view source, variables& variables)
+{
+	diagnostic_buffer diagnostics;
+	auto expression = compile(source, variables, diagnostics);
+	if (!expression)
+		diagnostics.write(std::cerr, source);
+	return expression;
+}
+
+std::shared_ptr<const compiled_expression> compiled_expression::compile(std::string_view source)
+{
+	variables none;
+	none.seal();
+	return compile(source, none);
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include "bytecode.h"
+#include "diagnostics.h"
+#include "expression_tree.h"
+#include "token.h"
+#include "variables.h"
+#include "vm.h"
+
+// Scratch state of the evaluations on one thread: the register file and the
+// diagnostics of evaluations with errors, recorded until the caller reads
+// and clears them.
+class evaluation_context
+{
+public:
+	evaluation_context()
+	{
+		_vm.set_diagnostics(_diagnostics);
+	}
+	evaluation_context(const evaluation_context&) = delete;
+	evaluation_context& operator=(const evaluation_context&) = delete;
+	const diagnostic_buffer& diagnostics() const
+	{
+		return _diagnostics;
+	}
+	std::span<const diagnostic> records() const
+	{
+		return _diagnostics.records();
+	}
+	void clear_diagnostics()
+	{
+		_diagnostics.clear();
+	}
+private:
+	friend class compiled_expression;
+	diagnostic_buffer _diagnostics;
+	vm _vm;
+};
+
+// An expression compiled once and evaluated by any number of threads at the
+// same time. It never changes after construction: every evaluation keeps its
+// state in the evaluation_context of its thread, so evaluating takes no locks
+// and writes to nothing shared. Compile once, share the pointer and give every
+// thread a context of its own.
+class compiled_expression
+{
+public:
+	explicit compiled_expression(expression_tree tree);
+	// Compiles source against the variables table, nullptr if the parser
+	// reported errors. A parser is created per call, so threads can compile at
+	// the same time with tables of their own or one sealed table, which
+	// resolving identifiers does not change. The errors are recorded in
+	// diagnostics, or written to std::cerr if none is given.
+	static std::shared_ptr<const compiled_expression> compile(std::string_view source, variables& variables,
+		diagnostic_buffer& diagnostics);
+	static std::shared_ptr<const compiled_expression> compile(std::string_view source, variables& variables);
+	static std::shared_ptr<const compiled_expression> compile(std::string_view source);
+	bool evaluate(token_value& value, std::span<const token_value> slots, evaluation_context& context) const
+	{
+		return context._vm.execute(_program, value, slots);
+	}
+	const expression_tree& tree() const
+	{
+		return _tree;
+	}
+	const bytecode& program() const
+	{
+		return _program;
+	}
+private:
+	expression_tree _tree;
+	bytecode _program;
+};
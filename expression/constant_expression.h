@@ -0,0 +1,393 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+#include "diagnostics.h"
+#include "number_literal.h"
+#include "operations.h"
+#include "operators.h"
+#include "precedence.h"
+#include "scanner.h"
+#include "token.h"
+
+// The value of an expression without variables, or the first error found in
+// it. id is the error that makes the source no valid expression, message the
+// first error an operator reported evaluating it; offset and length are the
+// place in the source of the token the error is about.
+struct constant_result
+{
+	token_value   value;
+	diagnostic_id id{ diagnostic_id::NONE };
+	const char*   message{ nullptr };
+	size_t        offset{ 0 };
+	size_t        length{ 0 };
+	constexpr bool ok() const
+	{
+		return id == diagnostic_id::NONE && !message;
+	}
+};
+
+// Parses and evaluates an expression without variables in constant
+// evaluation, with the scanning, precedence, literal typing and operator
+// semantics parser and expression_tree use: && and || skip their right
+// operand and conditionals the branch not taken, and operands of the wrong
+// types are errors. The value is computed while parsing, with operators and
+// operands on stacks as parser keeps them, and skipped operands are parsed but
+// not evaluated. Parsing stops at the first syntax error.
+//
+// Operations C++ leaves undefined, such as integer division by zero or
+// signed overflow, are not constant expressions, so they fail the compile.
+// Floating point literals convert as number_literals::parse_constant_floating
+// says.
+class constant_parser
+{
+public:
+	constexpr explicit constant_parser(std::string_view source) : _source{ source }
+	{}
+	constexpr constant_result parse();
+private:
+	enum class pending_kind : unsigned char
+	{
+		UNARY,
+		BINARY,
+		LPAREN,
+		QUESTION,   // a conditional before its :
+		COLON,      // a conditional after its :
+	};
+	struct pending_operator
+	{
+		pending_kind        kind;
+		operator_precedence precedence;
+		token_kind          op;
+		size_t              offset;   // start of the operator in the source
+		size_t              length;
+		bool                skips;    // the operand being parsed is skipped
+	};
+	std::string_view _source;
+	size_t _position{ 0 };
+	size_t _start{ 0 };   // start of the current token
+	token_kind _kind{ token_kind::END_OF_FILE };
+	std::vector<pending_operator> _operators;
+	std::vector<token_value> _operands;
+	unsigned int _skipping{ 0 };   // pending operators that skip what is parsed now
+	constant_result _result;
+	constexpr void scan()
+	{
+		_kind = scanning::next_token(_source, _position, _start);
+	}
+	constexpr constant_result fail(diagnostic_id id)
+	{
+		_result.id = id;
+		_result.offset = _start;
+		_result.length = _position - _start;
+		return _result;
+	}
+	constexpr void report(const char* message, const pending_operator& pending)
+	{
+		if (_result.message)
+			return;
+		_result.message = message;
+		_result.offset = pending.offset;
+		_result.length = pending.length;
+	}
+	constexpr void push(pending_kind kind, operator_precedence precedence = operator_precedence::NO_PRECEDENCE)
+	{
+		_operators.push_back({ kind, precedence, _kind, _start, _position - _start, false });
+	}
+	constexpr void skip(pending_operator& pending)
+	{
+		pending.skips = true;
+		++_skipping;
+	}
+	constexpr bool parse_operand(diagnostic_id& id);
+	constexpr void complete_operand();
+	constexpr void reduce_binary(operator_precedence minimal_precedence);
+	static constexpr token_value apply_binary(token_kind op, const token_value& left, const token_value& right,
+		const char*& message);
+	static constexpr token_value apply_unary(token_kind op, const token_value& value, const char*& message);
+};
+
+constexpr constant_result constant_parser::parse()
+{
+	scan();
+	auto expect_operand{ true };
+	for (;;)
+	{
+		if (expect_operand)
+		{
+			auto id{ diagnostic_id::NONE };
+			if (!parse_operand(id))
+				return fail(id);
+			expect_operand = false;
+		}
+		operator_precedence op_prec{};
+		if (precedence::is_binary_operator(_kind, op_prec) && op_prec >= operator_precedence::LOGICAL_OR)
+		{
+			reduce_binary(op_prec);
+			push(pending_kind::BINARY, op_prec);
+			// The right operand of && and || is skipped if the left one decides.
+			const auto& left = _operands.back();
+			if ((_kind == token_kind::AMP_AMP || _kind == token_kind::BAR_BAR) && operations::is_logical_type(left.index())
+				&& operations::truth(left) == (_kind == token_kind::BAR_BAR))
+			{
+				skip(_operators.back());
+			}
+			scan();
+			expect_operand = true;
+			continue;
+		}
+		reduce_binary(operator_precedence::LOGICAL_OR);
+		if (_kind == token_kind::QUESTION)
+		{
+			push(pending_kind::QUESTION);
+			if (!operations::truth(_operands.back()))
+				skip(_operators.back());
+			scan();
+			expect_operand = true;
+			continue;
+		}
+		// The token ends the innermost conditional expression.
+		if (_operators.empty())
+			break;
+		auto& pending = _operators.back();
+		switch (pending.kind)
+		{
+		case pending_kind::QUESTION:
+			if (_kind != token_kind::COLON)
+				return fail(diagnostic_id::COLON_EXPECTED);
+			scan();
+			// The else branch is skipped if the then branch is not.
+			pending.kind = pending_kind::COLON;
+			if (pending.skips)
+			{
+				pending.skips = false;
+				--_skipping;
+			}
+			else
+			{
+				skip(pending);
+			}
+			expect_operand = true;
+			break;
+		case pending_kind::COLON:
+		{
+			auto else_value = _operands.back();
+			_operands.pop_back();
+			auto then_value = _operands.back();
+			_operands.pop_back();
+			auto& condition = _operands.back();
+			condition = operations::truth(condition) ? then_value : else_value;
+			if (pending.skips)
+				--_skipping;
+			_operators.pop_back();
+			break;
+		}
+		case pending_kind::LPAREN:
+			if (_kind != token_kind::RPAREN)
+				return fail(diagnostic_id::RPAREN_EXPECTED);
+			scan();
+			_operators.pop_back();
+			complete_operand();
+			break;
+		default:
+			break;
+		}
+	}
+	if (_kind != token_kind::END_OF_FILE)
+		return fail(diagnostic_id::EXPRESSION_END_EXPECTED);
+	_result.value = _operands.back();
+	return _result;
+}
+
+// Pushes the unary operators and parentheses before an operand, and then the
+// operand. Returns false with the error if there is no valid operand.
+constexpr bool constant_parser::parse_operand(diagnostic_id& id)
+{
+	for (;;)
+	{
+		switch (_kind)
+		{
+		case token_kind::DASH:
+		case token_kind::PLUS:
+		case token_kind::TILDE:
+		case token_kind::EXCLAIM:
+			push(pending_kind::UNARY);
+			scan();
+			continue;
+		case token_kind::LPAREN:
+			push(pending_kind::LPAREN);
+			scan();
+			continue;
+		default:
+			break;
+		}
+		break;
+	}
+	switch (_kind)
+	{
+	case token_kind::NUMBER_LITERAL:
+	{
+		token_kind kind{ token_kind::NUMBER_LITERAL };
+		token_value value;
+		id = parse_number_literal(_source.substr(_start, _position - _start), kind, value);
+		if (id != diagnostic_id::NONE)
+			return false;
+		_operands.push_back(value);
+		scan();
+		break;
+	}
+	case token_kind::IDENTIFIER:
+		id = diagnostic_id::UNKNOWN_IDENTIFIER;
+		return false;
+	default:
+		id = diagnostic_id::PRIMARY_EXPRESSION_EXPECTED;
+		return false;
+	}
+	complete_operand();
+	return true;
+}
+
+// Applies the unary operators waiting for the operand on top of _operands.
+constexpr void constant_parser::complete_operand()
+{
+	auto& operand = _operands.back();
+	while (!_operators.empty() && _operators.back().kind == pending_kind::UNARY)
+	{
+		if (!_skipping)
+		{
+			const char* message{ nullptr };
+			operand = apply_unary(_operators.back().op, operand, message);
+			if (message)
+				report(message, _operators.back());
+		}
+		_operators.pop_back();
+	}
+}
+
+// Applies the binary operators on top of _operators with at least the given
+// precedence. An && or || whose left operand decided it has that value.
+constexpr void constant_parser::reduce_binary(operator_precedence minimal_precedence)
+{
+	while (!_operators.empty() && _operators.back().kind == pending_kind::BINARY
+		&& _operators.back().precedence >= minimal_precedence)
+	{
+		auto pending = _operators.back();
+		_operators.pop_back();
+		auto right = _operands.back();
+		_operands.pop_back();
+		auto& left = _operands.back();
+		if (pending.skips)
+		{
+			--_skipping;
+			left = pending.op == token_kind::BAR_BAR;
+		}
+		else if (!_skipping)
+		{
+			const char* message{ nullptr };
+			left = apply_binary(pending.op, left, right, message);
+			if (message)
+				report(message, pending);
+		}
+	}
+}
+
+// As operations::binary, with the error stored in message.
+constexpr token_value constant_parser::apply_binary(token_kind op, const token_value& left, const token_value& right,
+	const char*& message)
+{
+	auto apply = [&message]<typename operation>(const token_value& left, const token_value& right)
+	{
+		return std::visit([&message](auto a, auto b) -> token_value
+		{
+			using T1 = decltype(a);
+			using T2 = decltype(b);
+			if constexpr (operation::template defined<T1, T2>)
+			{
+				if (auto error = operation::check(a, b))
+				{
+					message = error;
+					return static_cast<operators::binary_result_t<operation, T1, T2>>(operation::fallback(a, b));
+				}
+				return operation::apply(a, b);
+			}
+			else
+			{
+				message = operation::message;
+				return operation::fallback(a, b);
+			}
+		}, left, right);
+	};
+	switch (op)
+	{
+#define X(name, member, kind) \
+	case token_kind::kind: \
+		return apply.template operator()<operators::member>(left, right);
+	EXPRESSION_BINARY_OPERATIONS(X)
+#undef X
+	default:
+		message = "Unknown binary operator";
+		return left;
+	}
+}
+
+// As operations::unary, with the error stored in message.
+constexpr token_value constant_parser::apply_unary(token_kind op, const token_value& value, const char*& message)
+{
+	auto apply = [&message]<typename operation>(const token_value& value)
+	{
+		return std::visit([&message](auto a) -> token_value
+		{
+			if constexpr (operation::template defined<decltype(a)>)
+			{
+				return operation::apply(a);
+			}
+			else
+			{
+				message = operation::message;
+				return operation::fallback(a);
+			}
+		}, value);
+	};
+	switch (op)
+	{
+	case token_kind::PLUS:
+		return value;
+#define X(name, member, kind) \
+	case token_kind::kind: \
+		return apply.template operator()<operators::member>(value);
+	EXPRESSION_UNARY_OPERATIONS(X)
+#undef X
+	default:
+		message = "Unknown unary operator";
+		return value;
+	}
+}
+
+// Evaluates source as constant_parser does; in constant evaluation, or at run
+// time to read the error.
+constexpr constant_result evaluate_constant(std::string_view source)
+{
+	return constant_parser{ source }.parse();
+}
+
+// Called by consteval_expr for a source with an error. It is not constexpr,
+// so the compile fails at the consteval_expr call, which names the source;
+// evaluate_constant gives the error.
+inline void invalid_constant_expression(const constant_result&)
+{}
+
+// The value of an expression without variables, computed by the compiler:
+//
+//     constexpr auto mask = std::get<int>(consteval_expr("(1 << 20) - 1"));
+//
+// A source with a syntax, literal or operator error does not compile.
+consteval token_value consteval_expr(std::string_view source)
+{
+	auto result = evaluate_constant(source);
+	if (!result.ok())
+		invalid_constant_expression(result);
+	return result.value;
+}
@@ -0,0 +1,91 @@
+#include <string>
+
+#include "diagnostics.h"
+
+namespace
+{
+	struct message
+	{
+		diagnostic_code code;
+		const char* text;
+		bool quotes_token;   // the text is followed by the token text
+	};
+
+	// Indexed by diagnostic_id.
+	constexpr message messages[] = {
+		{ diagnostic_code::SYNTAX, "", false },
+		{ diagnostic_code::SYNTAX, "Expression end expected", false },
+		{ diagnostic_code::SYNTAX, ") expected", false },
+		{ diagnostic_code::SYNTAX, ": expected", false },
+		{ diagnostic_code::SYNTAX, "Primary expression expected", false },
+		{ diagnostic_code::NAME, "Unknown identifier ", true },
+		{ diagnostic_code::NAME, "Conflicting types for variable ", true },
+		{ diagnostic_code::LITERAL, "Invalid number literal", false },
+		{ diagnostic_code::LITERAL, "Integer literal too large", false },
+		{ diagnostic_code::LITERAL, "Floating point literal out of range", false },
+		{ diagnostic_code::LITERAL, "Floating point literal not exact in constant evaluation", false },
+		{ diagnostic_code::EVALUATION, "", false },
+	};
+}
+
+const char* diagnostic_text(diagnostic_id id)
+{
+	return messages[static_cast<size_t>(id)].text;
+}
+
+diagnostic_code diagnostic_code_of(diagnostic_id id)
+{
+	return messages[static_cast<size_t>(id)].code;
+}
+
+void write_diagnostics(std::ostream& output, std::span<const diagnostic> diagnostics, std::string_view source)
+{
+	std::string text;
+	for (const auto& diagnostic : diagnostics)
+	{
+		const auto& message = messages[static_cast<size_t>(diagnostic.id)];
+		text += "Line ";
+		text += std::to_string(diagnostic.line);
+		text += ", pos ";
+		text += std::to_string(diagnostic.column);
+		text += ": ";
+		text += diagnostic.message ? diagnostic.message : message.text;
+		if (message.quotes_token && diagnostic.offset < source.size())
+			text += source.substr(diagnostic.offset, diagnostic.length);
+		text += '\n';
+	}
+	output.write(text.data(), static_cast<std::streamsize>(text.size()));
+}
+
+bool diagnostic_buffer::add(diagnostic_id id, size_t line, size_t column, size_t offset, size_t length)
+{
+	if (_records.size() < _limit)
+		_records.push_back({ diagnostic_code_of(id), id, static_cast<std::uint32_t>(line),
+			static_cast<std::uint32_t>(column), static_cast<std::uint32_t>(offset), static_cast<std::uint32_t>(length) });
+	++_count;
+	return !_fail_fast;
+}
+
+bool diagnostic_buffer::add(const char* message, size_t line, size_t column)
+{
+	if (_records.size() < _limit)
+		_records.push_back({ diagnostic_code::EVALUATION, diagnostic_id::EVALUATION_ERROR,
+			static_cast<std::uint32_t>(line), static_cast<std::uint32_t>(column), 0, 0, message });
+	++_count;
+	return !_fail_fast;
+}
+
+bool diagnostic_buffer::add(const diagnostic& record)
+{
+	if (_records.size() < _limit)
+		_records.push_back(record);
+	++_count;
+	return !_fail_fast;
+}
+
+void diagnostic_buffer::write(std::ostream& output, std::string_view source) const
+{
+	write_diagnostics(output, _records, source);
+	if (_count > _records.size())
+		output << _count - _records.size() << " more errors" << std::endl;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <span>
+#include <string_view>
+#include <vector>
+
+// What a diagnostic is about.
+enum class diagnostic_code : unsigned char
+{
+	SYNTAX,
+	LITERAL,
+	NAME,
+	EVALUATION,
+};
+
+// The message of a diagnostic; diagnostic_text gives its text.
+enum class diagnostic_id : unsigned char
+{
+	NONE,
+	EXPRESSION_END_EXPECTED,
+	RPAREN_EXPECTED,
+	COLON_EXPECTED,
+	PRIMARY_EXPRESSION_EXPECTED,
+	UNKNOWN_IDENTIFIER,
+	VARIABLE_TYPE_CONFLICT,
+	INVALID_NUMBER_LITERAL,
+	INTEGER_LITERAL_TOO_LARGE,
+	FLOATING_LITERAL_OUT_OF_RANGE,
+	FLOATING_LITERAL_INEXACT,
+	EVALUATION_ERROR,   // an operator reported an error evaluating an expression
+};
+
+// An error found in a source, recorded without formatting or allocating. The
+// token the error is about is kept as its place in the source, so messages
+// that quote it are rendered from the source later. Evaluation errors keep
+// the message of the operator, a string literal, and the position of the
+// node reporting it.
+struct diagnostic
+{
+	diagnostic_code code;
+	diagnostic_id   id;
+	std::uint32_t   line;
+	std::uint32_t   column;
+	std::uint32_t   offset;   // start of the token text in the source
+	std::uint32_t   length;   // length of the token text
+	const char*     message{ nullptr };   // text of EVALUATION_ERROR diagnostics
+};
+
+const char* diagnostic_text(diagnostic_id id);
+diagnostic_code diagnostic_code_of(diagnostic_id id);
+// Writes each diagnostic as "Line L, pos C: message", quoting the token text
+// from source where the message names it.
+void write_diagnostics(std::ostream& output, std::span<const diagnostic> diagnostics, std::string_view source);
+
+// The diagnostics of one parse or evaluation. At most limit of them are kept,
+// and the ones after are only counted, so a flood of errors costs neither
+// memory nor time. With fail_fast set the parse stops at the first error.
+class diagnostic_buffer
+{
+public:
+	static constexpr size_t default_limit = 32;
+	explicit diagnostic_buffer(size_t limit = default_limit, bool fail_fast = false) :
+		_limit{ limit }, _fail_fast{ fail_fast }
+	{}
+	// Records a diagnostic. Returns false if the parse is to stop.
+	bool add(diagnostic_id id, size_t line, size_t column, size_t offset, size_t length);
+	// Records an error an operator reported at the given position.
+	bool add(const char* message, size_t line, size_t column);
+	// Records a diagnostic taken from another buffer.
+	bool add(const diagnostic& record);
+	void clear()
+	{
+		_records.clear();
+		_count = 0;
+	}
+	std::span<const diagnostic> records() const
+	{
+		return _records;
+	}
+	// Diagnostics added since the last clear, including those over the limit.
+	size_t count() const
+	{
+		return _count;
+	}
+	bool empty() const
+	{
+		return _count == 0;
+	}
+	size_t limit() const
+	{
+		return _limit;
+	}
+	void set_limit(size_t limit)
+	{
+		_limit = limit;
+	}
+	bool fail_fast() const
+	{
+		return _fail_fast;
+	}
+	void set_fail_fast(bool fail_fast)
+	{
+		_fail_fast = fail_fast;
+	}
+	// Writes the kept diagnostics, and how many more there were, in one write.
+	void write(std::ostream& output, std::string_view source) const;
+private:
+	std::vector<diagnostic> _records;
+	size_t _count{ 0 };
+	size_t _limit;
+	bool _fail_fast;
+};
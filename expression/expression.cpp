@@ -6,20 +6,61 @@
 #include <iostream>
 #include <sstream>
 
+#include "line_evaluator.h"
+#include "mapped_file.h"
 #include "parser.h"
+#include "profile.h"
 
-int main()
+// expression <input> [<output>] evaluates every line of input and writes the
+// values to output, or to the standard output. Without arguments the
+// expression in first.exp is evaluated. Profiling builds then write the
+// operator counters to the standard error.
+int main(int argc, char* argv[])
 {
+	if (argc > 1)
+	{
+		std::ios::sync_with_stdio(false);
+		mapped_file input{ argv[1] };
+		if (!input.is_open())
+		{
+			std::cerr << "File not found" << std::endl;
+			return EXIT_FAILURE;
+		}
+		std::ofstream file;
+		if (argc > 2)
+		{
+			file.open(argv[2], std::ios::binary);
+			if (!file)
+			{
+				std::cerr << "Cannot write " << argv[2] << std::endl;
+				return EXIT_FAILURE;
+			}
+		}
+		auto failures{ 0 };
+		{
+			line_evaluator evaluator{ argc > 2 ? static_cast<std::ostream&>(file) : std::cout };
+			evaluator.evaluate(input.contents());
+			failures = evaluator.failures() != 0;
+		}
+#if EXPRESSION_PROFILE
+		profile::write(std::cerr);
+#endif
+		return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
 	parser parser{ "first.exp" };
 	token_value value{ 0 };
 	if (!parser.parse(value))
 	{
+		parser.diagnostics().write(std::cerr, parser.source());
 		std::cerr << "Parsing failed." << std::endl;
 		return EXIT_FAILURE;
 	}
 	std::visit([](auto&& arg) {
 		std::cout << "Result: " << arg << std::endl;
 		}, value);
+#if EXPRESSION_PROFILE
+	profile::write(std::cerr);
+#endif
 	return EXIT_SUCCESS;
 }
 
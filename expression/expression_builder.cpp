@@ -0,0 +1,197 @@
+#include <charconv>
+#include <cmath>
+#include <limits>
+
+#include "expression_builder.h"
+
+namespace
+{
+	const char* operator_text(token_kind kind)
+	{
+		switch (kind)
+		{
+		case token_kind::STAR: return "*";
+		case token_kind::SLASH: return "/";
+		case token_kind::PERCENT: return "%";
+		case token_kind::PLUS: return "+";
+		case token_kind::DASH: return "-";
+		case token_kind::LESS_LESS: return "<<";
+		case token_kind::GREATER_GREATER: return ">>";
+		case token_kind::LESS: return "<";
+		case token_kind::LESS_EQUAL: return "<=";
+		case token_kind::GREATER: return ">";
+		case token_kind::GREATER_EQUAL: return ">=";
+		case token_kind::EQUAL_EQUAL: return "==";
+		case token_kind::EXCLAIM_EQUAL: return "!=";
+		case token_kind::AMP: return "&";
+		case token_kind::CARET: return "^";
+		case token_kind::BAR: return "|";
+		case token_kind::AMP_AMP: return "&&";
+		case token_kind::BAR_BAR: return "||";
+		case token_kind::TILDE: return "~";
+		case token_kind::EXCLAIM: return "!";
+		case token_kind::QUESTION: return "?";
+		case token_kind::COLON: return ":";
+		default: return "";
+		}
+	}
+
+	// Kind and suffix of the literal the parser reads for a value of the type.
+	// Types narrower than int are written as int literals; add_literal writes
+	// bool as a comparison.
+	struct literal_form
+	{
+		token_kind kind;
+		const char* suffix;
+	};
+
+	template <typename T>
+	constexpr literal_form form_of()
+	{
+		if constexpr (std::is_same_v<T, unsigned int>)
+			return { token_kind::UNSIGNED_INT_LITERAL, "u" };
+		else if constexpr (std::is_same_v<T, long>)
+			return { token_kind::LONG_LITERAL, "l" };
+		else if constexpr (std::is_same_v<T, unsigned long>)
+			return { token_kind::UNSIGNED_LONG_LITERAL, "ul" };
+		else if constexpr (std::is_same_v<T, long long>)
+			return { token_kind::LONG_LONG_LITERAL, "ll" };
+		else if constexpr (std::is_same_v<T, unsigned long long>)
+			return { token_kind::UNSIGNED_LONG_LONG_LITERAL, "ull" };
+		else if constexpr (std::is_same_v<T, float>)
+			return { token_kind::FLOAT_LITERAL, "f" };
+		else if constexpr (std::is_same_v<T, double>)
+			return { token_kind::DOUBLE_LITERAL, "" };
+		else
+			return { token_kind::INT_LITERAL, "" };
+	}
+}
+
+void expressions::report(size_t column, const char* message, diagnostic_buffer& diagnostics)
+{
+	diagnostics.add(message, 1, column);
+}
+
+token expression_builder::write(token_kind kind)
+{
+	token op{ kind, 1, _source.size() + 1, {}, _source.size() };
+	_source += operator_text(kind);
+	op.length = _source.size() - op.offset;
+	return op;
+}
+
+// Shortest text that reads back as the value; floating point values get a
+// fraction so they are not read as integers.
+token expression_builder::write_literal(const token_value& value)
+{
+	token literal{ token_kind::INT_LITERAL, 1, _source.size() + 1, value, _source.size() };
+	std::visit([this, &literal](auto number)
+	{
+		using T = decltype(number);
+		char text[64];
+		auto end = text;
+		if constexpr (std::is_same_v<T, bool>)
+			end = std::to_chars(text, text + sizeof(text), static_cast<int>(number)).ptr;
+		else
+			end = std::to_chars(text, text + sizeof(text), number).ptr;
+		_source.append(text, end);
+		if constexpr (std::is_floating_point_v<T>)
+		{
+			if (std::string_view{ text, end }.find_first_of(".einf") == std::string_view::npos)
+				_source += ".0";
+		}
+		constexpr auto form = form_of<T>();
+		_source += form.suffix;
+		literal.kind = form.kind;
+	}, value);
+	literal.length = _source.size() - literal.offset;
+	return literal;
+}
+
+// The parser reads a - before a literal as a unary minus, so a negative value
+// is the negation of its magnitude. The lowest value of a signed type, whose
+// magnitude the type does not hold, is (-max - 1). bool has no literal and is
+// written as the comparison (0 == 0) or (0 != 0). Other types narrower than
+// int are written as int literals, with their sign.
+size_t expression_builder::add_literal(const token_value& value)
+{
+	return std::visit([this, &value](auto number) -> size_t
+	{
+		using T = decltype(number);
+		if constexpr (std::is_same_v<T, bool>)
+		{
+			_source += '(';
+			auto left = _tree->add_literal(write_literal(0));
+			_source += ' ';
+			auto op = write(number ? token_kind::EQUAL_EQUAL : token_kind::EXCLAIM_EQUAL);
+			_source += ' ';
+			auto right = _tree->add_literal(write_literal(0));
+			_source += ')';
+			return _tree->add_binary(op, left, right);
+		}
+		else if constexpr (std::is_signed_v<T> && sizeof(T) >= sizeof(int))
+		{
+			if constexpr (std::is_integral_v<T>)
+			{
+				if (number == std::numeric_limits<T>::min())
+				{
+					_source += '(';
+					auto lowest = add_literal(static_cast<T>(-std::numeric_limits<T>::max()));
+					_source += ' ';
+					auto op = write(token_kind::DASH);
+					_source += ' ';
+					auto one = _tree->add_literal(write_literal(T{ 1 }));
+					_source += ')';
+					return _tree->add_binary(op, lowest, one);
+				}
+			}
+			if (std::signbit(number))
+			{
+				auto op = write(token_kind::DASH);
+				auto magnitude = add_literal(static_cast<T>(-number));
+				return _tree->add_unary(op, magnitude);
+			}
+		}
+		return _tree->add_literal(write_literal(value));
+	}, value);
+}
+
+token expression_builder::write_identifier(std::string_view name)
+{
+	token identifier{ token_kind::IDENTIFIER, 1, _source.size() + 1, {}, _source.size(), name.size() };
+	_source += name;
+	return identifier;
+}
+
+bool expression_builder::resolve(const token& identifier, size_t& slot, size_t& type)
+{
+	auto name = std::string_view{ _source }.substr(identifier.offset, identifier.length);
+	if (!_variables->resolve(name, slot))
+	{
+		error(diagnostic_id::UNKNOWN_IDENTIFIER, identifier);
+		return false;
+	}
+	if (slot >= _slot_types.size())
+	{
+		_slot_types.resize(slot + 1, dynamic_type);
+		_slot_positions.resize(slot + 1);
+	}
+	if (_slot_positions[slot].line == 0)
+		_slot_positions[slot] = { identifier.line, identifier.column };
+	auto declared = _slot_types[slot] != dynamic_type ? _slot_types[slot] : _variables->type(slot);
+	if (type != dynamic_type && declared != dynamic_type && type != declared)
+	{
+		error(diagnostic_id::VARIABLE_TYPE_CONFLICT, identifier);
+		return false;
+	}
+	if (type == dynamic_type)
+		type = declared;
+	_slot_types[slot] = type;
+	return true;
+}
+
+void expression_builder::error(diagnostic_id id, const token& token)
+{
+	_valid = false;
+	_diagnostics->add(id, token.line, token.column, token.offset, token.length);
+}
@@ -0,0 +1,629 @@
+#pragma once
+
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "compiled_expression.h"
+#include "diagnostics.h"
+#include "expression_tree.h"
+#include "operators.h"
+#include "optimizer.h"
+#include "precedence.h"
+#include "token.h"
+#include "variables.h"
+
+// Expressions written in C++ instead of text:
+//
+//     using namespace expressions;
+//     auto e = var<int>("x") * 3 + lit(1) < var<double>("y");
+//
+// var<T> is a variable whose values have type T, var without a type one whose
+// type is only known at evaluation; lit and plain values are literals of their
+// type. An operator not defined for the static types of its operands does not
+// compile. With a dynamic operand its type errors are reported at evaluation,
+// as for parsed expressions. The operators build a value whose type is the
+// expression; expression_builder adds its nodes to an expression_tree without
+// scanning or parsing text, and typed_function evaluates an expression of
+// static types only with every operator inlined for its operand types.
+namespace expressions
+{
+	template <typename T, typename V>
+	struct is_alternative : std::false_type
+	{};
+
+	template <typename T, typename... A>
+	struct is_alternative<T, std::variant<A...>> : std::bool_constant<(std::is_same_v<T, A> || ...)>
+	{};
+
+	// Whether T is one of the types of token_value.
+	template <typename T>
+	constexpr bool is_value_type = is_alternative<T, token_value>::value;
+
+	// The value type of an expression whose type is only known at evaluation.
+	template <typename T>
+	constexpr bool is_dynamic = std::is_same_v<T, token_value>;
+
+	template <typename operation, typename T>
+	constexpr auto unary_value()
+	{
+		if constexpr (is_dynamic<T>)
+			return token_value{};
+		else
+			return operators::unary_result<operation, T>();
+	}
+
+	template <typename operation, typename T1, typename T2>
+	constexpr auto binary_value()
+	{
+		if constexpr (is_dynamic<T1> || is_dynamic<T2>)
+			return token_value{};
+		else
+			return operators::binary_result<operation, T1, T2>();
+	}
+
+	// Value type of an operator, token_value if an operand is dynamic.
+	template <typename operation, typename T>
+	using unary_value_t = decltype(unary_value<operation, T>());
+
+	template <typename operation, typename T1, typename T2>
+	using binary_value_t = decltype(binary_value<operation, T1, T2>());
+
+	// Token kind of the operators members, as the parser reads them.
+	template <typename operation>
+	constexpr token_kind operation_kind = token_kind::UNDEFINED;
+
+#define X(name, member, kind) \
+	template <> \
+	inline constexpr token_kind operation_kind<operators::member> = token_kind::kind;
+	EXPRESSION_BINARY_OPERATIONS(X)
+	EXPRESSION_UNARY_OPERATIONS(X)
+#undef X
+
+	// Records an error typed_function reports at column of line 1.
+	void report(size_t column, const char* message, diagnostic_buffer& diagnostics);
+
+	// The nodes of an expression. column is where the node is in the text
+	// expression_builder writes for it, and slot the value slot of a variable;
+	// the builder sets both. evaluate is only used by typed_function, where
+	// every type is static.
+	template <typename T>
+	struct literal
+	{
+		using value_type = T;
+		static constexpr bool is_static = true;
+		T value;
+		size_t column{ 0 };
+		value_type evaluate(std::span<const token_value>, diagnostic_buffer&) const
+		{
+			return value;
+		}
+	};
+
+	// The name is not copied, so it must outlive building the expression.
+	template <typename T>
+	struct variable
+	{
+		using value_type = T;
+		static constexpr bool is_static = !is_dynamic<T>;
+		std::string_view name;
+		size_t slot{ 0 };
+		size_t column{ 0 };
+		value_type evaluate(std::span<const token_value> slots, diagnostic_buffer&) const
+		{
+			return *std::get_if<T>(&slots[slot]);
+		}
+	};
+
+	template <typename operation, typename E>
+	struct unary
+	{
+		using value_type = unary_value_t<operation, typename E::value_type>;
+		static constexpr bool is_static = E::is_static;
+		E operand;
+		size_t column{ 0 };
+		value_type evaluate(std::span<const token_value> slots, diagnostic_buffer& diagnostics) const
+		{
+			return operation::apply(operand.evaluate(slots, diagnostics));
+		}
+	};
+
+	template <typename operation, typename L, typename R>
+	struct binary
+	{
+		using value_type = binary_value_t<operation, typename L::value_type, typename R::value_type>;
+		static constexpr bool is_static = L::is_static && R::is_static;
+		static constexpr token_kind kind = operation_kind<operation>;
+		L left;
+		R right;
+		size_t column{ 0 };
+		value_type evaluate(std::span<const token_value> slots, diagnostic_buffer& diagnostics) const
+		{
+			auto a = left.evaluate(slots, diagnostics);
+			if constexpr (std::is_same_v<operation, operators::logical_and> || std::is_same_v<operation, operators::logical_or>)
+			{
+				// The right operand is not evaluated if the left one decides.
+				constexpr auto decides = std::is_same_v<operation, operators::logical_or>;
+				if (static_cast<bool>(a) == decides)
+					return decides;
+			}
+			auto b = right.evaluate(slots, diagnostics);
+			if (auto message = operation::check(a, b))
+			{
+				report(column, message, diagnostics);
+				return static_cast<value_type>(operation::fallback(a, b));
+			}
+			return operation::apply(a, b);
+		}
+	};
+
+	// The value of the branch taken, which is not converted, so the type is
+	// only static if both branches have the same one.
+	template <typename C, typename T, typename E>
+	struct conditional
+	{
+		using value_type = std::conditional_t<std::is_same_v<typename T::value_type, typename E::value_type>,
+			typename T::value_type, token_value>;
+		static constexpr bool is_static = C::is_static && T::is_static && E::is_static && !is_dynamic<value_type>;
+		static constexpr token_kind kind = token_kind::QUESTION;
+		C condition;
+		T then_branch;
+		E else_branch;
+		size_t column{ 0 };
+		value_type evaluate(std::span<const token_value> slots, diagnostic_buffer& diagnostics) const
+		{
+			if (static_cast<bool>(condition.evaluate(slots, diagnostics)))
+				return then_branch.evaluate(slots, diagnostics);
+			return else_branch.evaluate(slots, diagnostics);
+		}
+	};
+
+	template <typename T>
+	struct is_expression_node : std::false_type
+	{};
+
+	template <typename T>
+	struct is_expression_node<literal<T>> : std::true_type
+	{};
+
+	template <typename T>
+	struct is_expression_node<variable<T>> : std::true_type
+	{};
+
+	template <typename operation, typename E>
+	struct is_expression_node<unary<operation, E>> : std::true_type
+	{};
+
+	template <typename operation, typename L, typename R>
+	struct is_expression_node<binary<operation, L, R>> : std::true_type
+	{};
+
+	template <typename C, typename T, typename E>
+	struct is_expression_node<conditional<C, T, E>> : std::true_type
+	{};
+
+	template <typename T>
+	concept expression = is_expression_node<std::remove_cvref_t<T>>::value;
+
+	// What an operator takes: an expression or a value that is a literal.
+	template <typename T>
+	concept operand = expression<T> || is_value_type<std::remove_cvref_t<T>>;
+
+	template <operand T>
+	constexpr auto as_expression(const T& value)
+	{
+		if constexpr (expression<T>)
+			return value;
+		else
+			return literal<T>{ value };
+	}
+
+	template <typename T>
+	using expression_t = decltype(as_expression(std::declval<T>()));
+
+	template <typename operation, typename L, typename R>
+	constexpr bool binary_defined = is_dynamic<typename L::value_type> || is_dynamic<typename R::value_type>
+		|| operation::template defined<typename L::value_type, typename R::value_type>;
+
+	template <typename operation, typename E>
+	constexpr bool unary_defined = is_dynamic<typename E::value_type>
+		|| operation::template defined<typename E::value_type>;
+
+	template <typename T = token_value>
+		requires is_value_type<T> || is_dynamic<T>
+	constexpr variable<T> var(std::string_view name)
+	{
+		return { name };
+	}
+
+	template <typename T>
+		requires is_value_type<T>
+	constexpr literal<T> lit(T value)
+	{
+		return { value };
+	}
+
+	// condition ? then_branch : else_branch, which C++ does not let overload.
+	template <operand C, operand T, operand E>
+	constexpr auto cond(const C& condition, const T& then_branch, const E& else_branch)
+	{
+		return conditional<expression_t<C>, expression_t<T>, expression_t<E>>{ as_expression(condition),
+			as_expression(then_branch), as_expression(else_branch) };
+	}
+
+#define EXPRESSION_BUILDER_BINARY(symbol, member) \
+	template <operand L, operand R> \
+		requires (expression<L> || expression<R>) && binary_defined<operators::member, expression_t<L>, expression_t<R>> \
+	constexpr auto operator symbol(const L& left, const R& right) \
+	{ \
+		return binary<operators::member, expression_t<L>, expression_t<R>>{ as_expression(left), as_expression(right) }; \
+	}
+	EXPRESSION_BUILDER_BINARY(*, multiply)
+	EXPRESSION_BUILDER_BINARY(/, divide)
+	EXPRESSION_BUILDER_BINARY(%, modulus)
+	EXPRESSION_BUILDER_BINARY(+, add)
+	EXPRESSION_BUILDER_BINARY(-, subtract)
+	EXPRESSION_BUILDER_BINARY(<<, left_shift)
+	EXPRESSION_BUILDER_BINARY(>>, right_shift)
+	EXPRESSION_BUILDER_BINARY(<, less)
+	EXPRESSION_BUILDER_BINARY(<=, less_equal)
+	EXPRESSION_BUILDER_BINARY(>, greater)
+	EXPRESSION_BUILDER_BINARY(>=, greater_equal)
+	EXPRESSION_BUILDER_BINARY(==, equal)
+	EXPRESSION_BUILDER_BINARY(!=, not_equal)
+	EXPRESSION_BUILDER_BINARY(&, bitwise_and)
+	EXPRESSION_BUILDER_BINARY(^, bitwise_exclusive_or)
+	EXPRESSION_BUILDER_BINARY(|, bitwise_or)
+	EXPRESSION_BUILDER_BINARY(&&, logical_and)
+	EXPRESSION_BUILDER_BINARY(||, logical_or)
+#undef EXPRESSION_BUILDER_BINARY
+
+#define EXPRESSION_BUILDER_UNARY(symbol, member) \
+	template <expression E> \
+		requires unary_defined<operators::member, std::remove_cvref_t<E>> \
+	constexpr auto operator symbol(const E& operand) \
+	{ \
+		return unary<operators::member, std::remove_cvref_t<E>>{ operand }; \
+	}
+	EXPRESSION_BUILDER_UNARY(-, negate)
+	EXPRESSION_BUILDER_UNARY(~, bitwise_not)
+	EXPRESSION_BUILDER_UNARY(!, not_)
+#undef EXPRESSION_BUILDER_UNARY
+
+	// The parser drops a unary +, so it is the operand itself.
+	template <expression E>
+	constexpr auto operator+(const E& operand)
+	{
+		return operand;
+	}
+}
+
+// Adds expressions written with the expressions templates to an
+// expression_tree: node for node what the parser adds for the text source()
+// gives, then optimized and typed as parser::compile does. Variables are
+// resolved against a variables table as by the parser; a typed variable takes
+// the type the table declares for it, if any, and a conflicting one is an
+// error. Errors are recorded in a diagnostic_buffer and refer to source().
+class expression_builder
+{
+public:
+	explicit expression_builder(variables& variables) : _variables{ &variables }
+	{}
+	// Where the diagnostics are recorded, a buffer of the builder's own unless set.
+	void set_diagnostics(diagnostic_buffer& diagnostics)
+	{
+		_diagnostics = &diagnostics;
+	}
+	const diagnostic_buffer& diagnostics() const
+	{
+		return *_diagnostics;
+	}
+	// The last expression built written as text, with the parentheses the
+	// precedence of its operators needs.
+	std::string_view source() const
+	{
+		return _source;
+	}
+	// Declared types of the slots the last expression built reads, dynamic_type
+	// for the others, as the tree has them.
+	std::span<const size_t> slot_types() const
+	{
+		return _slot_types;
+	}
+	// Positions of the first variables reading the slots, as the tree has them.
+	std::span<const source_position> slot_positions() const
+	{
+		return _slot_positions;
+	}
+	template <typename E>
+		requires expressions::expression<E>
+	bool build(const E& expression, expression_tree& tree);
+	// Resolves the slots of the variables of expression and sets the columns of
+	// its nodes, as build does, without optimizing the tree.
+	template <typename E>
+		requires expressions::expression<E>
+	bool bind(E& expression);
+private:
+	variables* _variables;
+	diagnostic_buffer _own_diagnostics;
+	diagnostic_buffer* _diagnostics{ &_own_diagnostics };
+	expression_tree* _tree{ nullptr };
+	std::string _source;
+	std::vector<size_t> _slot_types;
+	std::vector<source_position> _slot_positions;
+	bool _valid{ true };
+	template <typename E>
+	bool add_root(E& expression, expression_tree& tree);
+	// Appends the text of an operator or literal to the source and returns its
+	// token, at the position it has there.
+	token write(token_kind kind);
+	token write_literal(const token_value& value);
+	// Writes a literal and adds its nodes, as the parser reads the text.
+	size_t add_literal(const token_value& value);
+	token write_identifier(std::string_view name);
+	// Resolves the slot of a variable and checks its type against the types
+	// declared for the slot, which a typed variable sets.
+	bool resolve(const token& identifier, size_t& slot, size_t& type);
+	void error(diagnostic_id id, const token& token);
+	template <typename E>
+	static constexpr bool needs_parentheses(operator_precedence parent, bool right);
+	template <typename E>
+	size_t add_operand(E& node, operator_precedence parent, bool right);
+	template <typename T>
+	size_t add(expressions::literal<T>& node);
+	template <typename T>
+	size_t add(expressions::variable<T>& node);
+	template <typename operation, typename E>
+	size_t add(expressions::unary<operation, E>& node);
+	template <typename operation, typename L, typename R>
+	size_t add(expressions::binary<operation, L, R>& node);
+	template <typename C, typename T, typename E>
+	size_t add(expressions::conditional<C, T, E>& node);
+};
+
+template <typename E>
+	requires expressions::expression<E>
+bool expression_builder::build(const E& expression, expression_tree& tree)
+{
+	auto nodes{ expression };
+	if (!add_root(nodes, tree))
+		return false;
+	optimizer{}.optimize(tree);
+	tree.infer_types();
+	return true;
+}
+
+template <typename E>
+	requires expressions::expression<E>
+bool expression_builder::bind(E& expression)
+{
+	expression_tree tree;
+	return add_root(expression, tree);
+}
+
+template <typename E>
+bool expression_builder::add_root(E& expression, expression_tree& tree)
+{
+	tree.clear();
+	_tree = &tree;
+	_source.clear();
+	_slot_types.clear();
+	_slot_positions.clear();
+	_diagnostics->clear();
+	_valid = true;
+	auto root = add(expression);
+	_tree = nullptr;
+	if (!_valid)
+	{
+		tree.clear();
+		return false;
+	}
+	tree.set_root(root);
+	return true;
+}
+
+// Binary operators and conditionals have the kind of their operator token.
+// Binary operators are left associative, and a conditional is only an operand
+// in parentheses.
+template <typename E>
+constexpr bool expression_builder::needs_parentheses(operator_precedence parent, bool right)
+{
+	if constexpr (requires { E::kind; })
+	{
+		if (E::kind == token_kind::QUESTION)
+			return true;
+		auto own = precedence_table[static_cast<size_t>(E::kind)];
+		return own < parent || (right && own == parent);
+	}
+	else
+	{
+		return false;
+	}
+}
+
+template <typename E>
+size_t expression_builder::add_operand(E& node, operator_precedence parent, bool right)
+{
+	if (!needs_parentheses<E>(parent, right))
+		return add(node);
+	_source += '(';
+	auto index = add(node);
+	_source += ')';
+	return index;
+}
+
+template <typename T>
+size_t expression_builder::add(expressions::literal<T>& node)
+{
+	node.column = _source.size() + 1;
+	return add_literal(node.value);
+}
+
+template <typename T>
+size_t expression_builder::add(expressions::variable<T>& node)
+{
+	auto identifier = write_identifier(node.name);
+	node.column = identifier.column;
+	size_t type{ dynamic_type };
+	if constexpr (!expressions::is_dynamic<T>)
+		type = value_index<T>;
+	if (!resolve(identifier, node.slot, type))
+		return 0;
+	return _tree->add_variable(identifier, node.slot, type);
+}
+
+template <typename operation, typename E>
+size_t expression_builder::add(expressions::unary<operation, E>& node)
+{
+	auto op = write(expressions::operation_kind<operation>);
+	node.column = op.column;
+	auto operand = add_operand(node.operand, operator_precedence::POINT, true);
+	return _tree->add_unary(op, operand);
+}
+
+template <typename operation, typename L, typename R>
+size_t expression_builder::add(expressions::binary<operation, L, R>& node)
+{
+	constexpr auto kind = expressions::operation_kind<operation>;
+	constexpr auto precedence = precedence_table[static_cast<size_t>(kind)];
+	auto left = add_operand(node.left, precedence, false);
+	_source += ' ';
+	auto op = write(kind);
+	_source += ' ';
+	node.column = op.column;
+	// The right operand of && and || is skipped if the left one decides.
+	size_t branch{ 0 };
+	if (kind == token_kind::AMP_AMP || kind == token_kind::BAR_BAR)
+		branch = _tree->add_branch(op, left);
+	auto right = add_operand(node.right, precedence, true);
+	auto index = _tree->add_binary(op, left, right);
+	if (branch != 0)
+		_tree->set_branch_target(branch, index);
+	return index;
+}
+
+template <typename C, typename T, typename E>
+size_t expression_builder::add(expressions::conditional<C, T, E>& node)
+{
+	auto condition = add_operand(node.condition, operator_precedence::LOGICAL_OR, false);
+	_source += ' ';
+	auto question = write(token_kind::QUESTION);
+	_source += ' ';
+	node.column = question.column;
+	auto condition_branch = _tree->add_branch(question, condition);
+	auto then_node = add(node.then_branch);
+	_source += ' ';
+	auto colon = write(token_kind::COLON);
+	_source += ' ';
+	auto then_branch = _tree->add_branch(colon, then_node);
+	_tree->set_branch_target(condition_branch, then_branch + 1);
+	auto else_node = add(node.else_branch);
+	auto index = _tree->add_conditional(question, condition, then_node, else_node);
+	_tree->set_branch_target(then_branch, index);
+	return index;
+}
+
+// An expression of static types only, evaluated with every operator applied
+// to the C++ types of its operands, as the lowered operators of a tree are,
+// but inlined into one function: no nodes are swept, no operator is looked up
+// and no variant is visited. Variables are read from their slots, which are
+// checked once per evaluation for the types of the variables. Values and
+// errors are those of the tree expression_builder builds for it.
+template <typename E>
+	requires expressions::expression<E> && E::is_static
+class typed_function
+{
+public:
+	using value_type = typename E::value_type;
+	// Resolves the variables of expression against the table; bound tells
+	// whether that succeeded, and the errors are recorded in diagnostics.
+	typed_function(const E& expression, variables& variables, diagnostic_buffer& diagnostics) :
+		_expression{ expression }
+	{
+		expression_builder builder{ variables };
+		builder.set_diagnostics(diagnostics);
+		_bound = builder.bind(_expression);
+		auto types = builder.slot_types();
+		_slot_types.assign(types.begin(), types.end());
+		auto positions = builder.slot_positions();
+		_slot_positions.assign(positions.begin(), positions.end());
+	}
+	bool bound() const
+	{
+		return _bound;
+	}
+	// The errors of the evaluation, and missing slot values or values of
+	// another type than their variables, are recorded in diagnostics.
+	bool evaluate(value_type& value, std::span<const token_value> slots, diagnostic_buffer& diagnostics) const
+	{
+		if (!_bound || !check_slot_values(_slot_types, _slot_positions, slots.size(),
+			[&slots](size_t slot) { return slots[slot].index(); }, diagnostics))
+			return false;
+		auto errors = diagnostics.count();
+		value = _expression.evaluate(slots, diagnostics);
+		return diagnostics.count() == errors;
+	}
+	// As above, with the errors written to std::cerr.
+	bool evaluate(value_type& value, std::span<const token_value> slots = {}) const
+	{
+		diagnostic_buffer diagnostics;
+		auto ok = evaluate(value, slots, diagnostics);
+		if (!diagnostics.empty())
+			diagnostics.write(std::cerr, {});
+		return ok;
+	}
+	bool evaluate(token_value& value, std::span<const token_value> slots = {}) const
+	{
+		value_type result{};
+		auto ok = evaluate(result, slots);
+		value = result;
+		return ok;
+	}
+	const E& expression() const
+	{
+		return _expression;
+	}
+private:
+	E _expression;
+	std::vector<size_t> _slot_types;
+	std::vector<source_position> _slot_positions;
+	bool _bound{ false };
+};
+
+namespace expressions
+{
+	// Compiles expression against the variables table, nullptr if it has
+	// errors, as compiled_expression::compile does for source text.
+	template <expression E>
+	std::shared_ptr<const compiled_expression> compile(const E& expression, variables& variables,
+		diagnostic_buffer& diagnostics)
+	{
+		expression_builder builder{ variables };
+		builder.set_diagnostics(diagnostics);
+		expression_tree tree;
+		if (!builder.build(expression, tree))
+			return nullptr;
+		return std::make_shared<const compiled_expression>(std::move(tree));
+	}
+
+	// As above, with the errors written to std::cerr.
+	template <expression E>
+	std::shared_ptr<const compiled_expression> compile(const E& expression, variables& variables)
+	{
+		expression_builder builder{ variables };
+		expression_tree tree;
+		if (!builder.build(expression, tree))
+		{
+			builder.diagnostics().write(std::cerr, builder.source());
+			return nullptr;
+		}
+		return std::make_shared<const compiled_expression>(std::move(tree));
+	}
+}
@@ -0,0 +1,110 @@
+#include <cstdint>
+#include <functional>
+
+#include "expression_cache.h"
+#include "scanner.h"
+
+expression_cache::expression_cache(size_t capacity, size_t shards) : expression_cache(_none, capacity, shards)
+{
+	_none.seal();
+}
+
+expression_cache::expression_cache(variables& variables, size_t capacity, size_t shards) : _variables{ &variables }
+{
+	if (shards == 0)
+		shards = 1;
+	_shard_capacity = capacity / shards + (capacity % shards != 0);
+	if (_shard_capacity == 0)
+		_shard_capacity = 1;
+	for (size_t i = 0; i < shards; ++i)
+		_shards.push_back(std::make_unique<shard>());
+}
+
+// The kinds of the tokens, with the text of those that have more than one
+// spelling, each prefixed by its length.
+std::string expression_cache::key(std::string_view source)
+{
+	std::string key;
+	scanner scanner;
+	scanner.set_source(source);
+	for (;;)
+	{
+		auto token = scanner.next();
+		auto kind = static_cast<std::uint16_t>(token.kind);
+		key.append(reinterpret_cast<const char*>(&kind), sizeof(kind));
+		if (token.kind == token_kind::END_OF_FILE)
+			break;
+		if (token.kind >= token_kind::INT_LITERAL)
+		{
+			auto length = static_cast<std::uint32_t>(token.length);
+			key.append(reinterpret_cast<const char*>(&length), sizeof(length));
+			key.append(scanner.text(token));
+		}
+	}
+	return key;
+}
+
+std::shared_ptr<const compiled_expression> expression_cache::get(std::string_view source)
+{
+	diagnostic_buffer diagnostics;
+	return get(source, diagnostics);
+}
+
+std::shared_ptr<const compiled_expression> expression_cache::get(std::string_view source,
+	diagnostic_buffer& diagnostics)
+{
+	auto key = expression_cache::key(source);
+	auto& shard = *_shards[std::hash<std::string_view>{}(key) % _shards.size()];
+	{
+		std::lock_guard lock{ shard.mutex };
+		auto found = shard.index.find(key);
+		if (found != shard.index.end())
+		{
+			shard.entries.splice(shard.entries.begin(), shard.entries, found->second);
+			shard.hits++;
+			return found->second->expression;
+		}
+		shard.misses++;
+	}
+	auto expression = compiled_expression::compile(source, *_variables, diagnostics);
+	if (!expression)
+		return nullptr;
+	std::lock_guard lock{ shard.mutex };
+	// Another thread may have compiled the same source meanwhile.
+	auto found = shard.index.find(key);
+	if (found != shard.index.end())
+		return found->second->expression;
+	shard.entries.push_front({ std::move(key), expression });
+	shard.index.emplace(shard.entries.front().key, shard.entries.begin());
+	if (shard.entries.size() > _shard_capacity)
+	{
+		shard.index.erase(shard.entries.back().key);
+		shard.entries.pop_back();
+		shard.evictions++;
+	}
+	return expression;
+}
+
+cache_statistics expression_cache::statistics() const
+{
+	cache_statistics statistics;
+	for (const auto& shard : _shards)
+	{
+		std::lock_guard lock{ shard->mutex };
+		statistics.hits += shard->hits;
+		statistics.misses += shard->misses;
+		statistics.evictions += shard->evictions;
+		statistics.size += shard->entries.size();
+	}
+	return statistics;
+}
+
+void expression_cache::clear()
+{
+	for (const auto& shard : _shards)
+	{
+		std::lock_guard lock{ shard->mutex };
+		shard->index.clear();
+		shard->entries.clear();
+	}
+}
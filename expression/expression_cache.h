@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "compiled_expression.h"
+#include "variables.h"
+
+struct cache_statistics
+{
+	size_t hits{ 0 };
+	size_t misses{ 0 };
+	size_t evictions{ 0 };
+	size_t size{ 0 };
+};
+
+// A bounded cache of compiled expressions in front of the parser. Sources are
+// keyed by their tokens as scanner::next produces them, so sources that only
+// differ in whitespace share one entry; diagnostics of a shared entry give the
+// positions in the source it was compiled from. The entries are spread over
+// shards by the hash of the key, each with its own lock and least recently
+// used order, so concurrent lookups rarely wait for each other. Expressions are
+// compiled outside the lock, and sources with errors are not cached.
+//
+// All entries are compiled against the variables table given at construction;
+// it must be sealed if several threads use the cache.
+class expression_cache
+{
+public:
+	explicit expression_cache(size_t capacity, size_t shards = 16);
+	expression_cache(variables& variables, size_t capacity, size_t shards = 16);
+	expression_cache(const expression_cache&) = delete;
+	expression_cache& operator=(const expression_cache&) = delete;
+	// The compiled form of source, nullptr if it has errors, which are
+	// recorded in diagnostics as compiled_expression::compile records them.
+	// A source with errors is compiled again by every lookup, and writes to
+	// no stream the threads share.
+	std::shared_ptr<const compiled_expression> get(std::string_view source, diagnostic_buffer& diagnostics);
+	// As above, with the errors dropped.
+	std::shared_ptr<const compiled_expression> get(std::string_view source);
+	cache_statistics statistics() const;
+	void clear();
+private:
+	struct entry
+	{
+		std::string key;
+		std::shared_ptr<const compiled_expression> expression;
+	};
+	struct alignas(64) shard
+	{
+		mutable std::mutex mutex;
+		std::list<entry> entries;      // most recently used first
+		std::unordered_map<std::string_view, std::list<entry>::iterator> index;   // keys point into entries
+		size_t hits{ 0 };
+		size_t misses{ 0 };
+		size_t evictions{ 0 };
+	};
+	variables _none;
+	variables* _variables;
+	size_t _shard_capacity;
+	std::vector<std::unique_ptr<shard>> _shards;
+	static std::string key(std::string_view source);
+};
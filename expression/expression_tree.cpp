@@ -0,0 +1,279 @@
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <type_traits>
+
+#include "expression_tree.h"
+#include "operations.h"
+#include "profile.h"
+
+static_assert(std::is_trivially_destructible_v<token_value>);
+
+namespace
+{
+	// Evaluates the nodes in storage order, so the operands of a node are
+	// evaluated before it and the root last.
+	class evaluator : public operations
+	{
+	public:
+		evaluator(const expression_tree& tree, std::span<const token_value> slots, diagnostic_buffer& diagnostics) :
+			_tree{ tree }, _slots{ slots }, _diagnostics{ diagnostics }
+		{}
+		token_value evaluate()
+		{
+			// Small expressions keep their values on the stack. The values are
+			// trivially destructible, so every node constructs its value in
+			// place instead of assigning over an initialized one.
+			constexpr size_t local_count = 32;
+			alignas(token_value) std::byte local[local_count * sizeof(token_value)];
+			std::unique_ptr<std::byte[]> allocated;
+			auto storage = local;
+			if (_tree.size() > local_count)
+			{
+				allocated = std::make_unique_for_overwrite<std::byte[]>(_tree.size() * sizeof(token_value));
+				storage = allocated.get();
+			}
+			auto values = reinterpret_cast<token_value*>(storage);
+			for (size_t index = 0; index < _tree.size(); ++index)
+			{
+				const auto& node = _tree.node(index);
+				auto value = values + index;
+				switch (node.kind)
+				{
+				case node_kind::LITERAL:
+					std::construct_at(value, _tree.literal(index));
+					break;
+				case node_kind::VARIABLE:
+					std::construct_at(value, _slots[node.slot]);
+					break;
+				case node_kind::UNARY:
+				{
+					_index = index;
+					EXPRESSION_PROFILE_UNARY(node.op, values[node.left].index(), _errors);
+					if (node.lowered)
+						apply(node, values[node.left], values[node.left], *std::construct_at(value));
+					else
+						std::construct_at(value, unary(node.op, values[node.left]));
+					break;
+				}
+				case node_kind::BRANCH:
+					index = branch(node, values, index);
+					break;
+				case node_kind::CONDITIONAL:
+					// Reached from the else branch; the then branch skips it.
+					std::construct_at(value, values[node.right]);
+					break;
+				case node_kind::BINARY:
+				default:
+				{
+					_index = index;
+					EXPRESSION_PROFILE_BINARY(node.op, values[node.left].index(), values[node.right].index(), _errors);
+					if (node.lowered)
+						apply(node, values[node.left], values[node.right], *std::construct_at(value));
+					else
+						std::construct_at(value, binary(node.op, values[node.left], values[node.right]));
+					break;
+				}
+				}
+			}
+			return values[_tree.root()];
+		}
+		unsigned int errors() const
+		{
+			return _errors;
+		}
+	protected:
+		void error(const char* message) override
+		{
+			const auto& position = _tree.position(_index);
+			_diagnostics.add(message, position.line, position.column);
+			_errors++;
+		}
+	private:
+		const expression_tree& _tree;
+		std::span<const token_value> _slots;
+		diagnostic_buffer& _diagnostics;
+		size_t _index{ 0 };
+		unsigned int _errors{ 0 };
+		void apply(const expression_node& node, const token_value& left, const token_value& right, token_value& value)
+		{
+			if (auto message = node.lowered(left, right, value))
+				error(message);
+		}
+		// Returns the index of the node before the next one to evaluate.
+		static size_t branch(const expression_node& node, token_value* values, size_t index)
+		{
+			const auto& operand = values[node.left];
+			switch (node.op)
+			{
+			case token_kind::AMP_AMP:
+			case token_kind::BAR_BAR:
+			{
+				// Only a logical operand decides; the operator reports the others.
+				auto decides = node.op == token_kind::BAR_BAR;
+				if (operations::is_logical_type(operand.index()) && operations::truth(operand) == decides)
+				{
+					std::construct_at(values + node.right, decides);
+					return node.right;
+				}
+				return index;
+			}
+			case token_kind::QUESTION:
+				return operations::truth(operand) ? index : node.right - 1;
+			case token_kind::COLON:
+			default:
+				std::construct_at(values + node.right, operand);
+				return node.right;
+			}
+		}
+	};
+}
+
+size_t expression_tree::add(const expression_node& node, const token& token)
+{
+	_nodes.push_back(node);
+	_positions.push_back({ token.line, token.column });
+	return _nodes.size() - 1;
+}
+
+size_t expression_tree::add_literal(const token& literal)
+{
+	_literals.push_back(literal.value);
+	expression_node node{ node_kind::LITERAL, literal.kind };
+	node.literal = static_cast<std::uint32_t>(_literals.size() - 1);
+	return add(node, literal);
+}
+
+size_t expression_tree::add_variable(const token& identifier, size_t slot, size_t type)
+{
+	expression_node node{ node_kind::VARIABLE, identifier.kind };
+	node.slot = static_cast<std::uint32_t>(slot);
+	if (slot >= _slot_count)
+	{
+		_slot_count = slot + 1;
+		_slot_types.resize(_slot_count, dynamic_type);
+		_slot_positions.resize(_slot_count);
+	}
+	_slot_types[slot] = type;
+	if (_slot_positions[slot].line == 0)
+		_slot_positions[slot] = { identifier.line, identifier.column };
+	return add(node, identifier);
+}
+
+size_t expression_tree::add_unary(const token& op, size_t operand)
+{
+	expression_node node{ node_kind::UNARY, op.kind };
+	node.left = static_cast<std::uint32_t>(operand);
+	return add(node, op);
+}
+
+size_t expression_tree::add_binary(const token& op, size_t left, size_t right)
+{
+	expression_node node{ node_kind::BINARY, op.kind };
+	node.left = static_cast<std::uint32_t>(left);
+	node.right = static_cast<std::uint32_t>(right);
+	return add(node, op);
+}
+
+size_t expression_tree::add_branch(const token& op, size_t operand)
+{
+	expression_node node{ node_kind::BRANCH, op.kind };
+	node.left = static_cast<std::uint32_t>(operand);
+	return add(node, op);
+}
+
+size_t expression_tree::add_conditional(const token& op, size_t condition, size_t then_branch, size_t else_branch)
+{
+	expression_node node{ node_kind::CONDITIONAL, op.kind };
+	node.left = static_cast<std::uint32_t>(then_branch);
+	node.right = static_cast<std::uint32_t>(else_branch);
+	node.condition = static_cast<std::uint32_t>(condition);
+	return add(node, op);
+}
+
+void expression_tree::infer_types()
+{
+	// Children come before their parents, so their types are known.
+	for (auto& node : _nodes)
+	{
+		size_t type{ dynamic_type };
+		switch (node.kind)
+		{
+		case node_kind::LITERAL:
+			type = _literals[node.literal].index();
+			break;
+		case node_kind::VARIABLE:
+			type = _slot_types[node.slot];
+			break;
+		case node_kind::UNARY:
+			operations::unary_type(node.op, _nodes[node.left].type, type);
+			node.lowered = operations::lower_unary(node.op, _nodes[node.left].type);
+			break;
+		case node_kind::BINARY:
+			operations::binary_type(node.op, _nodes[node.left].type, _nodes[node.right].type, type);
+			node.lowered = operations::lower_binary(node.op, _nodes[node.left].type, _nodes[node.right].type);
+			break;
+		case node_kind::CONDITIONAL:
+			// The value of the branch taken, which is not converted.
+			if (_nodes[node.left].type == _nodes[node.right].type)
+				type = _nodes[node.left].type;
+			break;
+		case node_kind::BRANCH:
+			break;
+		}
+		node.type = static_cast<std::uint8_t>(type);
+	}
+}
+
+std::vector<std::uint32_t> expression_tree::operand_uses() const
+{
+	std::vector<std::uint32_t> uses(_nodes.size());
+	for (const auto& node : _nodes)
+	{
+		switch (node.kind)
+		{
+		case node_kind::UNARY:
+			++uses[node.left];
+			break;
+		case node_kind::BINARY:
+			++uses[node.left];
+			++uses[node.right];
+			break;
+		case node_kind::CONDITIONAL:
+			++uses[node.condition];
+			++uses[node.left];
+			++uses[node.right];
+			break;
+		default:
+			break;
+		}
+	}
+	return uses;
+}
+
+bool expression_tree::evaluate(token_value& value, std::span<const token_value> slots) const
+{
+	diagnostic_buffer diagnostics;
+	auto result = evaluate(value, slots, diagnostics);
+	if (!diagnostics.empty())
+		diagnostics.write(std::cerr, {});
+	return result;
+}
+
+bool expression_tree::evaluate(token_value& value, std::span<const token_value> slots,
+	diagnostic_buffer& diagnostics) const
+{
+	if (_nodes.empty())
+		return false;
+	if (!check_slots(slots, diagnostics))
+		return false;
+	evaluator evaluator{ *this, slots, diagnostics };
+	value = evaluator.evaluate();
+	return evaluator.errors() == 0;
+}
+
+bool expression_tree::check_slots(std::span<const token_value> slots, diagnostic_buffer& diagnostics) const
+{
+	return check_slot_values(_slot_types, _slot_positions, slots.size(),
+		[&slots](size_t slot) { return slots[slot].index(); }, diagnostics);
+}
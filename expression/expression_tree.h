@@ -0,0 +1,211 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "diagnostics.h"
+#include "operations.h"
+#include "token.h"
+
+enum class node_kind : unsigned char
+{
+	LITERAL,
+	VARIABLE,
+	UNARY,
+	BINARY,
+	CONDITIONAL,
+	BRANCH,
+};
+
+// What evaluation reads of a node. Literal values and source positions are
+// kept apart, so a sweep over the nodes touches 24 bytes per node.
+//
+// && and || evaluate their right operand, and a conditional one of its
+// branches, only if needed. A BRANCH node before the nodes that may be skipped
+// decides that when the sweep reaches it: for an && or || node it stores the
+// value of the node if the left operand decides it, and the sweep continues
+// after the node; for the ? of a conditional it continues at the first node of
+// the else branch if the condition is false; for the : it stores the value of
+// the then branch as the value of the conditional and continues after it.
+// Nothing refers to a BRANCH node as an operand.
+struct expression_node
+{
+	expression_node() = default;
+	expression_node(node_kind kind, token_kind op) : kind{ kind }, op{ op }
+	{}
+	node_kind     kind{ node_kind::LITERAL };
+	std::uint8_t  type{ dynamic_type };   // type of the value if no error is reported
+	token_kind    op{ token_kind::UNDEFINED };   // operator of UNARY, BINARY, CONDITIONAL and BRANCH nodes
+	union
+	{
+		std::uint32_t left{ 0 };          // operand of UNARY, left operand of BINARY, then branch of
+		                                  // CONDITIONAL, decisive operand of BRANCH nodes
+		std::uint32_t slot;               // value slot of VARIABLE nodes
+		std::uint32_t literal;            // index of the value of LITERAL nodes
+	};
+	std::uint32_t right{ 0 };             // right operand of BINARY, else branch of CONDITIONAL, target
+	                                      // of BRANCH nodes
+	union
+	{
+		operations::typed_operation lowered{ nullptr };   // operator for the operand types, if known
+		std::uint32_t condition;          // condition of CONDITIONAL nodes
+	};
+};
+
+struct source_position
+{
+	size_t line;
+	size_t column;
+};
+
+// Errors of values given for the variables of an expression, indexed by the
+// type of the variable where its value has another one.
+constexpr const char* missing_value_message = "No value given for the variable.";
+constexpr const char* value_type_messages[value_type_count] = { "Variable expects a value of type bool.",
+	"Variable expects a value of type char.", "Variable expects a value of type unsigned char.",
+	"Variable expects a value of type short.", "Variable expects a value of type unsigned short.",
+	"Variable expects a value of type int.", "Variable expects a value of type unsigned int.",
+	"Variable expects a value of type long.", "Variable expects a value of type unsigned long.",
+	"Variable expects a value of type long long.", "Variable expects a value of type unsigned long long.",
+	"Variable expects a value of type float.", "Variable expects a value of type double." };
+
+// Checks the count values given for the slots of an expression, whose types
+// value_type(slot) gives, against the types the slots declare. Records the
+// first misfit in diagnostics at the position of a variable reading the slot,
+// which slot_positions keeps, line 0 for a slot no variable reads.
+template <typename F>
+bool check_slot_values(std::span<const size_t> slot_types, std::span<const source_position> slot_positions,
+	size_t count, F value_type, diagnostic_buffer& diagnostics)
+{
+	if (count < slot_types.size())
+	{
+		// The last slot is read, as the slots end after it.
+		auto slot = count;
+		while (slot_positions[slot].line == 0)
+			++slot;
+		diagnostics.add(missing_value_message, slot_positions[slot].line, slot_positions[slot].column);
+		return false;
+	}
+	for (size_t slot = 0; slot < slot_types.size(); ++slot)
+	{
+		auto type = slot_types[slot];
+		if (type != dynamic_type && value_type(slot) != type)
+		{
+			diagnostics.add(value_type_messages[type], slot_positions[slot].line, slot_positions[slot].column);
+			return false;
+		}
+	}
+	return true;
+}
+
+// A compiled expression. The parser appends the nodes in post-order, children
+// before their parents and the root last, so the tree can be evaluated any
+// number of times by one sweep over the nodes, without scanning or parsing the
+// source again. After optimization a node can be the operand of several
+// others, and is still evaluated once. The nodes, their positions and the
+// literal values are each stored in one array. Variables are read from the slots passed to evaluate,
+// indexed as resolved by the variables table at compile time. Slots of typed
+// variables must hold a value of that type.
+class expression_tree
+{
+public:
+	size_t add_literal(const token& literal);
+	size_t add_variable(const token& identifier, size_t slot, size_t type = dynamic_type);
+	size_t add_unary(const token& op, size_t operand);
+	size_t add_binary(const token& op, size_t left, size_t right);
+	// Adds the BRANCH node after the left operand of && or ||, or after the
+	// condition or the then branch of a conditional. Its target is set once
+	// the node it belongs to is added.
+	size_t add_branch(const token& op, size_t operand);
+	void set_branch_target(size_t branch, size_t target)
+	{
+		_nodes[branch].right = static_cast<std::uint32_t>(target);
+	}
+	size_t add_conditional(const token& op, size_t condition, size_t then_branch, size_t else_branch);
+	void set_root(size_t root)
+	{
+		_root = root;
+	}
+	void clear()
+	{
+		_nodes.clear();
+		_positions.clear();
+		_literals.clear();
+		_slot_types.clear();
+		_slot_positions.clear();
+		_root = 0;
+		_slot_count = 0;
+	}
+	bool empty() const
+	{
+		return _nodes.empty();
+	}
+	size_t size() const
+	{
+		return _nodes.size();
+	}
+	size_t root() const
+	{
+		return _root;
+	}
+	// Number of values evaluate expects: one past the highest slot referenced.
+	size_t slot_count() const
+	{
+		return _slot_count;
+	}
+	// Declared type of the values of a slot, dynamic_type if it has none.
+	size_t slot_type(size_t slot) const
+	{
+		return _slot_types[slot];
+	}
+	// Declared types of the slots, and the positions of the first variables
+	// reading them, as check_slot_values takes them.
+	std::span<const size_t> slot_types() const
+	{
+		return _slot_types;
+	}
+	std::span<const source_position> slot_positions() const
+	{
+		return _slot_positions;
+	}
+	const expression_node& node(size_t index) const
+	{
+		return _nodes[index];
+	}
+	// Value of a LITERAL node.
+	const token_value& literal(size_t index) const
+	{
+		return _literals[_nodes[index].literal];
+	}
+	// Position of the operator or literal of a node, for diagnostics.
+	const source_position& position(size_t index) const
+	{
+		return _positions[index];
+	}
+	// Annotates every node with the type of its value, where literals and
+	// typed variables determine it, and lowers the operators of nodes whose
+	// operand types are known so evaluating them does not visit the variants.
+	void infer_types();
+	// For every node, how many nodes it is an operand of. BRANCH nodes do not
+	// count, so nodes used more than once are the shared ones.
+	std::vector<std::uint32_t> operand_uses() const;
+	// Errors of the operators and the slot values are written to std::cerr
+	// once the evaluation is done, or recorded in diagnostics, which evaluations on several threads
+	// keep one each of.
+	bool evaluate(token_value& value, std::span<const token_value> slots = {}) const;
+	bool evaluate(token_value& value, std::span<const token_value> slots, diagnostic_buffer& diagnostics) const;
+	// Records a missing slot value, or one of another type than its slot
+	// declares, in diagnostics.
+	bool check_slots(std::span<const token_value> slots, diagnostic_buffer& diagnostics) const;
+private:
+	friend class optimizer;
+	size_t add(const expression_node& node, const token& token);
+	std::vector<expression_node> _nodes;
+	std::vector<source_position> _positions;
+	std::vector<token_value> _literals;
+	std::vector<size_t> _slot_types;
+	std::vector<source_position> _slot_positions;
+	size_t _root{ 0 };
+	size_t _slot_count{ 0 };
+};
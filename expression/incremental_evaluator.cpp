@@ -0,0 +1,293 @@
+#include <cstring>
+#include <iostream>
+
+#include "incremental_evaluator.h"
+#include "profile.h"
+
+namespace
+{
+	// Whether two values have the same type and bits, so -0.0 differs from 0.0.
+	bool same_bits(const token_value& a, const token_value& b)
+	{
+		if (a.index() != b.index())
+			return false;
+		return std::visit([&b](auto value)
+		{
+			auto other = std::get<decltype(value)>(b);
+			return std::memcmp(&value, &other, sizeof(value)) == 0;
+		}, a);
+	}
+
+	template <typename F>
+	void for_each_operand(const expression_node& node, F&& f)
+	{
+		switch (node.kind)
+		{
+		case node_kind::UNARY:
+			f(node.left);
+			break;
+		case node_kind::BINARY:
+			f(node.left);
+			f(node.right);
+			break;
+		case node_kind::CONDITIONAL:
+			f(node.condition);
+			f(node.left);
+			f(node.right);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+incremental_evaluator::incremental_evaluator(const expression_tree& tree) :
+	_tree{ tree }, _values(tree.size()), _stale(tree.size(), true), _failed(tree.size(), false)
+{
+	auto uses = tree.operand_uses();
+	_parent_offsets.resize(tree.size() + 1);
+	for (size_t index = 0; index < tree.size(); ++index)
+		_parent_offsets[index + 1] = _parent_offsets[index] + uses[index];
+	_parents.resize(_parent_offsets.back());
+	_reader_offsets.resize(tree.slot_count() + 1);
+	for (size_t index = 0; index < tree.size(); ++index)
+	{
+		if (tree.node(index).kind == node_kind::VARIABLE)
+			++_reader_offsets[tree.node(index).slot + 1];
+	}
+	for (size_t slot = 0; slot < tree.slot_count(); ++slot)
+		_reader_offsets[slot + 1] += _reader_offsets[slot];
+	_readers.resize(_reader_offsets.back());
+	// Parents are filled from the back of their ranges, counting the uses down.
+	auto readers{ _reader_offsets };
+	for (size_t index = 0; index < tree.size(); ++index)
+	{
+		const auto& node = tree.node(index);
+		if (node.kind == node_kind::VARIABLE)
+			_readers[readers[node.slot]++] = static_cast<std::uint32_t>(index);
+		for_each_operand(node, [&](std::uint32_t operand)
+		{
+			_parents[_parent_offsets[operand] + --uses[operand]] = static_cast<std::uint32_t>(index);
+		});
+	}
+}
+
+bool incremental_evaluator::reset(std::span<const token_value> slots)
+{
+	if (!_tree.check_slots(slots, *_diagnostics))
+	{
+		write_own_diagnostics();
+		return false;
+	}
+	_slots.assign(slots.begin(), slots.begin() + static_cast<std::ptrdiff_t>(_tree.slot_count()));
+	_stale.assign(_tree.size(), true);
+	return true;
+}
+
+bool incremental_evaluator::set(size_t slot, const token_value& value)
+{
+	if (slot >= _slots.size())
+	{
+		const auto& position = _tree.position(_tree.root());
+		_diagnostics->add("The expression has no such variable slot.", position.line, position.column);
+		write_own_diagnostics();
+		return false;
+	}
+	auto type = _tree.slot_type(slot);
+	if (type != dynamic_type && value.index() != type)
+	{
+		const auto& position = _tree.slot_positions()[slot];
+		_diagnostics->add(value_type_messages[type], position.line, position.column);
+		write_own_diagnostics();
+		return false;
+	}
+	if (same_bits(_slots[slot], value))
+		return true;
+	_slots[slot] = value;
+	for (auto i = _reader_offsets[slot]; i < _reader_offsets[slot + 1]; ++i)
+		invalidate(_readers[i]);
+	return true;
+}
+
+bool incremental_evaluator::evaluate(token_value& value)
+{
+	if (_tree.empty())
+		return false;
+	// reset and set checked the types of the values.
+	if (_slots.size() < _tree.slot_count() && !_tree.check_slots(_slots, *_diagnostics))
+	{
+		write_own_diagnostics();
+		return false;
+	}
+	value = this->value(_tree.root());
+	write_own_diagnostics();
+	return !_failed[_tree.root()];
+}
+
+void incremental_evaluator::write_own_diagnostics()
+{
+	if (!_own_diagnostics.empty())
+	{
+		_own_diagnostics.write(std::cerr, {});
+		_own_diagnostics.clear();
+	}
+}
+
+void incremental_evaluator::error(const char* message)
+{
+	const auto& position = _tree.position(_index);
+	_diagnostics->add(message, position.line, position.column);
+	_errors++;
+}
+
+// No node that is up to date used a stale one, so marking stops at the first
+// node marked already.
+void incremental_evaluator::invalidate(size_t index)
+{
+	if (_stale[index])
+		return;
+	_stale[index] = true;
+	_pending.push_back(static_cast<std::uint32_t>(index));
+	while (!_pending.empty())
+	{
+		auto node = _pending.back();
+		_pending.pop_back();
+		for (auto i = _parent_offsets[node]; i < _parent_offsets[node + 1]; ++i)
+		{
+			auto parent = _parents[i];
+			if (!_stale[parent])
+			{
+				_stale[parent] = true;
+				_pending.push_back(parent);
+			}
+		}
+	}
+}
+
+// A node waits on _waiting until the operands it needs are computed, so deep
+// trees take no stack.
+const token_value& incremental_evaluator::value(size_t index)
+{
+	if (!_stale[index])
+		return _values[index];
+	_waiting.push_back(static_cast<std::uint32_t>(index));
+	while (!_waiting.empty())
+	{
+		auto node = _waiting.back();
+		auto operand = stale_operand(node);
+		if (operand != no_node)
+		{
+			_waiting.push_back(operand);
+			continue;
+		}
+		compute(node);
+		_waiting.pop_back();
+	}
+	return _values[index];
+}
+
+// The next operand the node needs that is stale, no_node if none is. The
+// operands before it are up to date.
+std::uint32_t incremental_evaluator::stale_operand(size_t index) const
+{
+	const auto& node = _tree.node(index);
+	switch (node.kind)
+	{
+	case node_kind::UNARY:
+		return _stale[node.left] ? node.left : no_node;
+	case node_kind::CONDITIONAL:
+	{
+		if (_stale[node.condition])
+			return node.condition;
+		auto branch = truth(_values[node.condition]) ? node.left : node.right;
+		return _stale[branch] ? branch : no_node;
+	}
+	case node_kind::BINARY:
+		if (_stale[node.left])
+			return node.left;
+		if (decided(node))
+			return no_node;
+		return _stale[node.right] ? node.right : no_node;
+	default:
+		return no_node;
+	}
+}
+
+// Whether the left operand of a binary node decides its value, so the right
+// one is not needed.
+bool incremental_evaluator::decided(const expression_node& node) const
+{
+	const auto& left = _values[node.left];
+	return (node.op == token_kind::AMP_AMP || node.op == token_kind::BAR_BAR) && is_logical_type(left.index())
+		&& truth(left) == (node.op == token_kind::BAR_BAR);
+}
+
+// The operands the node needs are up to date.
+void incremental_evaluator::compute(size_t index)
+{
+	const auto& node = _tree.node(index);
+	auto& result = _values[index];
+	auto errors = _errors;
+	auto failed{ false };
+	switch (node.kind)
+	{
+	case node_kind::LITERAL:
+		result = _tree.literal(index);
+		break;
+	case node_kind::VARIABLE:
+		result = _slots[node.slot];
+		break;
+	case node_kind::UNARY:
+	{
+		const auto& operand = _values[node.left];
+		_index = index;
+		EXPRESSION_PROFILE_UNARY(node.op, operand.index(), _errors);
+		if (node.lowered)
+		{
+			if (auto message = node.lowered(operand, operand, result))
+				error(message);
+		}
+		else
+		{
+			result = unary(node.op, operand);
+		}
+		failed = _failed[node.left];
+		break;
+	}
+	case node_kind::CONDITIONAL:
+	{
+		auto branch = truth(_values[node.condition]) ? node.left : node.right;
+		result = _values[branch];
+		failed = _failed[node.condition] || _failed[branch];
+		break;
+	}
+	case node_kind::BINARY:
+	default:
+	{
+		const auto& left = _values[node.left];
+		if (decided(node))
+		{
+			result = node.op == token_kind::BAR_BAR;
+			failed = _failed[node.left];
+			break;
+		}
+		const auto& right = _values[node.right];
+		_index = index;
+		EXPRESSION_PROFILE_BINARY(node.op, left.index(), right.index(), _errors);
+		if (node.lowered)
+		{
+			if (auto message = node.lowered(left, right, result))
+				error(message);
+		}
+		else
+		{
+			result = binary(node.op, left, right);
+		}
+		failed = _failed[node.left] || _failed[node.right];
+		break;
+	}
+	}
+	_failed[index] = failed || _errors != errors;
+	_stale[index] = false;
+	++_computed;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "diagnostics.h"
+#include "expression_tree.h"
+#include "operations.h"
+#include "token.h"
+
+// Evaluates a tree again after some of its variables changed, recomputing only
+// the nodes that depend on them. The value of every node evaluated is kept,
+// with the nodes each node is an operand of and the variable nodes of each
+// slot. set marks the nodes that read the slot and the nodes above them
+// stale, and evaluate recomputes the stale nodes the root needs, from the root
+// down: operands && and || do not need and branches a conditional does not
+// take stay stale, as the tree evaluator skips them. Work per evaluation is
+// the nodes on the paths from the changed variables to the root.
+//
+// The tree must outlive the evaluator. Errors are reported when the node
+// reporting them is recomputed, and evaluate fails as long as the value
+// depends on such a node. They are written to std::cerr at the end of the
+// call that reported them, unless a diagnostic_buffer is set.
+class incremental_evaluator : public operations
+{
+public:
+	explicit incremental_evaluator(const expression_tree& tree);
+	incremental_evaluator(const incremental_evaluator&) = delete;
+	incremental_evaluator& operator=(const incremental_evaluator&) = delete;
+	// Sets the values of all slots, and the next evaluate computes every node
+	// it needs.
+	bool reset(std::span<const token_value> slots);
+	// Changes the value of one slot. A value with the same bits changes nothing.
+	bool set(size_t slot, const token_value& value);
+	bool evaluate(token_value& value);
+	// Where the errors of reset, set and evaluate are recorded; the caller
+	// clears it.
+	void set_diagnostics(diagnostic_buffer& diagnostics)
+	{
+		_diagnostics = &diagnostics;
+	}
+	// Nodes computed by the evaluations since construction.
+	size_t computed() const
+	{
+		return _computed;
+	}
+protected:
+	void error(const char* message) override;
+private:
+	const expression_tree& _tree;
+	diagnostic_buffer _own_diagnostics;
+	diagnostic_buffer* _diagnostics{ &_own_diagnostics };
+	std::vector<token_value> _slots;
+	std::vector<token_value> _values;
+	std::vector<bool> _stale;
+	std::vector<bool> _failed;              // the value of the node depends on an error
+	std::vector<std::uint32_t> _parent_offsets;   // nodes with the node as operand, as
+	std::vector<std::uint32_t> _parents;          // _parents[_parent_offsets[i].._parent_offsets[i + 1]]
+	std::vector<std::uint32_t> _reader_offsets;   // VARIABLE nodes of every slot, as
+	std::vector<std::uint32_t> _readers;          // _readers[_reader_offsets[s].._reader_offsets[s + 1]]
+	std::vector<std::uint32_t> _pending;          // nodes whose parents invalidate has still to mark
+	std::vector<std::uint32_t> _waiting;          // nodes value computes once their operands are
+	static constexpr std::uint32_t no_node = ~std::uint32_t{ 0 };
+	size_t _index{ 0 };
+	size_t _computed{ 0 };
+	unsigned int _errors{ 0 };
+	void invalidate(size_t index);
+	const token_value& value(size_t index);
+	std::uint32_t stale_operand(size_t index) const;
+	bool decided(const expression_node& node) const;
+	void compute(size_t index);
+	void write_own_diagnostics();
+};
@@ -0,0 +1,911 @@
+#include <array>
+#include <cstring>
+#include <initializer_list>
+#include <iostream>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "jit.h"
+#include "operations.h"
+
+#if EXPRESSION_JIT
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	template <size_t I>
+	token_value value_from_bits(std::uint64_t bits)
+	{
+		value_t<I> value;
+		std::memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	template <size_t... I>
+	constexpr std::array<token_value (*)(std::uint64_t), sizeof...(I)> make_value_makers(std::index_sequence<I...>)
+	{
+		return { &value_from_bits<I>... };
+	}
+
+	constexpr auto value_makers = make_value_makers(std::make_index_sequence<value_type_count>{});
+
+#if EXPRESSION_JIT
+	struct value_layout
+	{
+		size_t size;
+		bool is_signed;
+		bool is_floating;
+	};
+
+	template <size_t... I>
+	constexpr std::array<value_layout, sizeof...(I)> make_value_layouts(std::index_sequence<I...>)
+	{
+		return { value_layout{ sizeof(value_t<I>), std::is_signed_v<value_t<I>>, std::is_floating_point_v<value_t<I>> }... };
+	}
+
+	constexpr auto layouts = make_value_layouts(std::make_index_sequence<value_type_count>{});
+
+	// Offset of an alternative within a token_value, where the code reads it.
+	template <size_t I>
+	size_t alternative_offset()
+	{
+		token_value value{ std::in_place_index<I> };
+		return reinterpret_cast<const char*>(std::get_if<I>(&value)) - reinterpret_cast<const char*>(&value);
+	}
+
+	template <size_t... I>
+	std::array<size_t, sizeof...(I)> make_alternative_offsets(std::index_sequence<I...>)
+	{
+		return { alternative_offset<I>()... };
+	}
+
+	const auto alternative_offsets = make_alternative_offsets(std::make_index_sequence<value_type_count>{});
+
+	enum reg : unsigned char
+	{
+		RAX = 0,
+		RCX = 1,
+		RDX = 2,
+	};
+
+	constexpr unsigned char REX_W = 0x48;
+
+	unsigned char modrm(unsigned char reg, unsigned char rm)
+	{
+		return static_cast<unsigned char>(0xc0 | (reg << 3) | rm);
+	}
+
+	// Generates the code of a tree, one node at a time. Every node leaves its
+	// value in rax: integers sign or zero extended to 64 bits by their type,
+	// bool as 0 or 1, floating point values as their bits. Binary operators
+	// keep the left operand on the stack while the right one is computed, and
+	// compute with the left operand in rax and the right one in rcx. Values of
+	// nodes the tree shares are stored in a frame below the stack r8 saved on
+	// entry, by the first use, and loaded by the others.
+	class code_generator
+	{
+	public:
+		explicit code_generator(const expression_tree& tree) : _tree{ tree }
+		{}
+		bool generate(std::vector<unsigned char>& code)
+		{
+			if (_tree.empty())
+				return false;
+			auto uses = _tree.operand_uses();
+			_frame_offsets.assign(_tree.size(), 0);
+			_generated.assign(_tree.size(), false);
+			std::int32_t frame{ 0 };
+			for (size_t index = 0; index < _tree.size(); ++index)
+			{
+				auto kind = _tree.node(index).kind;
+				if (uses[index] > 1 && kind != node_kind::LITERAL && kind != node_kind::VARIABLE)
+				{
+					frame += 8;
+					_frame_offsets[index] = -frame;
+				}
+			}
+			emit({ 0x49, 0x89, 0xe0 });                 // mov r8, rsp
+			if (frame != 0)
+			{
+				emit({ REX_W, 0x81, 0xec });            // sub rsp, imm32
+				emit32(static_cast<std::uint32_t>(frame));
+			}
+			if (!generate_node(_tree.root()))
+				return false;
+			if (frame != 0)
+				emit({ 0x4c, 0x89, 0xc4 });             // mov rsp, r8
+			emit({ REX_W, 0x89, 0x06 });                // mov [rsi], rax
+			emit({ 0x31, 0xc0 });                       // xor eax, eax
+			emit({ 0xc3 });                             // ret
+			auto bail = _code.size();
+			emit({ 0x4c, 0x89, 0xc4 });                 // mov rsp, r8
+			emit({ 0xb8, 0x01, 0x00, 0x00, 0x00 });     // mov eax, 1
+			emit({ 0xc3 });                             // ret
+			for (auto jump : _bail_jumps)
+				patch32(jump, static_cast<std::int32_t>(bail - (jump + 4)));
+			code = std::move(_code);
+			return true;
+		}
+	private:
+		const expression_tree& _tree;
+		std::vector<unsigned char> _code;
+		std::vector<size_t> _bail_jumps;      // rel32 operands of jumps to the error exit
+		std::vector<std::int32_t> _frame_offsets;   // offset from r8 of the values of shared nodes, 0 for others
+		std::vector<bool> _generated;         // the value of the shared node is in the frame
+		// A node waiting for its operands to be generated.
+		struct frame
+		{
+			size_t index;
+			size_t operands{ 0 };             // operands requested so far
+			size_t jump{ 0 };                 // rel32 operand to land once the operand is generated
+		};
+		static constexpr size_t done = ~size_t{ 0 };
+		static constexpr size_t failed = done - 1;
+		// Left operands the generated code may keep on its stack at a time,
+		// 512 KiB of it.
+		static constexpr size_t max_pushed = size_t{ 1 } << 16;
+		std::vector<frame> _stack;
+		size_t _pushed{ 0 };
+
+		void emit(std::initializer_list<unsigned char> bytes)
+		{
+			_code.insert(_code.end(), bytes);
+		}
+		void emit32(std::uint32_t value)
+		{
+			for (int i = 0; i < 4; ++i)
+				_code.push_back(static_cast<unsigned char>(value >> (8 * i)));
+		}
+		void emit64(std::uint64_t value)
+		{
+			for (int i = 0; i < 8; ++i)
+				_code.push_back(static_cast<unsigned char>(value >> (8 * i)));
+		}
+		void patch32(size_t at, std::int32_t value)
+		{
+			for (int i = 0; i < 4; ++i)
+				_code[at + i] = static_cast<unsigned char>(static_cast<std::uint32_t>(value) >> (8 * i));
+		}
+		void patch8(size_t at)
+		{
+			_code[at] = static_cast<unsigned char>(_code.size() - (at + 1));
+		}
+		// Emits a jump with a rel32 operand, jcc if condition is not 0, and
+		// returns where the operand is for land.
+		size_t jump(unsigned char condition = 0)
+		{
+			if (condition)
+				emit({ 0x0f, condition });
+			else
+				emit({ 0xe9 });
+			auto at = _code.size();
+			emit32(0);
+			return at;
+		}
+		// Makes a jump continue at the next instruction emitted.
+		void land(size_t at)
+		{
+			patch32(at, static_cast<std::int32_t>(_code.size() - (at + 4)));
+		}
+		// Jumps to the error exit, which leaves the value to the tree, if the
+		// condition holds.
+		void bail_if(unsigned char condition)
+		{
+			emit({ 0x0f, condition });                  // jcc bail
+			_bail_jumps.push_back(_code.size());
+			emit32(0);
+		}
+		void set_condition(unsigned char condition)
+		{
+			emit({ 0x0f, condition, 0xc0 });            // setcc al
+			emit({ 0x0f, 0xb6, 0xc0 });                 // movzx eax, al
+		}
+		void to_xmm(unsigned char xmm, reg r)
+		{
+			emit({ 0x66, REX_W, 0x0f, 0x6e, modrm(xmm, r) });   // movq xmm, r
+		}
+		void from_xmm0(reg r)
+		{
+			emit({ 0x66, REX_W, 0x0f, 0x7e, modrm(0, r) });     // movq r, xmm0
+		}
+		unsigned char sse_prefix(size_t type) const
+		{
+			return layouts[type].size == 4 ? 0xf3 : 0xf2;
+		}
+
+		// Generates the nodes reachable from index. Nodes wait for their
+		// operands on _stack, so deep trees take no stack here.
+		bool generate_node(size_t index)
+		{
+			_stack.clear();
+			_stack.push_back({ index });
+			while (!_stack.empty())
+			{
+				auto& frame = _stack.back();
+				auto offset = _frame_offsets[frame.index];
+				if (frame.operands == 0 && offset != 0 && _generated[frame.index])
+				{
+					emit({ 0x49, 0x8b, 0x80 });         // mov rax, [r8 + disp32]
+					emit32(static_cast<std::uint32_t>(offset));
+					_stack.pop_back();
+					continue;
+				}
+				auto next = generate_value(frame);
+				if (next == failed)
+					return false;
+				if (next != done)
+				{
+					++frame.operands;
+					_stack.push_back({ next });
+					continue;
+				}
+				if (offset != 0)
+				{
+					emit({ 0x49, 0x89, 0x80 });         // mov [r8 + disp32], rax
+					emit32(static_cast<std::uint32_t>(offset));
+					_generated[frame.index] = true;
+				}
+				_stack.pop_back();
+			}
+			return true;
+		}
+
+		// Returns the operand of the node to generate next, done once the
+		// value of the node is in rax or failed if it has no code.
+		size_t generate_value(frame& frame)
+		{
+			const auto& node = _tree.node(frame.index);
+			if (node.type == dynamic_type)
+				return failed;
+			switch (node.kind)
+			{
+			case node_kind::LITERAL:
+				load_literal(_tree.literal(frame.index));
+				return done;
+			case node_kind::VARIABLE:
+				return load_slot(node.slot, node.type) ? done : failed;
+			case node_kind::UNARY:
+				if (frame.operands == 0)
+					return node.left;
+				return unary(node.op, _tree.node(node.left).type) ? done : failed;
+			case node_kind::CONDITIONAL:
+				return conditional(frame, node);
+			case node_kind::BINARY:
+			default:
+				if (node.op == token_kind::AMP_AMP || node.op == token_kind::BAR_BAR)
+					return logical(frame, node);
+				if (frame.operands == 0)
+					return node.left;
+				if (frame.operands == 1)
+				{
+					// The left operands of right nested operators pile up on
+					// the stack of the generated code, which is not unbounded.
+					if (++_pushed > max_pushed)
+						return failed;
+					emit({ 0x50 });                     // push rax
+					return node.right;
+				}
+				--_pushed;
+				emit({ REX_W, 0x89, 0xc1 });            // mov rcx, rax
+				emit({ 0x58 });                         // pop rax
+				return binary(node.op, _tree.node(node.left).type, _tree.node(node.right).type) ? done : failed;
+			}
+		}
+
+		// The right operand is skipped if the left one decides the value, which
+		// is the truth of the last operand computed.
+		size_t logical(frame& frame, const expression_node& node)
+		{
+			switch (frame.operands)
+			{
+			case 0:
+			{
+				size_t type;
+				if (!operations::binary_type(node.op, _tree.node(node.left).type, _tree.node(node.right).type, type))
+					return failed;
+				return node.left;
+			}
+			case 1:
+				emit({ REX_W, 0x85, 0xc0 });            // test rax, rax
+				set_condition(0x95);                    // setne
+				frame.jump = jump(node.op == token_kind::AMP_AMP ? 0x84 : 0x85);   // je / jne done
+				return node.right;
+			default:
+				emit({ REX_W, 0x85, 0xc0 });            // test rax, rax
+				set_condition(0x95);                    // setne
+				land(frame.jump);
+				return done;
+			}
+		}
+
+		size_t conditional(frame& frame, const expression_node& node)
+		{
+			switch (frame.operands)
+			{
+			case 0:
+				return node.condition;
+			case 1:
+			{
+				auto type = _tree.node(node.condition).type;
+				if (layouts[type].is_floating)
+				{
+					// NaN is true, as it is not equal to zero.
+					unary(token_kind::EXCLAIM, type);
+					emit({ 0x85, 0xc0 });               // test eax, eax
+					frame.jump = jump(0x85);            // jne else
+				}
+				else
+				{
+					emit({ REX_W, 0x85, 0xc0 });        // test rax, rax
+					frame.jump = jump(0x84);            // je else
+				}
+				return node.left;
+			}
+			case 2:
+			{
+				auto otherwise = frame.jump;
+				frame.jump = jump();                    // jmp done
+				land(otherwise);
+				return node.right;
+			}
+			default:
+				land(frame.jump);
+				return done;
+			}
+		}
+
+		void load_literal(const token_value& value)
+		{
+			auto bits = std::visit([](auto v) {
+				std::uint64_t bits{ 0 };
+				if constexpr (std::is_floating_point_v<decltype(v)>)
+					std::memcpy(&bits, &v, sizeof(v));
+				else
+					bits = static_cast<std::uint64_t>(v);
+				return bits;
+				}, value);
+			auto extended = static_cast<std::int64_t>(bits);
+			if (bits <= 0xffffffff)
+			{
+				emit({ 0xb8 });                         // mov eax, imm32
+				emit32(static_cast<std::uint32_t>(bits));
+			}
+			else if (extended >= INT32_MIN && extended < 0)
+			{
+				emit({ REX_W, 0xc7, 0xc0 });            // mov rax, simm32
+				emit32(static_cast<std::uint32_t>(bits));
+			}
+			else
+			{
+				emit({ REX_W, 0xb8 });                  // mov rax, imm64
+				emit64(bits);
+			}
+		}
+
+		bool load_slot(size_t slot, size_t type)
+		{
+			auto offset = slot * sizeof(token_value) + alternative_offsets[type];
+			if (offset > INT32_MAX)
+				return false;
+			const auto& layout = layouts[type];
+			// Loads [rdi + disp32] into rax, extended as the type.
+			if (layout.size == 8)
+				emit({ REX_W, 0x8b });
+			else if (layout.size == 4)
+			{
+				if (layout.is_signed && !layout.is_floating)
+					emit({ REX_W, 0x63 });
+				else
+					emit({ 0x8b });
+			}
+			else if (layout.size == 2)
+			{
+				if (layout.is_signed)
+					emit({ REX_W, 0x0f, 0xbf });
+				else
+					emit({ 0x0f, 0xb7 });
+			}
+			else
+			{
+				if (layout.is_signed)
+					emit({ REX_W, 0x0f, 0xbe });
+				else
+					emit({ 0x0f, 0xb6 });
+			}
+			emit({ 0x87 });
+			emit32(static_cast<std::uint32_t>(offset));
+			return true;
+		}
+
+		// Truncates an integer to the type and extends it back to 64 bits.
+		void normalize(reg r, size_t type)
+		{
+			const auto& layout = layouts[type];
+			if (layout.is_floating || layout.size == 8)
+				return;
+			if (layout.size == 4)
+			{
+				if (layout.is_signed)
+					emit({ REX_W, 0x63, modrm(r, r) }); // movsxd r, r32
+				else
+					emit({ 0x89, modrm(r, r) });        // mov r32, r32
+			}
+			else if (layout.size == 2)
+			{
+				if (layout.is_signed)
+					emit({ REX_W, 0x0f, 0xbf, modrm(r, r) });
+				else
+					emit({ 0x0f, 0xb7, modrm(r, r) });
+			}
+			else
+			{
+				if (layout.is_signed)
+					emit({ REX_W, 0x0f, 0xbe, modrm(r, r) });
+				else
+					emit({ 0x0f, 0xb6, modrm(r, r) });
+			}
+		}
+
+		// Converts the value in r as the usual arithmetic conversions do. Only
+		// the conversions between operands of one operator are supported.
+		bool convert(reg r, size_t from, size_t to)
+		{
+			if (from == to)
+				return true;
+			const auto& source = layouts[from];
+			const auto& target = layouts[to];
+			if (to == value_index<bool>)
+				return false;
+			if (!target.is_floating)
+			{
+				if (source.is_floating)
+					return false;
+				normalize(r, to);
+				return true;
+			}
+			if (source.is_floating)
+			{
+				if (target.size < source.size)
+					return false;
+				to_xmm(0, r);
+				emit({ 0xf3, 0x0f, 0x5a, 0xc0 });       // cvtss2sd xmm0, xmm0
+				from_xmm0(r);
+				return true;
+			}
+			auto prefix = sse_prefix(to);
+			if (!source.is_signed && source.size == 8)
+			{
+				// Values with the top bit set are halved, keeping the low bit so
+				// the result rounds as a direct conversion would, and doubled.
+				emit({ REX_W, 0x85, modrm(r, r) });     // test r, r
+				emit({ 0x78, 0x00 });                   // js large
+				auto large = _code.size() - 1;
+				emit({ prefix, REX_W, 0x0f, 0x2a, modrm(0, r) });   // cvtsi2s? xmm0, r
+				emit({ 0xeb, 0x00 });                   // jmp done
+				auto done = _code.size() - 1;
+				patch8(large);
+				emit({ REX_W, 0x89, modrm(r, RDX) });   // mov rdx, r
+				emit({ REX_W, 0xd1, 0xea });            // shr rdx, 1
+				emit({ 0x83, modrm(4, r), 0x01 });      // and r32, 1
+				emit({ REX_W, 0x09, modrm(r, RDX) });   // or rdx, r
+				emit({ prefix, REX_W, 0x0f, 0x2a, 0xc2 });          // cvtsi2s? xmm0, rdx
+				emit({ prefix, 0x0f, 0x58, 0xc0 });     // adds? xmm0, xmm0
+				patch8(done);
+			}
+			else
+			{
+				emit({ prefix, REX_W, 0x0f, 0x2a, modrm(0, r) });   // cvtsi2s? xmm0, r
+			}
+			from_xmm0(r);
+			return true;
+		}
+
+		void clamp_negative(reg r)
+		{
+			emit({ 0x31, 0xd2 });                       // xor edx, edx
+			emit({ REX_W, 0x85, modrm(r, r) });         // test r, r
+			emit({ REX_W, 0x0f, 0x48, modrm(r, RDX) }); // cmovs r, rdx
+		}
+
+		bool unary(token_kind op, size_t operand)
+		{
+			size_t type;
+			if (!operations::unary_type(op, operand, type))
+				return false;
+			const auto& layout = layouts[operand];
+			switch (op)
+			{
+			case token_kind::DASH:
+				if (layout.is_floating)
+				{
+					if (layout.size == 4)
+						emit({ 0x0f, 0xba, 0xf8, 0x1f });           // btc eax, 31
+					else
+						emit({ REX_W, 0x0f, 0xba, 0xf8, 0x3f });    // btc rax, 63
+					return true;
+				}
+				convert(RAX, operand, type);
+				emit({ REX_W, 0xf7, 0xd8 });            // neg rax
+				normalize(RAX, type);
+				return true;
+			case token_kind::TILDE:
+				convert(RAX, operand, type);
+				emit({ REX_W, 0xf7, 0xd0 });            // not rax
+				normalize(RAX, type);
+				return true;
+			case token_kind::EXCLAIM:
+				if (layout.is_floating)
+				{
+					to_xmm(0, RAX);
+					emit({ 0x0f, 0x57, 0xc9 });         // xorps xmm1, xmm1
+					compare_floating(operand, 0xc1);
+					equal_floating(true);
+					return true;
+				}
+				emit({ REX_W, 0x85, 0xc0 });            // test rax, rax
+				set_condition(0x94);                    // sete
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		bool binary(token_kind op, size_t left, size_t right)
+		{
+			size_t type;
+			if (!operations::binary_type(op, left, right, type))
+				return false;
+			switch (op)
+			{
+			case token_kind::STAR:
+			case token_kind::SLASH:
+			case token_kind::PERCENT:
+			case token_kind::PLUS:
+			case token_kind::DASH:
+			case token_kind::AMP:
+			case token_kind::CARET:
+			case token_kind::BAR:
+				return arithmetic(op, left, right, type);
+			case token_kind::LESS_LESS:
+			case token_kind::GREATER_GREATER:
+				return shift(op, left, right, type);
+			case token_kind::LESS:
+			case token_kind::LESS_EQUAL:
+			case token_kind::GREATER:
+			case token_kind::GREATER_EQUAL:
+				return comparison(op, left, right);
+			case token_kind::EQUAL_EQUAL:
+			case token_kind::EXCLAIM_EQUAL:
+				return equality(op == token_kind::EQUAL_EQUAL, left, right);
+			case token_kind::AMP_AMP:
+			case token_kind::BAR_BAR:
+				emit({ REX_W, 0x85, 0xc0 });            // test rax, rax
+				emit({ 0x0f, 0x95, 0xc0 });             // setne al
+				emit({ REX_W, 0x85, 0xc9 });            // test rcx, rcx
+				emit({ 0x0f, 0x95, 0xc1 });             // setne cl
+				if (op == token_kind::AMP_AMP)
+					emit({ 0x20, 0xc8 });               // and al, cl
+				else
+					emit({ 0x08, 0xc8 });               // or al, cl
+				emit({ 0x0f, 0xb6, 0xc0 });             // movzx eax, al
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		bool arithmetic(token_kind op, size_t left, size_t right, size_t type)
+		{
+			if (!convert(RAX, left, type) || !convert(RCX, right, type))
+				return false;
+			const auto& layout = layouts[type];
+			if (layout.is_floating)
+			{
+				unsigned char opcode;
+				switch (op)
+				{
+				case token_kind::PLUS:
+					opcode = 0x58;
+					break;
+				case token_kind::DASH:
+					opcode = 0x5c;
+					break;
+				case token_kind::STAR:
+					opcode = 0x59;
+					break;
+				case token_kind::SLASH:
+					opcode = 0x5e;
+					break;
+				default:
+					return false;
+				}
+				to_xmm(0, RAX);
+				to_xmm(1, RCX);
+				emit({ sse_prefix(type), 0x0f, opcode, 0xc1 });     // op xmm0, xmm1
+				from_xmm0(RAX);
+				return true;
+			}
+			switch (op)
+			{
+			case token_kind::PLUS:
+				emit({ REX_W, 0x01, 0xc8 });            // add rax, rcx
+				break;
+			case token_kind::DASH:
+				emit({ REX_W, 0x29, 0xc8 });            // sub rax, rcx
+				break;
+			case token_kind::STAR:
+				emit({ REX_W, 0x0f, 0xaf, 0xc1 });      // imul rax, rcx
+				break;
+			case token_kind::AMP:
+				emit({ REX_W, 0x21, 0xc8 });            // and rax, rcx
+				break;
+			case token_kind::CARET:
+				emit({ REX_W, 0x31, 0xc8 });            // xor rax, rcx
+				break;
+			case token_kind::BAR:
+				emit({ REX_W, 0x09, 0xc8 });            // or rax, rcx
+				break;
+			case token_kind::SLASH:
+			case token_kind::PERCENT:
+				// Division by zero and of the lowest value by -1 trap, so the
+				// tree reports them.
+				emit({ REX_W, 0x85, 0xc9 });            // test rcx, rcx
+				bail_if(0x84);                          // jz bail
+				if (layout.is_signed)
+				{
+					emit({ REX_W, 0x83, 0xf9, 0xff });  // cmp rcx, -1
+					emit({ 0x75, 0x00 });               // jne divide
+					auto divide = _code.size() - 1;
+					if (layout.size == 8)
+					{
+						emit({ REX_W, 0xba });          // mov rdx, imm64
+						emit64(std::uint64_t{ 1 } << 63);
+						emit({ REX_W, 0x39, 0xd0 });    // cmp rax, rdx
+					}
+					else
+					{
+						emit({ REX_W, 0x3d });          // cmp rax, imm32
+						emit32(std::uint32_t{ 1 } << 31);
+					}
+					bail_if(0x84);                      // je bail
+					patch8(divide);
+				}
+				if (layout.size == 8)
+				{
+					if (layout.is_signed)
+						emit({ REX_W, 0x99, REX_W, 0xf7, 0xf9 });       // cqo; idiv rcx
+					else
+						emit({ 0x31, 0xd2, REX_W, 0xf7, 0xf1 });        // xor edx, edx; div rcx
+				}
+				else
+				{
+					if (layout.is_signed)
+						emit({ 0x99, 0xf7, 0xf9 });                     // cdq; idiv ecx
+					else
+						emit({ 0x31, 0xd2, 0xf7, 0xf1 });               // xor edx, edx; div ecx
+				}
+				if (op == token_kind::PERCENT)
+					emit({ REX_W, 0x89, 0xd0 });        // mov rax, rdx
+				break;
+			default:
+				return false;
+			}
+			normalize(RAX, type);
+			return true;
+		}
+
+		// A count that is negative or not less than the width of the type is an
+		// error; sign extended, a negative count compares above the width.
+		bool shift(token_kind op, size_t left, size_t right, size_t type)
+		{
+			if (!convert(RAX, left, type))
+				return false;
+			const auto& layout = layouts[type];
+			emit({ REX_W, 0x83, modrm(7, RCX), static_cast<unsigned char>(layout.size * 8) });   // cmp rcx, width
+			bail_if(0x83);                              // jae bail
+			unsigned char extension = op == token_kind::LESS_LESS ? 4 : layout.is_signed ? 7 : 5;
+			if (layout.size == 8)
+				emit({ REX_W, 0xd3, modrm(extension, RAX) });       // shl/sar/shr rax, cl
+			else
+				emit({ 0xd3, modrm(extension, RAX) });              // shl/sar/shr eax, cl
+			normalize(RAX, type);
+			return true;
+		}
+
+		// Sets the flags to compare xmm0 and xmm1 in the order of the modrm byte.
+		void compare_floating(size_t type, unsigned char operands)
+		{
+			if (layouts[type].size == 8)
+				emit({ 0x66 });
+			emit({ 0x0f, 0x2e, operands });             // ucomis? x, y
+		}
+
+		// Equality is false for unordered operands.
+		void equal_floating(bool equal)
+		{
+			if (equal)
+			{
+				emit({ 0x0f, 0x94, 0xc0 });             // sete al
+				emit({ 0x0f, 0x9b, 0xc2 });             // setnp dl
+				emit({ 0x20, 0xd0 });                   // and al, dl
+			}
+			else
+			{
+				emit({ 0x0f, 0x95, 0xc0 });             // setne al
+				emit({ 0x0f, 0x9a, 0xc2 });             // setp dl
+				emit({ 0x08, 0xd0 });                   // or al, dl
+			}
+			emit({ 0x0f, 0xb6, 0xc0 });                 // movzx eax, al
+		}
+
+		bool comparison(token_kind op, size_t left, size_t right)
+		{
+			const auto& a = layouts[left];
+			const auto& b = layouts[right];
+			// Signed and unsigned operands compare as operators.h does: the
+			// negative one is clamped to 0 and converted to the other type, and
+			// the right operand is compared with the left one.
+			if (a.is_signed != b.is_signed)
+			{
+				if (a.is_floating || b.is_floating)
+					return false;
+				if (a.is_signed)
+				{
+					clamp_negative(RAX);
+					convert(RAX, left, right);
+				}
+				else
+				{
+					clamp_negative(RCX);
+					convert(RCX, right, left);
+				}
+				emit({ REX_W, 0x39, 0xc1 });            // cmp rcx, rax
+				set_condition(unsigned_condition(op));
+				return true;
+			}
+			size_t common;
+			operations::binary_type(token_kind::PLUS, left, right, common);
+			if (!convert(RAX, left, common) || !convert(RCX, right, common))
+				return false;
+			if (layouts[common].is_floating)
+			{
+				// Unordered operands set CF, so above and above or equal with
+				// the operands in the right order are false for them.
+				to_xmm(0, RAX);
+				to_xmm(1, RCX);
+				auto less = op == token_kind::LESS || op == token_kind::LESS_EQUAL;
+				compare_floating(common, less ? 0xc8 : 0xc1);
+				auto inclusive = op == token_kind::LESS_EQUAL || op == token_kind::GREATER_EQUAL;
+				set_condition(inclusive ? 0x93 : 0x97);
+				return true;
+			}
+			emit({ REX_W, 0x39, 0xc8 });                // cmp rax, rcx
+			set_condition(layouts[common].is_signed ? signed_condition(op) : unsigned_condition(op));
+			return true;
+		}
+
+		static unsigned char signed_condition(token_kind op)
+		{
+			switch (op)
+			{
+			case token_kind::LESS:
+				return 0x9c;        // setl
+			case token_kind::LESS_EQUAL:
+				return 0x9e;        // setle
+			case token_kind::GREATER:
+				return 0x9f;        // setg
+			default:
+				return 0x9d;        // setge
+			}
+		}
+
+		static unsigned char unsigned_condition(token_kind op)
+		{
+			switch (op)
+			{
+			case token_kind::LESS:
+				return 0x92;        // setb
+			case token_kind::LESS_EQUAL:
+				return 0x96;        // setbe
+			case token_kind::GREATER:
+				return 0x97;        // seta
+			default:
+				return 0x93;        // setae
+			}
+		}
+
+		// Values of different types never compare equal.
+		bool equality(bool equal, size_t left, size_t right)
+		{
+			if (left != right)
+			{
+				emit({ 0xb8 });                         // mov eax, imm32
+				emit32(equal ? 0 : 1);
+				return true;
+			}
+			if (layouts[left].is_floating)
+			{
+				to_xmm(0, RAX);
+				to_xmm(1, RCX);
+				compare_floating(left, 0xc1);
+				equal_floating(equal);
+				return true;
+			}
+			emit({ REX_W, 0x39, 0xc8 });                // cmp rax, rcx
+			set_condition(equal ? 0x94 : 0x95);         // sete/setne
+			return true;
+		}
+	};
+#endif
+}
+
+jit::~jit()
+{
+	release();
+}
+
+void jit::release()
+{
+#if EXPRESSION_JIT
+	if (_page)
+		munmap(_page, _page_size);
+#endif
+	_page = nullptr;
+	_page_size = 0;
+	_function = nullptr;
+}
+
+bool jit::compile(const expression_tree& tree)
+{
+	release();
+	_tree = tree;
+	_type = tree.empty() ? dynamic_type : tree.node(tree.root()).type;
+#if EXPRESSION_JIT
+	std::vector<unsigned char> code;
+	if (!code_generator{ _tree }.generate(code))
+		return false;
+	auto page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	auto size = (code.size() + page - 1) / page * page;
+	auto memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (memory == MAP_FAILED)
+		return false;
+	std::memcpy(memory, code.data(), code.size());
+	// The page is never writable and executable at the same time.
+	if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0)
+	{
+		munmap(memory, size);
+		return false;
+	}
+	_page = memory;
+	_page_size = size;
+	_function = reinterpret_cast<function>(memory);
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool jit::evaluate(token_value& value, std::span<const token_value> slots) const
+{
+	diagnostic_buffer diagnostics;
+	auto result = evaluate(value, slots, diagnostics);
+	if (!diagnostics.empty())
+		diagnostics.write(std::cerr, {});
+	return result;
+}
+
+bool jit::evaluate(token_value& value, std::span<const token_value> slots, diagnostic_buffer& diagnostics) const
+{
+	if (!_function || slots.size() < _tree.slot_count())
+		return _tree.evaluate(value, slots, diagnostics);
+	if (!_tree.check_slots(slots, diagnostics))
+		return false;
+	std::uint64_t bits;
+	if (_function(slots.data(), &bits) != 0)
+		return _tree.evaluate(value, slots, diagnostics);
+	value = value_makers[_type](bits);
+	return true;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include "diagnostics.h"
+#include "expression_tree.h"
+#include "profile.h"
+#include "token.h"
+
+// Native code is not counted per operator, so profiling builds evaluate every
+// expression with the tree.
+#if defined(__x86_64__) && defined(__linux__) && !EXPRESSION_PROFILE
+#define EXPRESSION_JIT 1
+#else
+#define EXPRESSION_JIT 0
+#endif
+
+// Compiles an expression tree to x86-64 machine code in an executable page of
+// its own. The code computes every operator with the instructions the
+// element-wise rules in operators.h compile to, so it gives bit-identical
+// values. Expressions the generator cannot handle, such as ones with untyped
+// variables or a type error, are evaluated by the tree instead, and so is any
+// evaluation that has an error to report, such as a negative shift count.
+class jit
+{
+public:
+	jit() = default;
+	jit(const jit&) = delete;
+	jit& operator=(const jit&) = delete;
+	~jit();
+	// Returns false if no native code was generated for the tree; evaluate then
+	// falls back to the tree.
+	bool compile(const expression_tree& tree);
+	bool compiled() const
+	{
+		return _function != nullptr;
+	}
+	bool evaluate(token_value& value, std::span<const token_value> slots = {}) const;
+	// As above, with the errors of the fallback recorded in diagnostics.
+	bool evaluate(token_value& value, std::span<const token_value> slots, diagnostic_buffer& diagnostics) const;
+private:
+	// Returns 0 with the bits of the value in result, or 1 if the value has
+	// an error to report.
+	using function = int (*)(const token_value* slots, std::uint64_t* result);
+	expression_tree _tree;
+	size_t _type{ dynamic_type };   // type of the value the code computes
+	void* _page{ nullptr };
+	size_t _page_size{ 0 };
+	function _function{ nullptr };
+	void release();
+};
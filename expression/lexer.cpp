@@ -0,0 +1,272 @@
+#include <bit>
+#include <cstring>
+#include <limits>
+
+#include "lexer.h"
+#include "simd.h"
+
+namespace
+{
+	constexpr size_t block_size = 64;
+
+	enum character_class : unsigned char
+	{
+		SPACE = 1,
+		DIGIT = 2,
+		WORD = 4,
+	};
+
+	struct class_table
+	{
+		unsigned char classes[256];
+		constexpr class_table() : classes{}
+		{
+			for (unsigned int ch : { ' ', '\t', '\n', '\v', '\f', '\r' })
+				classes[ch] = SPACE;
+			for (unsigned int ch = '0'; ch <= '9'; ++ch)
+				classes[ch] = DIGIT | WORD;
+			for (unsigned int ch = 'a'; ch <= 'z'; ++ch)
+				classes[ch] = classes[ch - 'a' + 'A'] = WORD;
+			classes[static_cast<unsigned int>('_')] = WORD;
+		}
+	};
+
+	constexpr class_table character_classes;
+
+	// Classification for processors without a vector kernel.
+	void scalar_classify(const char* block, character_masks& masks)
+	{
+		masks = {};
+		for (size_t offset = 0; offset < block_size; ++offset)
+		{
+			auto classes = character_classes.classes[static_cast<unsigned char>(block[offset])];
+			masks.space |= static_cast<unsigned long long>((classes & SPACE) != 0) << offset;
+			masks.word |= static_cast<unsigned long long>((classes & WORD) != 0) << offset;
+		}
+	}
+}
+
+lexer::lexer(std::string_view source) : _source{ source }, _done{ false }, _classify{ find_simd_classify_kernel() },
+	_block{ std::numeric_limits<size_t>::max() }
+{
+	if (!_classify)
+		_classify = scalar_classify;
+}
+
+// First position at or after position whose byte is not in the class, or the
+// end of the source.
+size_t lexer::skip(size_t position, unsigned long long character_masks::* mask)
+{
+	while (position < _source.size())
+	{
+		auto block = position / block_size;
+		if (block != _block)
+			classify(block);
+		auto outside = ~(_masks.*mask) >> (position % block_size);
+		if (outside)
+		{
+			position += std::countr_zero(outside);
+			return position < _source.size() ? position : _source.size();
+		}
+		position = (block + 1) * block_size;
+	}
+	return _source.size();
+}
+
+// The last block is padded with bytes in no class.
+void lexer::classify(size_t block)
+{
+	_block = block;
+	auto start = block * block_size;
+	if (_source.size() - start >= block_size)
+	{
+		_classify(_source.data() + start, _masks);
+		return;
+	}
+	char padded[block_size]{};
+	std::memcpy(padded, _source.data() + start, _source.size() - start);
+	_classify(padded, _masks);
+}
+
+// End of the number literal that starts at position with a digit or a point,
+// scanned as a C preprocessing number like scanner::next does.
+size_t lexer::number_end(size_t position)
+{
+	++position;
+	for (;;)
+	{
+		position = skip(position, &character_masks::word);
+		if (position == _source.size())
+			return position;
+		auto ch = _source[position];
+		auto previous = _source[position - 1];
+		auto exponent = previous == 'e' || previous == 'E' || previous == 'p' || previous == 'P';
+		if (ch != '.' && !((ch == '+' || ch == '-') && exponent))
+			return position;
+		++position;
+	}
+}
+
+bool lexer::next(std::vector<lexeme>& lexemes, size_t count)
+{
+	if (_done)
+		return false;
+	auto source = _source;
+	auto end = source.size();
+	auto position = _position;
+	for (; count > 0; --count)
+	{
+		position = skip(position, &character_masks::space);
+		if (position == end)
+		{
+			lexemes.push_back({ token_kind::END_OF_FILE, static_cast<std::uint32_t>(end), 0 });
+			_done = true;
+			break;
+		}
+		auto start = position;
+		auto kind{ token_kind::INVALID_CHARACTER };
+		switch (source[position++])
+		{
+		case '*':
+			kind = token_kind::STAR;
+			break;
+		case '/':
+			kind = token_kind::SLASH;
+			break;
+		case '%':
+			kind = token_kind::PERCENT;
+			break;
+		case '+':
+			kind = token_kind::PLUS;
+			break;
+		case '-':
+			kind = token_kind::DASH;
+			break;
+		case '<':
+			if (next_is(position, '<'))
+			{
+				++position;
+				kind = token_kind::LESS_LESS;
+			}
+			else if (next_is(position, '='))
+			{
+				++position;
+				kind = token_kind::LESS_EQUAL;
+			}
+			else
+				kind = token_kind::LESS;
+			break;
+		case '>':
+			if (next_is(position, '>'))
+			{
+				++position;
+				kind = token_kind::GREATER_GREATER;
+			}
+			else if (next_is(position, '='))
+			{
+				++position;
+				kind = token_kind::GREATER_EQUAL;
+			}
+			else
+				kind = token_kind::GREATER;
+			break;
+		case '=':
+			if (next_is(position, '='))
+			{
+				++position;
+				kind = token_kind::EQUAL_EQUAL;
+			}
+			else
+				kind = token_kind::EQUAL;
+			break;
+		case '!':
+			if (next_is(position, '='))
+			{
+				++position;
+				kind = token_kind::EXCLAIM_EQUAL;
+			}
+			else
+				kind = token_kind::EXCLAIM;
+			break;
+		case '&':
+			if (next_is(position, '&'))
+			{
+				++position;
+				kind = token_kind::AMP_AMP;
+			}
+			else
+				kind = token_kind::AMP;
+			break;
+		case '~':
+			kind = token_kind::TILDE;
+			break;
+		case '^':
+			kind = token_kind::CARET;
+			break;
+		case '|':
+			if (next_is(position, '|'))
+			{
+				++position;
+				kind = token_kind::BAR_BAR;
+			}
+			else
+				kind = token_kind::BAR;
+			break;
+		case '.':
+			if (position < end && source[position] >= '0' && source[position] <= '9')
+			{
+				position = number_end(start);
+				kind = token_kind::NUMBER_LITERAL;
+			}
+			break;
+		case '?':
+			kind = token_kind::QUESTION;
+			break;
+		case ':':
+			kind = token_kind::COLON;
+			break;
+		case '(':
+			kind = token_kind::LPAREN;
+			break;
+		case ')':
+			kind = token_kind::RPAREN;
+			break;
+		case '"':
+		{
+			auto quote = static_cast<const char*>(std::memchr(source.data() + position, '"', end - position));
+			position = quote ? quote - source.data() + 1 : end;
+			kind = token_kind::STRING_LITERAL;
+			break;
+		}
+		default:
+		{
+			auto classes = character_classes.classes[static_cast<unsigned char>(source[start])];
+			if (classes & DIGIT)
+			{
+				position = number_end(start);
+				kind = token_kind::NUMBER_LITERAL;
+			}
+			else if (classes & WORD)
+			{
+				position = skip(position, &character_masks::word);
+				kind = token_kind::IDENTIFIER;
+			}
+			break;
+		}
+		}
+		lexemes.push_back({ kind, static_cast<std::uint32_t>(start), static_cast<std::uint32_t>(position - start) });
+	}
+	_position = position;
+	return true;
+}
+
+bool lex(std::string_view source, std::vector<lexeme>& lexemes)
+{
+	lexemes.clear();
+	if (source.size() > std::numeric_limits<std::uint32_t>::max())
+		return false;
+	lexer lexer{ source };
+	while (lexer.next(lexemes, std::numeric_limits<size_t>::max()))
+		;
+	return true;
+}
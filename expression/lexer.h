@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "simd.h"
+#include "token.h"
+
+// A token as the bulk lexer stores it: its kind and where its text is in the
+// source. Number literals are converted by the parser.
+struct lexeme
+{
+	token_kind    kind;
+	std::uint32_t offset;   // start of the token text in the source
+	std::uint32_t length;   // length of the token text
+};
+
+// Tokenizes a source in batches of lexemes, the same tokens scanner::next
+// returns one at a time. Whitespace, identifier and number runs are found in
+// masks of 64 bytes classified with vector instructions where the processor
+// has them, rather than by testing one byte at a time.
+class lexer
+{
+public:
+	lexer() = default;
+	// Lexes source without copying it, so it must outlive the lexer. Offsets
+	// have 32 bits, so the source must be smaller than 4 GiB.
+	lexer(std::string_view source);
+	// Appends up to count of the next tokens to lexemes, the last one of the
+	// source being END_OF_FILE. Returns false if there were none left.
+	bool next(std::vector<lexeme>& lexemes, size_t count);
+private:
+	std::string_view _source;
+	size_t _position{ 0 };
+	bool _done{ true };
+	simd_classify_kernel _classify{ nullptr };
+	size_t _block{ 0 };            // block the masks are for
+	character_masks _masks{};
+	size_t skip(size_t position, unsigned long long character_masks::* mask);
+	void classify(size_t block);
+	size_t number_end(size_t position);
+	bool next_is(size_t position, char ch) const
+	{
+		return position < _source.size() && _source[position] == ch;
+	}
+};
+
+// Tokenizes all of source into lexemes. Returns false if the source is too
+// large for 32 bit offsets.
+bool lex(std::string_view source, std::vector<lexeme>& lexemes);
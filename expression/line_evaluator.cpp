@@ -0,0 +1,89 @@
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <type_traits>
+
+#include "line_evaluator.h"
+
+void line_evaluator::evaluate(std::string_view source)
+{
+	while (!source.empty())
+	{
+		auto end = static_cast<const char*>(std::memchr(source.data(), '\n', source.size()));
+		auto length = end ? static_cast<size_t>(end - source.data()) : source.size();
+		auto line = source.substr(0, length);
+		if (!line.empty() && line.back() == '\r')
+			line.remove_suffix(1);
+		evaluate_line(line);
+		source.remove_prefix(end ? length + 1 : length);
+	}
+}
+
+void line_evaluator::evaluate_line(std::string_view line)
+{
+	++_lines;
+	if (line.find_first_not_of(" \t\v\f") == std::string_view::npos)
+	{
+		write("\n");
+		return;
+	}
+	_parser.reset(line, _lines);
+	token_value value;
+	auto compiled = _parser.compile(_tree);
+	if (compiled && _tree.evaluate(value, {}, _diagnostics))
+	{
+		write(value);
+		return;
+	}
+	if (!compiled)
+	{
+		// The quoted tokens are kept, as the line may be gone by the flush.
+		for (auto record : _parser.diagnostics().records())
+		{
+			auto text = line.substr(record.offset, record.length);
+			record.offset = static_cast<std::uint32_t>(_quoted.size());
+			_quoted += text;
+			_diagnostics.add(record);
+		}
+	}
+	++_failures;
+	write("error\n");
+	if (_diagnostics.count() >= _diagnostics.limit())
+		flush();
+}
+
+void line_evaluator::write(const token_value& value)
+{
+	char text[64];
+	auto result = std::visit([&](auto v) {
+		if constexpr (std::is_same_v<decltype(v), bool>)
+			return std::to_chars(text, text + sizeof(text), static_cast<int>(v));
+		else
+			return std::to_chars(text, text + sizeof(text), v);
+		}, value);
+	*result.ptr++ = '\n';
+	write(std::string_view{ text, static_cast<size_t>(result.ptr - text) });
+}
+
+void line_evaluator::write(std::string_view text)
+{
+	if (_buffer.size() + text.size() > buffer_size)
+		flush();
+	_buffer.insert(_buffer.end(), text.begin(), text.end());
+}
+
+void line_evaluator::flush()
+{
+	if (!_buffer.empty())
+	{
+		_output.write(_buffer.data(), static_cast<std::streamsize>(_buffer.size()));
+		_buffer.clear();
+	}
+	if (!_diagnostics.empty())
+	{
+		_diagnostics.write(std::cerr, _quoted);
+		_diagnostics.clear();
+		_quoted.clear();
+	}
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "diagnostics.h"
+#include "expression_tree.h"
+#include "parser.h"
+#include "token.h"
+
+// Evaluates a source with one expression per line, such as the contents of a
+// mapped_file, and writes the value of every line to the output, one per line
+// and in order. Lines are parsed in place and the output is written in blocks,
+// so the cost of a line is parsing and evaluating it. Lines with errors are
+// written as "error", and their diagnostics, with their line numbers in the
+// source, are collected and written to std::cerr in one write per flush; blank
+// lines stay blank. Floating point values are written in the shortest form
+// that reads back as the same value.
+class line_evaluator
+{
+public:
+	explicit line_evaluator(std::ostream& output) : _output{ output }
+	{
+		_buffer.reserve(buffer_size);
+	}
+	line_evaluator(const line_evaluator&) = delete;
+	line_evaluator& operator=(const line_evaluator&) = delete;
+	~line_evaluator()
+	{
+		flush();
+	}
+	// Evaluates every line of source. Line numbers continue from the previous
+	// source, if any.
+	void evaluate(std::string_view source);
+	void flush();
+	size_t lines() const
+	{
+		return _lines;
+	}
+	size_t failures() const
+	{
+		return _failures;
+	}
+private:
+	static constexpr size_t buffer_size = 1 << 16;
+	// Diagnostics collected before a flush writes them.
+	static constexpr size_t diagnostics_limit = 1024;
+	std::ostream& _output;
+	std::vector<char> _buffer;
+	diagnostic_buffer _diagnostics{ diagnostics_limit };
+	std::string _quoted;   // text of the tokens the diagnostics quote, where their offsets point
+	parser _parser;
+	expression_tree _tree;
+	size_t _lines{ 0 };
+	size_t _failures{ 0 };
+	void evaluate_line(std::string_view line);
+	void write(const token_value& value);
+	void write(std::string_view text);
+};
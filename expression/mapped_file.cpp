@@ -0,0 +1,87 @@
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "mapped_file.h"
+
+#if defined(_WIN32)
+mapped_file::mapped_file(const std::string& filename)
+{
+	auto file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return;
+	_file = file;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size))
+		return;
+	_open = true;
+	// Empty files cannot be mapped.
+	if (size.QuadPart == 0)
+		return;
+	_mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!_mapping)
+	{
+		_open = false;
+		return;
+	}
+	_data = static_cast<const char*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+	if (!_data)
+	{
+		_open = false;
+		return;
+	}
+	_size = static_cast<size_t>(size.QuadPart);
+}
+
+mapped_file::~mapped_file()
+{
+	if (_data)
+		UnmapViewOfFile(_data);
+	if (_mapping)
+		CloseHandle(_mapping);
+	if (_file)
+		CloseHandle(_file);
+}
+#else
+mapped_file::mapped_file(const std::string& filename)
+{
+	auto file = open(filename.c_str(), O_RDONLY);
+	if (file < 0)
+		return;
+	struct stat status;
+	if (fstat(file, &status) != 0)
+	{
+		close(file);
+		return;
+	}
+	_open = true;
+	// Empty files cannot be mapped.
+	if (status.st_size > 0)
+	{
+		auto data = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+		if (data == MAP_FAILED)
+			_open = false;
+		else
+		{
+			madvise(data, static_cast<size_t>(status.st_size), MADV_SEQUENTIAL);
+			_data = static_cast<const char*>(data);
+			_size = static_cast<size_t>(status.st_size);
+		}
+	}
+	// The mapping stays valid after the file is closed.
+	close(file);
+}
+
+mapped_file::~mapped_file()
+{
+	if (_data)
+		munmap(const_cast<char*>(_data), _size);
+}
+#endif
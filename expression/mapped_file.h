@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// A file mapped read-only into memory, so its contents can be scanned without
+// reading them into a buffer first.
+class mapped_file
+{
+public:
+	// A file that is not open, with no contents.
+	mapped_file() = default;
+	explicit mapped_file(const std::string& filename);
+	mapped_file(const mapped_file&) = delete;
+	mapped_file& operator=(const mapped_file&) = delete;
+	~mapped_file();
+	bool is_open() const
+	{
+		return _open;
+	}
+	std::string_view contents() const
+	{
+		return { _data, _size };
+	}
+private:
+	const char* _data{ nullptr };
+	size_t _size{ 0 };
+	bool _open{ false };
+#if defined(_WIN32)
+	void* _file{ nullptr };
+	void* _mapping{ nullptr };
+#endif
+};
@@ -0,0 +1,30 @@
+#include <charconv>
+#include <system_error>
+
+#include "number_literal.h"
+
+diagnostic_id number_literals::parse_floating(const char* first, const char* suffix, bool is_hex, bool is_float,
+	bool negative, token_kind& kind, token_value& value)
+{
+	auto format = is_hex ? std::chars_format::hex : std::chars_format::general;
+	std::from_chars_result result;
+	if (is_float)
+	{
+		float number{};
+		result = std::from_chars(first, suffix, number, format);
+		kind = token_kind::FLOAT_LITERAL;
+		value = negative ? -number : number;
+	}
+	else
+	{
+		double number{};
+		result = std::from_chars(first, suffix, number, format);
+		kind = token_kind::DOUBLE_LITERAL;
+		value = negative ? -number : number;
+	}
+	if (result.ec == std::errc::result_out_of_range)
+		return diagnostic_id::FLOATING_LITERAL_OUT_OF_RANGE;
+	if (result.ec != std::errc{} || result.ptr != suffix)
+		return diagnostic_id::INVALID_NUMBER_LITERAL;
+	return diagnostic_id::NONE;
+}
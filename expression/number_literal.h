@@ -0,0 +1,355 @@
+#pragma once
+
+#include <limits>
+#include <string_view>
+#include <type_traits>
+
+#include "diagnostics.h"
+#include "token.h"
+
+// The steps of parse_number_literal. They are constexpr, so constant
+// evaluation converts literals with the same rules.
+namespace number_literals
+{
+	constexpr bool is_digit(char ch)
+	{
+		return ch >= '0' && ch <= '9';
+	}
+
+	// Stores magnitude, which fits T, negated if negative as unary - would.
+	template <typename T>
+	constexpr void store(token_value& value, unsigned long long magnitude, bool negative)
+	{
+		auto result = static_cast<T>(magnitude);
+		value = negative ? static_cast<T>(T{} - result) : result;
+	}
+
+	// Reads a combination of u, l and ll in either case and order. The two
+	// letters of ll must have the same case.
+	constexpr bool parse_integer_suffix(std::string_view suffix, bool& is_unsigned, unsigned int& longs)
+	{
+		is_unsigned = false;
+		longs = 0;
+		size_t index{ 0 };
+		auto parse_unsigned = [&]()
+		{
+			if (index < suffix.size() && (suffix[index] == 'u' || suffix[index] == 'U'))
+			{
+				is_unsigned = true;
+				++index;
+			}
+		};
+		parse_unsigned();
+		if (index < suffix.size() && (suffix[index] == 'l' || suffix[index] == 'L'))
+		{
+			longs = 1;
+			if (index + 1 < suffix.size() && suffix[index + 1] == suffix[index])
+			{
+				longs = 2;
+				++index;
+			}
+			++index;
+		}
+		if (!is_unsigned)
+			parse_unsigned();
+		return index == suffix.size();
+	}
+
+	// The first type of the list C gives for the suffix and base that can
+	// represent magnitude: int, long and long long of at least the rank of the
+	// suffix, each followed by its unsigned type if the literal is not decimal;
+	// only the unsigned types with u. Decimal literals too large for long long
+	// are unsigned long long, as in most compilers.
+	constexpr void store_integer(token_kind& kind, token_value& value, unsigned long long magnitude, bool negative,
+		bool is_decimal, bool is_unsigned, unsigned int longs)
+	{
+		auto allow_signed = !is_unsigned;
+		auto allow_unsigned = is_unsigned || !is_decimal;
+		if (longs == 0)
+		{
+			if (allow_signed && magnitude <= static_cast<unsigned long long>(std::numeric_limits<int>::max()))
+			{
+				kind = token_kind::INT_LITERAL;
+				store<int>(value, magnitude, negative);
+				return;
+			}
+			if (allow_unsigned && magnitude <= std::numeric_limits<unsigned int>::max())
+			{
+				kind = token_kind::UNSIGNED_INT_LITERAL;
+				store<unsigned int>(value, magnitude, negative);
+				return;
+			}
+		}
+		if (longs <= 1)
+		{
+			if (allow_signed && magnitude <= static_cast<unsigned long long>(std::numeric_limits<long>::max()))
+			{
+				kind = token_kind::LONG_LITERAL;
+				store<long>(value, magnitude, negative);
+				return;
+			}
+			if (allow_unsigned && magnitude <= std::numeric_limits<unsigned long>::max())
+			{
+				kind = token_kind::UNSIGNED_LONG_LITERAL;
+				store<unsigned long>(value, magnitude, negative);
+				return;
+			}
+		}
+		if (allow_signed && magnitude <= static_cast<unsigned long long>(std::numeric_limits<long long>::max()))
+		{
+			kind = token_kind::LONG_LONG_LITERAL;
+			store<long long>(value, magnitude, negative);
+			return;
+		}
+		kind = token_kind::UNSIGNED_LONG_LONG_LITERAL;
+		store<unsigned long long>(value, magnitude, negative);
+	}
+
+	// Value of a digit in base, or base if it is none.
+	constexpr unsigned int digit_value(char ch, unsigned int base)
+	{
+		unsigned int value = base;
+		if (ch >= '0' && ch <= '9')
+			value = static_cast<unsigned int>(ch - '0');
+		else if (ch >= 'a' && ch <= 'z')
+			value = static_cast<unsigned int>(ch - 'a') + 10;
+		else if (ch >= 'A' && ch <= 'Z')
+			value = static_cast<unsigned int>(ch - 'A') + 10;
+		return value < base ? value : base;
+	}
+
+	// Reads the digits at first as std::from_chars does, setting last to the
+	// first character after them. Returns INVALID_NUMBER_LITERAL if there are
+	// none and INTEGER_LITERAL_TOO_LARGE if their value does not fit.
+	constexpr diagnostic_id parse_magnitude(const char*& first, const char* last, unsigned int base,
+		unsigned long long& magnitude)
+	{
+		auto start = first;
+		auto too_large{ false };
+		magnitude = 0;
+		for (; first != last; ++first)
+		{
+			auto digit = digit_value(*first, base);
+			if (digit == base)
+				break;
+			if (magnitude > (std::numeric_limits<unsigned long long>::max() - digit) / base)
+				too_large = true;
+			magnitude = magnitude * base + digit;
+		}
+		if (first == start)
+			return diagnostic_id::INVALID_NUMBER_LITERAL;
+		return too_large ? diagnostic_id::INTEGER_LITERAL_TOO_LARGE : diagnostic_id::NONE;
+	}
+
+	// Converts a floating point literal without its sign; suffix is where its
+	// f or l suffix starts. Uses std::from_chars, so it is not constexpr.
+	diagnostic_id parse_floating(const char* first, const char* suffix, bool is_hex, bool is_float, bool negative,
+		token_kind& kind, token_value& value);
+
+	// Reads the digits of a floating point literal for constant evaluation,
+	// and the point among them. Leading zeros are skipped, and digits after
+	// the first 19 significant ones must be zeros.
+	constexpr bool parse_mantissa(const char*& first, const char* last, unsigned int base,
+		unsigned long long& mantissa, int& exponent, bool& any_digit)
+	{
+		constexpr unsigned int max_digits = 19;
+		unsigned int digits{ 0 };
+		auto point{ false };
+		mantissa = 0;
+		exponent = 0;
+		any_digit = false;
+		for (; first != last; ++first)
+		{
+			if (*first == '.' && !point)
+			{
+				point = true;
+				continue;
+			}
+			auto digit = digit_value(*first, base);
+			if (digit == base)
+				break;
+			any_digit = true;
+			if (mantissa == 0 && digit == 0)
+			{
+				if (point)
+					--exponent;
+				continue;
+			}
+			if (digits == max_digits || (base == 16 && digits == max_digits - 3))
+			{
+				if (digit != 0)
+					return false;
+				if (!point)
+					++exponent;
+				continue;
+			}
+			mantissa = mantissa * base + digit;
+			++digits;
+			if (point)
+				--exponent;
+		}
+		return true;
+	}
+
+	// Reads an exponent of at least one digit with an optional sign.
+	constexpr bool parse_exponent(const char*& first, const char* last, int& exponent)
+	{
+		auto negative{ false };
+		if (first != last && (*first == '+' || *first == '-'))
+		{
+			negative = *first == '-';
+			++first;
+		}
+		auto start = first;
+		exponent = 0;
+		for (; first != last && is_digit(*first); ++first)
+		{
+			if (exponent < 100000)
+				exponent = exponent * 10 + (*first - '0');
+		}
+		if (negative)
+			exponent = -exponent;
+		return first != start;
+	}
+
+	// Converts a floating point literal as parse_floating does, in constant
+	// evaluation. Only conversions that are exact or need one rounding are
+	// done: a decimal mantissa the type holds exactly times or divided by a
+	// power of ten it holds exactly, or a hexadecimal mantissa it holds exactly
+	// times a power of two. Other literals give FLOATING_LITERAL_INEXACT.
+	template <typename T>
+	constexpr diagnostic_id parse_constant_floating(const char* first, const char* suffix, bool is_hex, bool negative,
+		token_value& value)
+	{
+		constexpr auto exact_mantissa = 1ull << std::numeric_limits<T>::digits;
+		constexpr int exact_power_of_ten = std::is_same_v<T, float> ? 10 : 22;
+		unsigned long long mantissa{ 0 };
+		int exponent{ 0 };
+		auto any_digit{ false };
+		if (!parse_mantissa(first, suffix, is_hex ? 16 : 10, mantissa, exponent, any_digit))
+			return diagnostic_id::FLOATING_LITERAL_INEXACT;
+		if (!any_digit)
+			return diagnostic_id::INVALID_NUMBER_LITERAL;
+		int written_exponent{ 0 };
+		if (first != suffix && (is_hex ? (*first == 'p' || *first == 'P') : (*first == 'e' || *first == 'E')))
+		{
+			++first;
+			if (!parse_exponent(first, suffix, written_exponent))
+				return diagnostic_id::INVALID_NUMBER_LITERAL;
+		}
+		if (first != suffix)
+			return diagnostic_id::INVALID_NUMBER_LITERAL;
+		T number{ 0 };
+		if (mantissa != 0)
+		{
+			auto base = is_hex ? 16u : 10u;
+			for (; mantissa % base == 0; mantissa /= base)
+				++exponent;
+			if (mantissa > exact_mantissa)
+				return diagnostic_id::FLOATING_LITERAL_INEXACT;
+			number = static_cast<T>(mantissa);
+			if (is_hex)
+			{
+				// Hexadecimal digits are four bits each. A product that stays
+				// normal is exact; one that does not overflows or underflows.
+				auto power = written_exponent + 4 * exponent;
+				for (; power > 0 && number <= std::numeric_limits<T>::max() / 2; --power)
+					number *= 2;
+				for (; power < 0 && number >= std::numeric_limits<T>::min(); ++power)
+					number /= 2;
+				if (power > 0)
+					return diagnostic_id::FLOATING_LITERAL_OUT_OF_RANGE;
+				if (power != 0 || number < std::numeric_limits<T>::min())
+					return diagnostic_id::FLOATING_LITERAL_INEXACT;
+			}
+			else
+			{
+				auto power = written_exponent + exponent;
+				if (power < -exact_power_of_ten || power > exact_power_of_ten)
+				{
+					// The value is at least 10 ^ (digits - 1 + power) and below
+					// 10 ^ (digits + power). Out of range where that overflows
+					// or rounds to zero for sure, as std::from_chars says.
+					int digits{ 0 };
+					for (auto rest = mantissa; rest != 0; rest /= 10)
+						++digits;
+					constexpr int zero_below = std::is_same_v<T, float> ? -46 : -324;
+					if (digits - 1 + power > std::numeric_limits<T>::max_exponent10 || digits + power <= zero_below)
+						return diagnostic_id::FLOATING_LITERAL_OUT_OF_RANGE;
+					return diagnostic_id::FLOATING_LITERAL_INEXACT;
+				}
+				T scale{ 1 };
+				for (auto i = 0; i < (power < 0 ? -power : power); ++i)
+					scale *= 10;
+				number = power < 0 ? number / scale : number * scale;
+			}
+		}
+		value = negative ? -number : number;
+		return diagnostic_id::NONE;
+	}
+}
+
+// Converts the text of a number literal to its value and the literal kind of
+// its type, as C does: decimal, octal (a leading 0) and hexadecimal (0x)
+// integers with u, l and ll suffixes, and decimal or hexadecimal floating
+// point numbers with an optional exponent and an f or l suffix. long double
+// literals are double. The text may start with a sign, which applies to the
+// value in its type as unary + and - would. Returns diagnostic_id::NONE, or the
+// error if the text is not a valid literal or its value is out of range.
+// Neither allocates nor throws. In constant evaluation, floating point
+// literals are converted as number_literals::parse_constant_floating says.
+constexpr diagnostic_id parse_number_literal(std::string_view text, token_kind& kind, token_value& value)
+{
+	using namespace number_literals;
+	auto negative{ false };
+	if (!text.empty() && (text.front() == '+' || text.front() == '-'))
+	{
+		negative = text.front() == '-';
+		text.remove_prefix(1);
+	}
+	if (text.empty() || !(is_digit(text.front()) || (text.front() == '.' && text.size() > 1 && is_digit(text[1]))))
+		return diagnostic_id::INVALID_NUMBER_LITERAL;
+	auto first = text.data();
+	auto last = text.data() + text.size();
+	auto is_hex = text.size() > 1 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X');
+	// A hexadecimal floating point literal needs an exponent, so the point
+	// alone does not make one.
+	if (is_hex ? text.find_first_of("pP") != std::string_view::npos : text.find_first_of(".eE") != std::string_view::npos)
+	{
+		if (is_hex)
+			first += 2;
+		auto suffix = last;
+		while (suffix != first && (suffix[-1] == 'f' || suffix[-1] == 'F' || suffix[-1] == 'l' || suffix[-1] == 'L'))
+			--suffix;
+		if (last - suffix > 1)
+			return diagnostic_id::INVALID_NUMBER_LITERAL;
+		auto is_float = suffix != last && (*suffix == 'f' || *suffix == 'F');
+		kind = is_float ? token_kind::FLOAT_LITERAL : token_kind::DOUBLE_LITERAL;
+		if (!std::is_constant_evaluated())
+			return parse_floating(first, suffix, is_hex, is_float, negative, kind, value);
+		if (is_float)
+			return parse_constant_floating<float>(first, suffix, is_hex, negative, value);
+		return parse_constant_floating<double>(first, suffix, is_hex, negative, value);
+	}
+	unsigned int base{ 10 };
+	if (is_hex)
+	{
+		base = 16;
+		first += 2;
+	}
+	else if (text.size() > 1 && text[0] == '0' && is_digit(text[1]))
+	{
+		base = 8;
+		++first;
+	}
+	unsigned long long magnitude{ 0 };
+	auto id = parse_magnitude(first, last, base, magnitude);
+	if (id != diagnostic_id::NONE)
+		return id;
+	bool is_unsigned{ false };
+	unsigned int longs{ 0 };
+	if (!parse_integer_suffix({ first, static_cast<size_t>(last - first) }, is_unsigned, longs))
+		return diagnostic_id::INVALID_NUMBER_LITERAL;
+	store_integer(kind, value, magnitude, negative, base == 10, is_unsigned, longs);
+	return diagnostic_id::NONE;
+}
@@ -0,0 +1,357 @@
+#include <array>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "operations.h"
+#include "operators.h"
+
+namespace
+{
+	template <typename operation, typename T1, typename T2>
+	const char* typed_binary(const token_value& left, const token_value& right, token_value& result)
+	{
+		auto a = *std::get_if<T1>(&left);
+		auto b = *std::get_if<T2>(&right);
+		if (auto message = operation::check(a, b))
+		{
+			result = static_cast<operators::binary_result_t<operation, T1, T2>>(operation::fallback(a, b));
+			return message;
+		}
+		result = operation::apply(a, b);
+		return nullptr;
+	}
+
+	template <typename operation, typename T>
+	const char* typed_unary(const token_value& value, const token_value&, token_value& result)
+	{
+		result = operation::apply(*std::get_if<T>(&value));
+		return nullptr;
+	}
+
+	// Lowered forms of an operator for every pair of operand types, indexed by
+	// left type * value_type_count + right type; nullptr where it is undefined.
+	template <typename operation>
+	struct typed_operations
+	{
+		template <size_t I>
+		static constexpr operations::typed_operation binary_entry()
+		{
+			using T1 = value_t<I / value_type_count>;
+			using T2 = value_t<I % value_type_count>;
+			if constexpr (operation::template defined<T1, T2>)
+				return &typed_binary<operation, T1, T2>;
+			else
+				return nullptr;
+		}
+		template <size_t I>
+		static constexpr operations::typed_operation unary_entry()
+		{
+			if constexpr (operation::template defined<value_t<I>>)
+				return &typed_unary<operation, value_t<I>>;
+			else
+				return nullptr;
+		}
+		template <size_t... I>
+		static constexpr std::array<operations::typed_operation, sizeof...(I)> binary_table(std::index_sequence<I...>)
+		{
+			return { binary_entry<I>()... };
+		}
+		template <size_t... I>
+		static constexpr std::array<operations::typed_operation, sizeof...(I)> unary_table(std::index_sequence<I...>)
+		{
+			return { unary_entry<I>()... };
+		}
+		static constexpr auto binary = binary_table(std::make_index_sequence<value_type_count * value_type_count>{});
+		static constexpr auto unary = unary_table(std::make_index_sequence<value_type_count>{});
+	};
+}
+
+template <typename operation, typename result>
+result operations::visit(const token_value& left, const token_value& right)
+{
+	return std::visit([this](auto a, auto b) -> result
+	{
+		using T1 = decltype(a);
+		using T2 = decltype(b);
+		if constexpr (operation::template defined<T1, T2>)
+		{
+			// The value keeps the type apply gives it, which is the type
+			// inferred for the expression.
+			if (auto message = operation::check(a, b))
+			{
+				error(message);
+				return static_cast<operators::binary_result_t<operation, T1, T2>>(operation::fallback(a, b));
+			}
+			return operation::apply(a, b);
+		}
+		else
+		{
+			error(operation::message);
+			return operation::fallback(a, b);
+		}
+	}, left, right);
+}
+
+template <typename operation>
+token_value operations::visit(const token_value& value)
+{
+	return std::visit([this](auto a) -> token_value
+	{
+		using T = decltype(a);
+		if constexpr (operation::template defined<T>)
+		{
+			return operation::apply(a);
+		}
+		else
+		{
+			error(operation::message);
+			return operation::fallback(a);
+		}
+	}, value);
+}
+
+token_value operations::add(const token_value& lhs, const token_value& rhs)
+{
+	return visit<operators::add, token_value>(lhs, rhs);
+}
+
+token_value operations::subtract(const token_value& lhs, const token_value& rhs)
+{
+	return visit<operators::subtract, token_value>(lhs, rhs);
+}
+
+token_value operations::multiply(const token_value& lhs, const token_value& rhs)
+{
+	return visit<operators::multiply, token_value>(lhs, rhs);
+}
+
+token_value operations::divide(const token_value& lhs, const token_value& rhs)
+{
+	return visit<operators::divide, token_value>(lhs, rhs);
+}
+
+token_value operations::modulus(const token_value& lhs, const token_value& rhs)
+{
+	return visit<operators::modulus, token_value>(lhs, rhs);
+}
+
+token_value operations::left_shift(const token_value& left, const token_value& right)
+{
+	return visit<operators::left_shift, token_value>(left, right);
+}
+
+token_value operations::right_shift(const token_value& left, const token_value& right)
+{
+	return visit<operators::right_shift, token_value>(left, right);
+}
+
+bool operations::less_equal(const token_value& left, const token_value& right)
+{
+	return visit<operators::less_equal, bool>(left, right);
+}
+
+bool operations::greater_equal(const token_value& left, const token_value& right)
+{
+	return visit<operators::greater_equal, bool>(left, right);
+}
+
+bool operations::less(const token_value& left, const token_value& right)
+{
+	return visit<operators::less, bool>(left, right);
+}
+
+bool operations::greater(const token_value& left, const token_value& right)
+{
+	return visit<operators::greater, bool>(left, right);
+}
+
+token_value operations::bitwise_and(const token_value& left, const token_value& right)
+{
+	return visit<operators::bitwise_and, token_value>(left, right);
+}
+
+token_value operations::bitwise_exclusive_or(const token_value& left, const token_value& right)
+{
+	return visit<operators::bitwise_exclusive_or, token_value>(left, right);
+}
+
+token_value operations::bitwise_or(const token_value& left, const token_value& right)
+{
+	return visit<operators::bitwise_or, token_value>(left, right);
+}
+
+bool operations::logical_and(const token_value& left, const token_value& right)
+{
+	return visit<operators::logical_and, bool>(left, right);
+}
+
+bool operations::logical_or(const token_value& left, const token_value& right)
+{
+	return visit<operators::logical_or, bool>(left, right);
+}
+
+token_value operations::negate(const token_value& value)
+{
+	return visit<operators::negate>(value);
+}
+
+token_value operations::not_(const token_value& value)
+{
+	return visit<operators::not_>(value);
+}
+
+token_value operations::bitwise_not(const token_value& value)
+{
+	return visit<operators::bitwise_not>(value);
+}
+
+bool operations::equal(const token_value& left, const token_value& right)
+{
+	return left == right;
+}
+
+bool operations::not_equal(const token_value& left, const token_value& right)
+{
+	return left != right;
+}
+
+token_value operations::binary(token_kind op, const token_value& left, const token_value& right)
+{
+	switch (op)
+	{
+	case token_kind::STAR:
+		return multiply(left, right);
+	case token_kind::SLASH:
+		return divide(left, right);
+	case token_kind::PERCENT:
+		return modulus(left, right);
+	case token_kind::PLUS:
+		return add(left, right);
+	case token_kind::DASH:
+		return subtract(left, right);
+	case token_kind::LESS_LESS:
+		return left_shift(left, right);
+	case token_kind::GREATER_GREATER:
+		return right_shift(left, right);
+	case token_kind::LESS_EQUAL:
+		return less_equal(left, right);
+	case token_kind::GREATER_EQUAL:
+		return greater_equal(left, right);
+	case token_kind::LESS:
+		return less(left, right);
+	case token_kind::GREATER:
+		return greater(left, right);
+	case token_kind::EQUAL_EQUAL:
+		return equal(left, right);
+	case token_kind::EXCLAIM_EQUAL:
+		return not_equal(left, right);
+	case token_kind::AMP:
+		return bitwise_and(left, right);
+	case token_kind::CARET:
+		return bitwise_exclusive_or(left, right);
+	case token_kind::BAR:
+		return bitwise_or(left, right);
+	case token_kind::AMP_AMP:
+		return logical_and(left, right);
+	case token_kind::BAR_BAR:
+		return logical_or(left, right);
+	default:
+		error("Unknown binary operator");
+		return left;
+	}
+}
+
+token_value operations::unary(token_kind op, const token_value& value)
+{
+	switch (op)
+	{
+	case token_kind::DASH:
+		return negate(value);
+	case token_kind::PLUS:
+		return value;
+	case token_kind::TILDE:
+		return bitwise_not(value);
+	case token_kind::EXCLAIM:
+		return not_(value);
+	default:
+		error("Unknown unary operator");
+		return value;
+	}
+}
+
+bool operations::binary_type(token_kind op, size_t left, size_t right, size_t& type)
+{
+	if (left == dynamic_type || right == dynamic_type)
+	{
+		type = dynamic_type;
+		return true;
+	}
+	auto index = left * value_type_count + right;
+	switch (op)
+	{
+#define X(name, member, kind) \
+	case token_kind::kind: \
+		type = operators::binary_types<operators::member>::result[index]; \
+		return operators::binary_types<operators::member>::defined[index];
+	EXPRESSION_BINARY_OPERATIONS(X)
+#undef X
+	default:
+		type = left;
+		return false;
+	}
+}
+
+bool operations::unary_type(token_kind op, size_t value, size_t& type)
+{
+	if (value == dynamic_type)
+	{
+		type = dynamic_type;
+		return true;
+	}
+	switch (op)
+	{
+#define X(name, member, kind) \
+	case token_kind::kind: \
+		type = operators::unary_types<operators::member>::result[value]; \
+		return operators::unary_types<operators::member>::defined[value];
+	EXPRESSION_UNARY_OPERATIONS(X)
+#undef X
+	default:
+		type = value;
+		return false;
+	}
+}
+
+operations::typed_operation operations::lower_binary(token_kind op, size_t left, size_t right)
+{
+	if (left == dynamic_type || right == dynamic_type)
+		return nullptr;
+	auto index = left * value_type_count + right;
+	switch (op)
+	{
+#define X(name, member, kind) \
+	case token_kind::kind: \
+		return typed_operations<operators::member>::binary[index];
+	EXPRESSION_BINARY_OPERATIONS(X)
+#undef X
+	default:
+		return nullptr;
+	}
+}
+
+operations::typed_operation operations::lower_unary(token_kind op, size_t value)
+{
+	if (value == dynamic_type)
+		return nullptr;
+	switch (op)
+	{
+#define X(name, member, kind) \
+	case token_kind::kind: \
+		return typed_operations<operators::member>::unary[value];
+	EXPRESSION_UNARY_OPERATIONS(X)
+#undef X
+	default:
+		return nullptr;
+	}
+}
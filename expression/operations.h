@@ -0,0 +1,73 @@
+#pragma once
+
+#include <string>
+
+#include "token.h"
+
+// Semantics of the expression operators on token_value, built from the
+// element-wise rules in operators.h. Whoever evaluates an expression derives
+// from this class and decides where type errors are reported.
+class operations
+{
+public:
+	// An operator lowered to one pair of operand types. It reads the
+	// alternatives directly instead of visiting the variants, so the operands
+	// must have those types, and stores the value in result, which may be one
+	// of the operands. Returns the error for invalid operand values, if any.
+	using typed_operation = const char* (*)(const token_value& left, const token_value& right, token_value& result);
+
+	virtual ~operations() = default;
+
+	token_value binary(token_kind op, const token_value& left, const token_value& right);
+	token_value unary(token_kind op, const token_value& value);
+
+	// Result type of op for operands of the given type indices. Returns false if
+	// op is not defined for them; type is then the type of the fallback value.
+	// dynamic_type operands give a dynamic_type result.
+	static bool binary_type(token_kind op, size_t left, size_t right, size_t& type);
+	static bool unary_type(token_kind op, size_t value, size_t& type);
+	// The lowered form of op for operands of the given types, nullptr if a type
+	// is dynamic or op is not defined for them. Unary operations ignore right.
+	static typed_operation lower_binary(token_kind op, size_t left, size_t right);
+	static typed_operation lower_unary(token_kind op, size_t value);
+	// Whether a value is true as a condition, that is not zero.
+	static constexpr bool truth(const token_value& value)
+	{
+		return std::visit([](auto alternative) { return static_cast<bool>(alternative); }, value);
+	}
+	// Whether && and || are defined for operands of the type, so the value of
+	// the left operand can decide them.
+	static constexpr bool is_logical_type(size_t type)
+	{
+		return type == value_index<bool> || type == value_index<int>;
+	}
+
+	token_value add(const token_value& lhs, const token_value& rhs);
+	token_value subtract(const token_value& lhs, const token_value& rhs);
+	token_value multiply(const token_value& lhs, const token_value& rhs);
+	token_value divide(const token_value& lhs, const token_value& rhs);
+	token_value modulus(const token_value& lhs, const token_value& rhs);
+	token_value left_shift(const token_value& left, const token_value& right);
+	token_value right_shift(const token_value& left, const token_value& right);
+	token_value bitwise_and(const token_value& left, const token_value& right);
+	token_value bitwise_not(const token_value& value);
+	token_value bitwise_or(const token_value& left, const token_value& right);
+	bool equal(const token_value& left, const token_value& right);
+	bool not_equal(const token_value& left, const token_value& right);
+	bool greater(const token_value& left, const token_value& right);
+	bool less(const token_value& left, const token_value& right);
+	bool greater_equal(const token_value& left, const token_value& right);
+	bool less_equal(const token_value& left, const token_value& right);
+	bool logical_and(const token_value& left, const token_value& right);
+	bool logical_or(const token_value& left, const token_value& right);
+	token_value bitwise_exclusive_or(const token_value& left, const token_value& right);
+	token_value negate(const token_value& value);
+	token_value not_(const token_value& value);
+protected:
+	virtual void error(const char* message) = 0;
+private:
+	template <typename operation, typename result = token_value>
+	result visit(const token_value& left, const token_value& right);
+	template <typename operation>
+	token_value visit(const token_value& value);
+};
@@ -0,0 +1,581 @@
+#pragma once
+
+#include <array>
+#include <limits>
+#include <type_traits>
+#include <utility>
+
+#include "token.h"
+
+// Binary operators as (name, operators member, token kind).
+#define EXPRESSION_BINARY_OPERATIONS(X) \
+	X(MULTIPLY, multiply, STAR) \
+	X(DIVIDE, divide, SLASH) \
+	X(MODULUS, modulus, PERCENT) \
+	X(ADD, add, PLUS) \
+	X(SUBTRACT, subtract, DASH) \
+	X(LEFT_SHIFT, left_shift, LESS_LESS) \
+	X(RIGHT_SHIFT, right_shift, GREATER_GREATER) \
+	X(LESS, less, LESS) \
+	X(LESS_EQUAL, less_equal, LESS_EQUAL) \
+	X(GREATER, greater, GREATER) \
+	X(GREATER_EQUAL, greater_equal, GREATER_EQUAL) \
+	X(EQUAL, equal, EQUAL_EQUAL) \
+	X(NOT_EQUAL, not_equal, EXCLAIM_EQUAL) \
+	X(BITWISE_AND, bitwise_and, AMP) \
+	X(BITWISE_EXCLUSIVE_OR, bitwise_exclusive_or, CARET) \
+	X(BITWISE_OR, bitwise_or, BAR) \
+	X(LOGICAL_AND, logical_and, AMP_AMP) \
+	X(LOGICAL_OR, logical_or, BAR_BAR)
+
+// Unary operators as (name, operators member, token kind).
+#define EXPRESSION_UNARY_OPERATIONS(X) \
+	X(NEGATE, negate, DASH) \
+	X(BITWISE_NOT, bitwise_not, TILDE) \
+	X(NOT, not_, EXCLAIM)
+
+// Element-wise semantics of the expression operators. The scalar operations
+// std::visit their operands and apply these to the two alternatives, the batch
+// kernels apply them to every element of two typed columns, so both give the
+// same results.
+//
+// For every pair of operand types an operator is either defined, and apply
+// computes the result, or it is a type error: message is reported and the
+// operator evaluates to fallback. check reports errors that depend on the
+// operand values and returns nullptr if there is none.
+namespace operators
+{
+	template <typename T>
+	constexpr bool is_number = std::is_arithmetic_v<T> && !std::is_same_v<T, bool>;
+
+	template <typename T>
+	constexpr bool is_integer = std::is_integral_v<T> && !std::is_same_v<T, bool>;
+
+	struct unchecked
+	{
+		template <typename T1, typename T2>
+		static constexpr const char* check(T1, T2)
+		{
+			return nullptr;
+		}
+		template <typename T>
+		static constexpr const char* check(T)
+		{
+			return nullptr;
+		}
+	};
+
+	struct add : unchecked
+	{
+		static constexpr const char* message = "";
+		template <typename T1, typename T2>
+		static constexpr bool defined = true;
+		template <typename T1, typename T2>
+		static constexpr auto apply(T1 a, T2 b)
+		{
+			return a + b;
+		}
+		template <typename T1, typename T2>
+		static constexpr auto fallback(T1 a, T2)
+		{
+			return a;
+		}
+	};
+
+	struct subtract : unchecked
+	{
+		static constexpr const char* message = "";
+		template <typename T1, typename T2>
+		static constexpr bool defined = true;
+		template <typename T1, typename T2>
+		static constexpr auto apply(T1 a, T2 b)
+		{
+			return a - b;
+		}
+		template <typename T1, typename T2>
+		static constexpr auto fallback(T1 a, T2)
+		{
+			return a;
+		}
+	};
+
+	struct multiply : unchecked
+	{
+		static constexpr const char* message = "";
+		template <typename T1, typename T2>
+		static constexpr bool defined = true;
+		template <typename T1, typename T2>
+		static constexpr auto apply(T1 a, T2 b)
+		{
+			return a * b;
+		}
+		template <typename T1, typename T2>
+		static constexpr auto fallback(T1 a, T2)
+		{
+			return a;
+		}
+	};
+
+	// Integer division by zero, or of the minimum by -1, traps, so it is an
+	// error; floating point division gives an infinity or NaN.
+	template <typename T1, typename T2>
+	constexpr const char* check_division(T1 a, T2 b)
+	{
+		using C = decltype(a / b);
+		if constexpr (std::is_integral_v<C>)
+		{
+			if (static_cast<C>(b) == 0)
+				return "Division by zero.";
+			if constexpr (std::is_signed_v<C>)
+			{
+				if (static_cast<C>(a) == std::numeric_limits<C>::min() && static_cast<C>(b) == -1)
+					return "Division of the minimum value by -1 overflows.";
+			}
+		}
+		return nullptr;
+	}
+
+	struct divide
+	{
+		static constexpr const char* message = "Divide operation is only defined for int, long, unsigned long long, flaot and double.";
+		template <typename T1, typename T2>
+		static constexpr bool defined = is_number<T1> && is_number<T2>;
+		template <typename T1, typename T2>
+		static constexpr const char* check(T1 a, T2 b)
+		{
+			return check_division(a, b);
+		}
+		template <typename T1, typename T2>
+		static constexpr auto apply(T1 a, T2 b)
+		{
+			return a / b;
+		}
+		template <typename T1, typename T2>
+		static constexpr auto fallback(T1, T2)
+		{
+			return 0;
+		}
+	};
+
+	struct modulus
+	{
+		static constexpr const char* message = "Modulus operation is only defined for int, long, and unsigned long long.";
+		template <typename T>
+		static constexpr bool is_modulus_type = std::is_same_v<T, int> || std::is_same_v<T, long> || std::is_same_v<T, unsigned long long>;
+		template <typename T1, typename T2>
+		static constexpr bool defined = is_modulus_type<T1> && is_modulus_type<T2>;
+		template <typename T1, typename T2>
+		static constexpr const char* check(T1 a, T2 b)
+		{
+			return check_division(a, b);
+		}
+		template <typename T1, typename T2>
+		static constexpr auto apply(T1 a, T2 b)
+		{
+			return a % b;
+		}
+		template <typename T1, typename T2>
+		static constexpr auto fallback(T1, T2)
+		{
+			return 0;
+		}
+	};
+
+	// Shifting by a negative count, or by the width of the promoted left
+	// operand or more, is undefined, so it is an error.
+	template <typename T1, typename T2>
+	constexpr bool shift_count_valid(T1 a, T2 b)
+	{
+		using C = decltype(+a);
+		if constexpr (std::is_signed_v<T2>)
+		{
+			if (b < 0)
+				return false;
+		}
+		return static_cast<unsigned long long>(b) < sizeof(C) * 8;
+	}
+
+	struct left_shift
+	{
+		static constexpr const char* message = "Left shift can only be applied to integral types.";
+		template <typename T1, typename T2>
+		static constexpr bool defined = is_integer<T1> && is_integer<T2>;
+		template <typename T1, typename T2>
+		static constexpr const char* check(T1 a, T2 b)
+		{
+			if (!shift_count_valid(a, b))
+				return "Right-hand side must be non-negative and less than the width of the left-hand side for left shift.";
+			return nullptr;
+		}
+		template <typename T1, typename T2>
+		static constexpr auto apply(T1 a, T2 b)
+		{
+			return a << b;
+		}
+		template <typename T1, typename T2>
+		static constexpr auto fallback(T1 a, T2)
+		{
+			return a;
+		}
+	};
+
+	struct right_shift
+	{
+		static constexpr const char* message = "Right shift can only be applied to integral types.";
+		template <typename T1, typename T2>
+		static constexpr bool defined = is_integer<T1> && is_integer<T2>;
+		template <typename T1, typename T2>
+		static constexpr const char* check(T1 a, T2 b)
+		{
+			if (!shift_count_valid(a, b))
+				return "Right-hand side must be non-negative and less than the width of the left-hand side for right shift.";
+			return nullptr;
+		}
+		template <typename T1, typename T2>
+		static constexpr auto apply(T1 a, T2 b)
+		{
+			return a >> b;
+		}
+		template <typename T1, typename T2>
+		static constexpr auto fallback(T1 a, T2)
+		{
+			return a;
+		}
+	};
+
+	// The comparisons clamp a negative signed operand to 0 when it is compared
+	// with an unsigned one.
+	struct less : unchecked
+	{
+		static constexpr const char* message = "Less than comparison can only be applied to integral types.";
+		template <typename T1, typename T2>
+		static constexpr bool defined = is_number<T1> && is_number<T2>;
+		template <typename T1, typename T2>
+		static constexpr bool apply(T1 a, T2 b)
+		{
+			if constexpr (std::is_signed_v<T1> && std::is_unsigned_v<T2>)
+				return b < static_cast<T2>(a < 0 ? 0 : a);
+			else if constexpr (std::is_unsigned_v<T1> && std::is_signed_v<T2>)
+				return static_cast<T1>(b < 0 ? 0 : b) < a;
+			else
+				return a < b;
+		}
+		template <typename T1, typename T2>
+		static constexpr bool fallback(T1, T2)
+		{
+			return false;
+		}
+	};
+
+	struct less_equal : unchecked
+	{
+		static constexpr const char* message = "Less than or equal comparison can only be applied to integral types.";
+		template <typename T1, typename T2>
+		static constexpr bool defined = is_number<T1> && is_number<T2>;
+		template <typename T1, typename T2>
+		static constexpr bool apply(T1 a, T2 b)
+		{
+			if constexpr (std::is_signed_v<T1> && std::is_unsigned_v<T2>)
+				return b <= static_cast<T2>(a < 0 ? 0 : a);
+			else if constexpr (std::is_unsigned_v<T1> && std::is_signed_v<T2>)
+				return static_cast<T1>(b < 0 ? 0 : b) <= a;
+			else
+				return a <= b;
+		}
+		template <typename T1, typename T2>
+		static constexpr bool fallback(T1, T2)
+		{
+			return false;
+		}
+	};
+
+	struct greater : unchecked
+	{
+		static constexpr const char* message = "Greater than comparison can only be applied to integral types.";
+		template <typename T1, typename T2>
+		static constexpr bool defined = is_number<T1> && is_number<T2>;
+		template <typename T1, typename T2>
+		static constexpr bool apply(T1 a, T2 b)
+		{
+			if constexpr (std::is_signed_v<T1> && std::is_unsigned_v<T2>)
+				return b > static_cast<T2>(a < 0 ? 0 : a);
+			else if constexpr (std::is_unsigned_v<T1> && std::is_signed_v<T2>)
+				return static_cast<T1>(b < 0 ? 0 : b) > a;
+			else
+				return a > b;
+		}
+		template <typename T1, typename T2>
+		static constexpr bool fallback(T1, T2)
+		{
+			return false;
+		}
+	};
+
+	struct greater_equal : unchecked
+	{
+		static constexpr const char* message = "Greater than or equal comparison can only be applied to integral types.";
+		template <typename T1, typename T2>
+		static constexpr bool defined = is_number<T1> && is_number<T2>;
+		template <typename T1, typename T2>
+		static constexpr bool apply(T1 a, T2 b)
+		{
+			if constexpr (std::is_signed_v<T1> && std::is_unsigned_v<T2>)
+				return b >= static_cast<T2>(a < 0 ? 0 : a);
+			else if constexpr (std::is_unsigned_v<T1> && std::is_signed_v<T2>)
+				return static_cast<T1>(b < 0 ? 0 : b) >= a;
+			else
+				return a >= b;
+		}
+		template <typename T1, typename T2>
+		static constexpr bool fallback(T1, T2)
+		{
+			return false;
+		}
+	};
+
+	// Values of different types never compare equal, as for token_value.
+	struct equal : unchecked
+	{
+		static constexpr const char* message = "";
+		template <typename T1, typename T2>
+		static constexpr bool defined = true;
+		template <typename T1, typename T2>
+		static constexpr bool apply(T1 a, T2 b)
+		{
+			if constexpr (std::is_same_v<T1, T2>)
+				return a == b;
+			else
+				return false;
+		}
+		template <typename T1, typename T2>
+		static constexpr bool fallback(T1, T2)
+		{
+			return false;
+		}
+	};
+
+	struct not_equal : unchecked
+	{
+		static constexpr const char* message = "";
+		template <typename T1, typename T2>
+		static constexpr bool defined = true;
+		template <typename T1, typename T2>
+		static constexpr bool apply(T1 a, T2 b)
+		{
+			if constexpr (std::is_same_v<T1, T2>)
+				return a != b;
+			else
+				return true;
+		}
+		template <typename T1, typename T2>
+		static constexpr bool fallback(T1, T2)
+		{
+			return true;
+		}
+	};
+
+	struct bitwise_and : unchecked
+	{
+		static constexpr const char* message = "Bitwise AND can only be applied to integral types.";
+		template <typename T1, typename T2>
+		static constexpr bool defined = is_integer<T1> && is_integer<T2>;
+		template <typename T1, typename T2>
+		static constexpr auto apply(T1 a, T2 b)
+		{
+			return a & b;
+		}
+		template <typename T1, typename T2>
+		static constexpr auto fallback(T1 a, T2)
+		{
+			return a;
+		}
+	};
+
+	struct bitwise_exclusive_or : unchecked
+	{
+		static constexpr const char* message = "Bitwise XOR can only be applied to integral types.";
+		template <typename T1, typename T2>
+		static constexpr bool defined = is_integer<T1> && is_integer<T2>;
+		template <typename T1, typename T2>
+		static constexpr auto apply(T1 a, T2 b)
+		{
+			return a ^ b;
+		}
+		template <typename T1, typename T2>
+		static constexpr auto fallback(T1 a, T2)
+		{
+			return a;
+		}
+	};
+
+	struct bitwise_or : unchecked
+	{
+		static constexpr const char* message = "Bitwise AND can only be applied to integral types.";
+		template <typename T1, typename T2>
+		static constexpr bool defined = is_integer<T1> && is_integer<T2>;
+		template <typename T1, typename T2>
+		static constexpr auto apply(T1 a, T2 b)
+		{
+			return a | b;
+		}
+		template <typename T1, typename T2>
+		static constexpr auto fallback(T1 a, T2)
+		{
+			return a;
+		}
+	};
+
+	// Logical operators accept bool and int operands.
+	struct logical_and : unchecked
+	{
+		static constexpr const char* message = "Logical AND can only be applied to boolean types.";
+		template <typename T>
+		static constexpr bool is_logical_type = std::is_same_v<T, bool> || std::is_same_v<T, int>;
+		template <typename T1, typename T2>
+		static constexpr bool defined = is_logical_type<T1> && is_logical_type<T2>;
+		template <typename T1, typename T2>
+		static constexpr bool apply(T1 a, T2 b)
+		{
+			return static_cast<bool>(a) && static_cast<bool>(b);
+		}
+		template <typename T1, typename T2>
+		static constexpr bool fallback(T1, T2)
+		{
+			return false;
+		}
+	};
+
+	struct logical_or : unchecked
+	{
+		static constexpr const char* message = "Logical OR can only be applied to boolean types.";
+		template <typename T>
+		static constexpr bool is_logical_type = std::is_same_v<T, bool> || std::is_same_v<T, int>;
+		template <typename T1, typename T2>
+		static constexpr bool defined = is_logical_type<T1> && is_logical_type<T2>;
+		template <typename T1, typename T2>
+		static constexpr bool apply(T1 a, T2 b)
+		{
+			return static_cast<bool>(a) || static_cast<bool>(b);
+		}
+		template <typename T1, typename T2>
+		static constexpr bool fallback(T1, T2)
+		{
+			return false;
+		}
+	};
+
+	struct negate : unchecked
+	{
+		static constexpr const char* message = "Negation can only be applied to signed types.";
+		template <typename T>
+		static constexpr bool defined = std::is_signed_v<T>;
+		template <typename T>
+		static constexpr auto apply(T a)
+		{
+			return -a;
+		}
+		template <typename T>
+		static constexpr bool fallback(T)
+		{
+			return false;
+		}
+	};
+
+	struct not_ : unchecked
+	{
+		static constexpr const char* message = "";
+		template <typename T>
+		static constexpr bool defined = true;
+		template <typename T>
+		static constexpr bool apply(T a)
+		{
+			return !a;
+		}
+		template <typename T>
+		static constexpr bool fallback(T)
+		{
+			return false;
+		}
+	};
+
+	struct bitwise_not : unchecked
+	{
+		static constexpr const char* message = "Bitwise NOT operation is only defined for integral types.";
+		template <typename T>
+		static constexpr bool defined = is_integer<T>;
+		template <typename T>
+		static constexpr auto apply(T a)
+		{
+			return ~a;
+		}
+		template <typename T>
+		static constexpr auto fallback(T)
+		{
+			return 0;
+		}
+	};
+
+	template <typename operation, typename T1, typename T2>
+	constexpr auto binary_result()
+	{
+		if constexpr (operation::template defined<T1, T2>)
+			return operation::apply(T1{}, T2{});
+		else
+			return operation::fallback(T1{}, T2{});
+	}
+
+	template <typename operation, typename T>
+	constexpr auto unary_result()
+	{
+		if constexpr (operation::template defined<T>)
+			return operation::apply(T{});
+		else
+			return operation::fallback(T{});
+	}
+
+	// Result type of a binary operator for the given operand types.
+	template <typename operation, typename T1, typename T2>
+	using binary_result_t = decltype(binary_result<operation, T1, T2>());
+
+	// Result type of a unary operator for the given operand type.
+	template <typename operation, typename T>
+	using unary_result_t = decltype(unary_result<operation, T>());
+
+	// Result type and validity of an operator for every pair of operand type
+	// indices, indexed by left type * value_type_count + right type.
+	template <typename operation>
+	struct binary_types
+	{
+		template <size_t... I>
+		static constexpr std::array<size_t, sizeof...(I)> types(std::index_sequence<I...>)
+		{
+			return { value_index<binary_result_t<operation, value_t<I / value_type_count>, value_t<I % value_type_count>>>... };
+		}
+		template <size_t... I>
+		static constexpr std::array<bool, sizeof...(I)> defined_for(std::index_sequence<I...>)
+		{
+			return { operation::template defined<value_t<I / value_type_count>, value_t<I % value_type_count>>... };
+		}
+		static constexpr auto pairs = std::make_index_sequence<value_type_count * value_type_count>{};
+		static constexpr auto result = types(pairs);
+		static constexpr auto defined = defined_for(pairs);
+	};
+
+	template <typename operation>
+	struct unary_types
+	{
+		template <size_t... I>
+		static constexpr std::array<size_t, sizeof...(I)> types(std::index_sequence<I...>)
+		{
+			return { value_index<unary_result_t<operation, value_t<I>>>... };
+		}
+		template <size_t... I>
+		static constexpr std::array<bool, sizeof...(I)> defined_for(std::index_sequence<I...>)
+		{
+			return { operation::template defined<value_t<I>>... };
+		}
+		static constexpr auto values = std::make_index_sequence<value_type_count>{};
+		static constexpr auto result = types(values);
+		static constexpr auto defined = defined_for(values);
+	};
+}
@@ -0,0 +1,784 @@
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "operations.h"
+#include "optimizer.h"
+
+namespace
+{
+	// Applies operators to literals and remembers whether one reported an error.
+	class folder : public operations
+	{
+	public:
+		bool failed() const
+		{
+			return _failed;
+		}
+	protected:
+		void error(const char*) override
+		{
+			_failed = true;
+		}
+	private:
+		bool _failed{ false };
+	};
+
+	template <size_t I>
+	token_value make_value(unsigned long long value)
+	{
+		return static_cast<value_t<I>>(value);
+	}
+
+	template <size_t... I>
+	constexpr std::array<token_value (*)(unsigned long long), sizeof...(I)> make_value_makers(std::index_sequence<I...>)
+	{
+		return { &make_value<I>... };
+	}
+
+	// Converts a small constant to a value of the given type index.
+	constexpr auto value_makers = make_value_makers(std::make_index_sequence<value_type_count>{});
+
+	bool is_integer_type(size_t type)
+	{
+		return type < value_type_count && type != value_index<bool> && type != value_index<float> && type != value_index<double>;
+	}
+
+	// Width in bits of the values of a type index.
+	size_t type_width(size_t type)
+	{
+		return std::visit([](auto value) { return sizeof(value) * 8; }, value_makers[type](0));
+	}
+
+	bool is_unsigned_type(size_t type)
+	{
+		return type == value_index<unsigned int> || type == value_index<unsigned long> || type == value_index<unsigned long long>;
+	}
+
+	// Integer types arithmetic does not promote, so x op y has the type of x.
+	bool is_closed_type(size_t type)
+	{
+		return is_unsigned_type(type) || type == value_index<int> || type == value_index<long> || type == value_index<long long>;
+	}
+
+	bool is_commutative(token_kind op)
+	{
+		switch (op)
+		{
+		case token_kind::PLUS:
+		case token_kind::STAR:
+		case token_kind::AMP:
+		case token_kind::BAR:
+		case token_kind::CARET:
+		case token_kind::EQUAL_EQUAL:
+		case token_kind::EXCLAIM_EQUAL:
+		case token_kind::AMP_AMP:
+		case token_kind::BAR_BAR:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	// Whether op is defined for every pair of operand types, so operands whose
+	// type is only known at evaluation cannot make it report a type error.
+	bool defined_for_all(token_kind op)
+	{
+		size_t type;
+		for (size_t left = 0; left < value_type_count; ++left)
+		{
+			for (size_t right = 0; right < value_type_count; ++right)
+			{
+				if (!operations::binary_type(op, left, right, type))
+					return false;
+			}
+		}
+		return true;
+	}
+
+	// The comparison that is true exactly when op is false, for operands of
+	// one integer type.
+	bool invert_comparison(token_kind op, token_kind& inverted)
+	{
+		switch (op)
+		{
+		case token_kind::LESS:
+			inverted = token_kind::GREATER_EQUAL;
+			return true;
+		case token_kind::LESS_EQUAL:
+			inverted = token_kind::GREATER;
+			return true;
+		case token_kind::GREATER:
+			inverted = token_kind::LESS_EQUAL;
+			return true;
+		case token_kind::GREATER_EQUAL:
+			inverted = token_kind::LESS;
+			return true;
+		case token_kind::EQUAL_EQUAL:
+			inverted = token_kind::EXCLAIM_EQUAL;
+			return true;
+		case token_kind::EXCLAIM_EQUAL:
+			inverted = token_kind::EQUAL_EQUAL;
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	unsigned long long unsigned_value(const token_value& value)
+	{
+		return std::visit([](auto alternative)
+		{
+			return static_cast<unsigned long long>(alternative);
+		}, value);
+	}
+}
+
+void optimizer::optimize(expression_tree& tree)
+{
+	if (tree.empty())
+		return;
+	_tree = &tree;
+	_nodes.clear();
+	_info.clear();
+	_shared.clear();
+	// Nodes are stored children first, so their operands are already rewritten.
+	std::vector<size_t> rewritten(tree.size());
+	for (size_t index = 0; index < tree.size(); ++index)
+	{
+		const auto& node = tree.node(index);
+		const auto& position = tree.position(index);
+		rewrite_node rewrite{ node.kind, node.op, position.line, position.column, 0, 0, 0, 0 };
+		switch (node.kind)
+		{
+		case node_kind::UNARY:
+			rewritten[index] = simplify_unary(rewrite, rewritten[node.left]);
+			break;
+		case node_kind::BINARY:
+			rewritten[index] = simplify_binary(rewrite, rewritten[node.left], rewritten[node.right]);
+			break;
+		case node_kind::CONDITIONAL:
+			rewritten[index] = simplify_conditional(rewrite, rewritten[node.condition], rewritten[node.left],
+				rewritten[node.right]);
+			break;
+		case node_kind::BRANCH:
+			// emit adds them again for the nodes that are left.
+			break;
+		case node_kind::LITERAL:
+			rewrite.value = tree.literal(index);
+			rewritten[index] = add(rewrite);
+			break;
+		case node_kind::VARIABLE:
+			rewrite.slot = node.slot;
+			rewritten[index] = add(rewrite);
+			break;
+		}
+	}
+	auto root = rewritten[tree.root()];
+	tree._nodes.clear();
+	tree._positions.clear();
+	tree._literals.clear();
+	_emitted.assign(_nodes.size(), not_emitted);
+	_emitted_log.clear();
+	tree._root = emit(root, tree);
+	_tree = nullptr;
+}
+
+optimizer::node_key optimizer::key(const rewrite_node& node)
+{
+	node_key key{ node.kind, node.op, 0, 0, 0, 0, 0, 0 };
+	switch (node.kind)
+	{
+	case node_kind::LITERAL:
+		key.type = node.value.index();
+		std::visit([&key](auto value)
+		{
+			std::memcpy(&key.bits, &value, sizeof(value));
+		}, node.value);
+		break;
+	case node_kind::VARIABLE:
+		key.slot = node.slot;
+		break;
+	case node_kind::CONDITIONAL:
+		key.condition = node.condition;
+		key.left = node.left;
+		key.right = node.right;
+		break;
+	default:
+		key.left = node.left;
+		key.right = node.kind == node_kind::BINARY ? node.right : 0;
+		break;
+	}
+	return key;
+}
+
+size_t optimizer::node_key_hash::operator()(const node_key& key) const
+{
+	size_t hash = static_cast<size_t>(key.kind) * 31 + static_cast<size_t>(key.op);
+	for (auto part : { key.type, static_cast<size_t>(key.bits), key.left, key.right, key.slot, key.condition })
+		hash = (hash ^ part) * 0x100000001b3;
+	return hash;
+}
+
+// Returns the equal node if there is one already.
+size_t optimizer::add(const rewrite_node& node)
+{
+	auto [shared, added] = _shared.try_emplace(key(node), _nodes.size());
+	if (!added)
+		return shared->second;
+	node_info info{ dynamic_type, false };
+	switch (node.kind)
+	{
+	case node_kind::LITERAL:
+		info.type = node.value.index();
+		break;
+	case node_kind::VARIABLE:
+		info.type = _tree->slot_type(node.slot);
+		break;
+	case node_kind::UNARY:
+	{
+		const auto& operand = _info[node.left];
+		auto defined = operations::unary_type(node.op, operand.type, info.type);
+		info.can_fail = operand.can_fail || !defined || operand.type == dynamic_type;
+		break;
+	}
+	case node_kind::BINARY:
+	{
+		const auto& left = _info[node.left];
+		const auto& right = _info[node.right];
+		auto defined = operations::binary_type(node.op, left.type, right.type, info.type);
+		info.can_fail = left.can_fail || right.can_fail || !defined;
+		if (!info.can_fail && (left.type == dynamic_type || right.type == dynamic_type))
+			info.can_fail = !defined_for_all(node.op);
+		switch (node.op)
+		{
+		case token_kind::LESS_LESS:
+		case token_kind::GREATER_GREATER:
+			// A count that is negative or not less than the width is an error.
+			info.can_fail = info.can_fail || _nodes[node.right].kind != node_kind::LITERAL
+				|| !is_integer_type(info.type) || std::visit([&info](auto count)
+			{
+				if constexpr (std::is_signed_v<decltype(count)>)
+				{
+					if (count < 0)
+						return true;
+				}
+				return static_cast<unsigned long long>(count) >= type_width(info.type);
+			}, _nodes[node.right].value);
+			break;
+		case token_kind::SLASH:
+		case token_kind::PERCENT:
+			// Integer division by zero, or of the minimum by -1, traps.
+			if (is_integer_type(info.type) || info.type == dynamic_type)
+			{
+				info.can_fail = info.can_fail || _nodes[node.right].kind != node_kind::LITERAL || std::visit([](auto divisor)
+				{
+					return divisor == 0 || divisor + 1 == 0;
+				}, _nodes[node.right].value);
+			}
+			break;
+		default:
+			break;
+		}
+		break;
+	}
+	case node_kind::CONDITIONAL:
+	{
+		const auto& then_branch = _info[node.left];
+		const auto& else_branch = _info[node.right];
+		if (then_branch.type == else_branch.type)
+			info.type = then_branch.type;
+		info.can_fail = _info[node.condition].can_fail || then_branch.can_fail || else_branch.can_fail;
+		break;
+	}
+	case node_kind::BRANCH:
+		break;
+	}
+	_nodes.push_back(node);
+	_info.push_back(info);
+	return _nodes.size() - 1;
+}
+
+size_t optimizer::add_literal(const token_value& value, const rewrite_node& position)
+{
+	return add({ node_kind::LITERAL, position.op, position.line, position.column, value, 0, 0, 0 });
+}
+
+size_t optimizer::add_binary(token_kind op, size_t left, size_t right, const rewrite_node& position)
+{
+	return add({ node_kind::BINARY, op, position.line, position.column, 0, left, right, 0 });
+}
+
+size_t optimizer::simplify_unary(const rewrite_node& node, size_t operand)
+{
+	auto unary{ node };
+	unary.left = operand;
+	auto index = add(unary);
+	const auto info = _info[index];
+	if (info.can_fail || info.type == dynamic_type)
+		return index;
+	token_value value;
+	if (fold(_nodes[index], value))
+		return add_literal(value, node);
+	const auto inner = _nodes[operand];
+	switch (node.op)
+	{
+	case token_kind::DASH:
+	case token_kind::TILDE:
+		// -(-x) and ~~x are x unless the inner operator promoted x.
+		if (inner.kind == node_kind::UNARY && inner.op == node.op && _info[inner.left].type == info.type)
+			return inner.left;
+		break;
+	case token_kind::EXCLAIM:
+	{
+		if (inner.kind == node_kind::UNARY && inner.op == node.op && _info[inner.left].type == value_index<bool>)
+			return inner.left;
+		// !(a < b) is a >= b for integers, and !(a == b) is a != b for anything.
+		token_kind inverted;
+		if (inner.kind == node_kind::BINARY && invert_comparison(inner.op, inverted))
+		{
+			auto left_type = _info[inner.left].type;
+			auto right_type = _info[inner.right].type;
+			auto equality = inner.op == token_kind::EQUAL_EQUAL || inner.op == token_kind::EXCLAIM_EQUAL;
+			if (equality || (left_type == right_type && is_integer_type(left_type)))
+				return add_binary(inverted, inner.left, inner.right, inner);
+		}
+		break;
+	}
+	default:
+		break;
+	}
+	return index;
+}
+
+size_t optimizer::simplify_binary(const rewrite_node& node, size_t left, size_t right)
+{
+	// A literal left operand of && or || that decides it leaves the right one
+	// unevaluated, whatever errors it could report; one that does not leaves
+	// the value of the right one.
+	if ((node.op == token_kind::AMP_AMP || node.op == token_kind::BAR_BAR) && _nodes[left].kind == node_kind::LITERAL
+		&& operations::is_logical_type(_info[left].type))
+	{
+		auto decides = node.op == token_kind::BAR_BAR;
+		if (operations::truth(_nodes[left].value) == decides)
+			return add_literal(decides, node);
+		if (_info[right].type == value_index<bool>)
+			return right;
+	}
+	auto binary{ node };
+	binary.left = left;
+	binary.right = right;
+	auto index = add(binary);
+	const auto info = _info[index];
+	if (info.can_fail || info.type == dynamic_type)
+		return index;
+	token_value value;
+	if (fold(_nodes[index], value))
+		return add_literal(value, node);
+
+	auto left_type = _info[left].type;
+	auto right_type = _info[right].type;
+	// Literals go to the right of commutative integer operators, where the
+	// rules below and the bytecode constant forms expect them.
+	if (is_commutative(node.op) && _nodes[left].kind == node_kind::LITERAL && _nodes[right].kind != node_kind::LITERAL
+		&& left_type != value_index<float> && left_type != value_index<double>
+		&& right_type != value_index<float> && right_type != value_index<double>)
+	{
+		size_t swapped_type;
+		if (operations::binary_type(node.op, right_type, left_type, swapped_type) && swapped_type == info.type)
+		{
+			std::swap(left, right);
+			std::swap(left_type, right_type);
+			index = add_binary(node.op, left, right, node);
+		}
+	}
+
+	// x itself where the rewrite keeps the type of the node.
+	auto keep = [&](size_t operand)
+	{
+		return _info[operand].type == info.type ? operand : index;
+	};
+	auto constant = [&](unsigned long long constant)
+	{
+		return add_literal(value_makers[info.type](constant), node);
+	};
+	auto identical = same(left, right) && left_type == right_type;
+	switch (node.op)
+	{
+	case token_kind::PLUS:
+		// Not for floating point: -0.0 + 0 is 0.0.
+		if (is_literal(right, 0) && is_integer_type(left_type))
+			return keep(left);
+		return reassociate(index, left, right);
+	case token_kind::DASH:
+		if (is_literal(right, 0))
+			return keep(left);
+		if (identical && is_integer_type(left_type))
+			return constant(0);
+		return reassociate(index, left, right);
+	case token_kind::STAR:
+		if (is_literal(right, 1))
+			return keep(left);
+		// Not for floating point: NaN * 0 is NaN and -1.0 * 0 is -0.0.
+		if (is_literal(right, 0) && is_integer_type(left_type))
+			return constant(0);
+		return reassociate(index, left, right);
+	case token_kind::SLASH:
+		if (is_literal(right, 1))
+			return keep(left);
+		break;
+	case token_kind::AMP:
+		if (is_literal(right, 0))
+			return constant(0);
+		if (identical)
+			return keep(left);
+		return reassociate(index, left, right);
+	case token_kind::BAR:
+		if (is_literal(right, 0))
+			return keep(left);
+		if (identical)
+			return keep(left);
+		return reassociate(index, left, right);
+	case token_kind::CARET:
+		if (is_literal(right, 0))
+			return keep(left);
+		if (identical)
+			return constant(0);
+		return reassociate(index, left, right);
+	case token_kind::LESS_LESS:
+	case token_kind::GREATER_GREATER:
+		if (is_literal(right, 0))
+			return keep(left);
+		break;
+	case token_kind::AMP_AMP:
+		// Logical operands are bool or int, so a literal is 0 or true.
+		if (is_literal(right, 0))
+			return constant(0);
+		if (_nodes[right].kind == node_kind::LITERAL && left_type == value_index<bool>)
+			return left;
+		return simplify_range(index, left, right);
+	case token_kind::BAR_BAR:
+		if (_nodes[right].kind == node_kind::LITERAL && !is_literal(right, 0))
+			return constant(1);
+		if (is_literal(right, 0) && left_type == value_index<bool>)
+			return left;
+		break;
+	case token_kind::LESS_EQUAL:
+	case token_kind::GREATER_EQUAL:
+	case token_kind::EQUAL_EQUAL:
+		if (identical && is_integer_type(left_type))
+			return constant(1);
+		break;
+	case token_kind::LESS:
+	case token_kind::GREATER:
+	case token_kind::EXCLAIM_EQUAL:
+		if (identical && is_integer_type(left_type))
+			return constant(0);
+		break;
+	default:
+		break;
+	}
+	return index;
+}
+
+size_t optimizer::simplify_conditional(const rewrite_node& node, size_t condition, size_t then_branch,
+	size_t else_branch)
+{
+	if (_nodes[condition].kind == node_kind::LITERAL)
+		return operations::truth(_nodes[condition].value) ? then_branch : else_branch;
+	if (!_info[condition].can_fail && same(then_branch, else_branch))
+		return then_branch;
+	auto conditional{ node };
+	conditional.condition = condition;
+	conditional.left = then_branch;
+	conditional.right = else_branch;
+	return add(conditional);
+}
+
+// (a <= x) && (x <= b) on an unsigned x compares x once: x - a <= b - a.
+size_t optimizer::simplify_range(size_t index, size_t left, size_t right)
+{
+	const auto node = _nodes[index];
+	struct bound
+	{
+		size_t value;      // the bounded operand
+		size_t limit;      // the literal
+		bool   lower;
+	};
+	auto get_bound = [&](size_t operand, bound& bound)
+	{
+		const auto& comparison = _nodes[operand];
+		if (comparison.kind != node_kind::BINARY)
+			return false;
+		auto literal_left = _nodes[comparison.left].kind == node_kind::LITERAL;
+		auto literal_right = _nodes[comparison.right].kind == node_kind::LITERAL;
+		if (literal_left == literal_right)
+			return false;
+		if (comparison.op == token_kind::LESS_EQUAL)
+			bound.lower = literal_left;
+		else if (comparison.op == token_kind::GREATER_EQUAL)
+			bound.lower = literal_right;
+		else
+			return false;
+		bound.value = literal_left ? comparison.right : comparison.left;
+		bound.limit = literal_left ? comparison.left : comparison.right;
+		auto type = _info[bound.value].type;
+		return is_unsigned_type(type) && _info[bound.limit].type == type;
+	};
+	bound first, second;
+	if (!get_bound(left, first) || !get_bound(right, second) || first.lower == second.lower || !same(first.value, second.value))
+		return index;
+	const auto& lower = first.lower ? first : second;
+	const auto& upper = first.lower ? second : first;
+	auto low = unsigned_value(_nodes[lower.limit].value);
+	auto high = unsigned_value(_nodes[upper.limit].value);
+	if (low > high)
+		return add_literal(false, node);
+	if (low == 0)
+		return first.lower ? right : left;
+	auto type = _info[lower.value].type;
+	auto offset = add_binary(token_kind::DASH, lower.value, lower.limit, node);
+	auto width = add_literal(value_makers[type](high - low), node);
+	return add_binary(token_kind::LESS_EQUAL, offset, width, node);
+}
+
+// (x + c1) + c2 is x + (c1 + c2) when x, c1 and c2 have the same integer type.
+size_t optimizer::reassociate(size_t index, size_t left, size_t right)
+{
+	const auto node = _nodes[index];
+	auto type = _info[index].type;
+	const auto inner = _nodes[left];
+	if (!is_closed_type(type) || _nodes[right].kind != node_kind::LITERAL || _info[right].type != type
+		|| inner.kind != node_kind::BINARY || _nodes[inner.right].kind != node_kind::LITERAL
+		|| _info[inner.right].type != type || _info[inner.left].type != type)
+		return index;
+	auto op = node.op;
+	auto combine = op;
+	switch (node.op)
+	{
+	case token_kind::PLUS:
+	case token_kind::DASH:
+		// x + c1 - c2 is x + (c1 - c2), x - c1 - c2 is x - (c1 + c2).
+		if (inner.op != token_kind::PLUS && inner.op != token_kind::DASH)
+			return index;
+		op = inner.op;
+		combine = inner.op == node.op ? token_kind::PLUS : token_kind::DASH;
+		break;
+	default:
+		if (inner.op != node.op)
+			return index;
+		break;
+	}
+	folder folder;
+	auto value = folder.binary(combine, _nodes[inner.right].value, _nodes[right].value);
+	if (folder.failed())
+		return index;
+	auto position{ inner };
+	position.op = op;
+	return simplify_binary(position, inner.left, add_literal(value, node));
+}
+
+bool optimizer::fold(const rewrite_node& node, token_value& value)
+{
+	if (_nodes[node.left].kind != node_kind::LITERAL)
+		return false;
+	folder folder;
+	if (node.kind == node_kind::UNARY)
+	{
+		value = folder.unary(node.op, _nodes[node.left].value);
+	}
+	else
+	{
+		if (_nodes[node.right].kind != node_kind::LITERAL)
+			return false;
+		value = folder.binary(node.op, _nodes[node.left].value, _nodes[node.right].value);
+	}
+	return !folder.failed();
+}
+
+bool optimizer::same(size_t left, size_t right) const
+{
+	if (left == right)
+		return true;
+	const auto& a = _nodes[left];
+	const auto& b = _nodes[right];
+	if (a.kind != b.kind)
+		return false;
+	switch (a.kind)
+	{
+	case node_kind::LITERAL:
+		return a.value == b.value;
+	case node_kind::VARIABLE:
+		return a.slot == b.slot;
+	case node_kind::UNARY:
+		return a.op == b.op && same(a.left, b.left);
+	case node_kind::CONDITIONAL:
+		return same(a.condition, b.condition) && same(a.left, b.left) && same(a.right, b.right);
+	case node_kind::BINARY:
+	default:
+		return a.op == b.op && same(a.left, b.left) && same(a.right, b.right);
+	}
+}
+
+// A literal equal to value; for floating point +0.0 only, not -0.0.
+bool optimizer::is_literal(size_t index, long long value) const
+{
+	const auto& node = _nodes[index];
+	if (node.kind != node_kind::LITERAL)
+		return false;
+	return std::visit([value](auto alternative)
+	{
+		using T = decltype(alternative);
+		if constexpr (std::is_floating_point_v<T>)
+			return alternative == static_cast<T>(value) && !std::signbit(alternative);
+		else
+			return alternative == static_cast<T>(value);
+	}, node.value);
+}
+
+// Stores the nodes reachable from index in the tree in post-order, dropping
+// the ones the rewrites made unreachable, with the BRANCH nodes of && and ||
+// and conditionals. A node already emitted is referred to again. Nodes wait
+// for their operands on _emit_stack, so deep trees take no stack.
+size_t optimizer::emit(size_t index, expression_tree& tree)
+{
+	_emit_stack.clear();
+	_emit_stack.push_back({ index, 0 });
+	size_t emitted_index{ 0 };   // tree index of the node emitted last
+	while (!_emit_stack.empty())
+	{
+		auto& frame = _emit_stack.back();
+		const auto& node = _nodes[frame.index];
+		auto& emitted = frame.emitted;
+		if (frame.operands == 0)
+		{
+			if (_emitted[frame.index] != not_emitted)
+			{
+				emitted_index = _emitted[frame.index];
+				_emit_stack.pop_back();
+				continue;
+			}
+			emitted = expression_node{ node.kind, node.op };
+		}
+		else
+		{
+			// The operand requested last is emitted.
+			switch (node.kind)
+			{
+			case node_kind::UNARY:
+				emitted.left = static_cast<std::uint32_t>(emitted_index);
+				break;
+			case node_kind::BINARY:
+				if (frame.operands == 1)
+				{
+					emitted.left = static_cast<std::uint32_t>(emitted_index);
+					if (node.op == token_kind::AMP_AMP || node.op == token_kind::BAR_BAR)
+						frame.branch = emit_branch(node.op, emitted.left, node, tree);
+				}
+				else
+				{
+					emitted.right = static_cast<std::uint32_t>(emitted_index);
+					if (frame.branch != 0)
+						forget_emitted(frame.mark);
+				}
+				break;
+			case node_kind::CONDITIONAL:
+				if (frame.operands == 1)
+				{
+					emitted.condition = static_cast<std::uint32_t>(emitted_index);
+					frame.condition_branch = emit_branch(token_kind::QUESTION, emitted.condition, node, tree);
+				}
+				else if (frame.operands == 2)
+				{
+					emitted.left = static_cast<std::uint32_t>(emitted_index);
+					forget_emitted(frame.mark);
+					frame.branch = emit_branch(token_kind::COLON, emitted.left, node, tree);
+					tree.set_branch_target(frame.condition_branch, frame.branch + 1);
+				}
+				else
+				{
+					emitted.right = static_cast<std::uint32_t>(emitted_index);
+					forget_emitted(frame.mark);
+				}
+				break;
+			default:
+				break;
+			}
+		}
+		// The next operand, and whether evaluation may skip it.
+		auto operand{ not_emitted };
+		auto skipped{ false };
+		switch (node.kind)
+		{
+		case node_kind::UNARY:
+			if (frame.operands == 0)
+				operand = node.left;
+			break;
+		case node_kind::BINARY:
+			if (frame.operands == 0)
+				operand = node.left;
+			else if (frame.operands == 1)
+			{
+				operand = node.right;
+				skipped = frame.branch != 0;
+			}
+			break;
+		case node_kind::CONDITIONAL:
+			if (frame.operands == 0)
+				operand = node.condition;
+			else if (frame.operands < 3)
+			{
+				operand = frame.operands == 1 ? node.left : node.right;
+				skipped = true;
+			}
+			break;
+		case node_kind::LITERAL:
+			tree._literals.push_back(node.value);
+			emitted.literal = static_cast<std::uint32_t>(tree._literals.size() - 1);
+			break;
+		case node_kind::VARIABLE:
+			emitted.slot = static_cast<std::uint32_t>(node.slot);
+			break;
+		case node_kind::BRANCH:
+			break;
+		}
+		if (operand != not_emitted)
+		{
+			++frame.operands;
+			if (skipped)
+				frame.mark = _emitted_log.size();
+			_emit_stack.push_back({ operand, 0 });
+			continue;
+		}
+		tree._nodes.push_back(emitted);
+		tree._positions.push_back({ node.line, node.column });
+		emitted_index = tree._nodes.size() - 1;
+		if (frame.branch != 0)
+			tree.set_branch_target(frame.branch, emitted_index);
+		_emitted[frame.index] = emitted_index;
+		_emitted_log.push_back(frame.index);
+		_emit_stack.pop_back();
+	}
+	return emitted_index;
+}
+
+// Forgets what was emitted since the log had mark entries: an operand or
+// branch evaluation may skip, whose values are not there when it is skipped.
+void optimizer::forget_emitted(size_t mark)
+{
+	for (auto i = mark; i < _emitted_log.size(); ++i)
+		_emitted[_emitted_log[i]] = not_emitted;
+	_emitted_log.resize(mark);
+}
+
+size_t optimizer::emit_branch(token_kind op, size_t operand, const rewrite_node& position, expression_tree& tree)
+{
+	expression_node branch{ node_kind::BRANCH, op };
+	branch.left = static_cast<std::uint32_t>(operand);
+	tree._nodes.push_back(branch);
+	tree._positions.push_back({ position.line, position.column });
+	return tree._nodes.size() - 1;
+}
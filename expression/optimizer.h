@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "expression_tree.h"
+
+// Rewrites a compiled expression into a smaller one with the same value, the
+// same result type and the same errors for every input. Subtrees of literals
+// are folded into a literal, and identities such as x * 1, x + 0, x & 0,
+// double negation and range checks on one value are simplified where the
+// operand types make the rewrite exact. Types come from literals and typed
+// variables; a rewrite never drops a subtree that can report an error.
+//
+// Equal subtrees become one node that every parent refers to, so the tree is
+// a DAG evaluated once per node; an error such a node reports is reported
+// once. A node is not shared out of an operand of && or || or a branch of a
+// conditional, which evaluation may skip.
+class optimizer
+{
+public:
+	void optimize(expression_tree& tree);
+private:
+	// A node with its value and position, so rewrites create and copy nodes
+	// as a whole.
+	struct rewrite_node
+	{
+		node_kind   kind;
+		token_kind  op;
+		size_t      line;
+		size_t      column;
+		token_value value;    // value of LITERAL nodes
+		size_t      left;     // operand of UNARY, left operand of BINARY, then branch of CONDITIONAL nodes
+		size_t      right;    // right operand of BINARY, else branch of CONDITIONAL nodes
+		size_t      slot;     // value slot of VARIABLE nodes
+		size_t      condition{ 0 };   // condition of CONDITIONAL nodes
+	};
+	struct node_info
+	{
+		size_t type;       // type index of the value, dynamic_type if unknown
+		bool   can_fail;   // evaluating the subtree can report an error
+	};
+	// What makes two nodes equal: operands are compared by index, as equal
+	// operands are one node already, and literals by their bits.
+	struct node_key
+	{
+		node_kind     kind;
+		token_kind    op;
+		size_t        type;       // type index of LITERAL values
+		std::uint64_t bits;       // bits of LITERAL values
+		size_t        left;
+		size_t        right;
+		size_t        slot;
+		size_t        condition;
+		bool operator==(const node_key&) const = default;
+	};
+	struct node_key_hash
+	{
+		size_t operator()(const node_key& key) const;
+	};
+	// A node emit has started, waiting for its operands.
+	struct emit_frame
+	{
+		size_t          index;
+		size_t          operands;                // operands requested so far
+		expression_node emitted{};
+		size_t          branch{ 0 };             // BRANCH node of && and ||, or of the then branch
+		size_t          condition_branch{ 0 };   // BRANCH node of the condition
+		size_t          mark{ 0 };               // _emitted_log size before a skipped operand
+	};
+	static constexpr size_t not_emitted = ~size_t{ 0 };
+	const expression_tree* _tree{ nullptr };
+	std::vector<rewrite_node> _nodes;
+	std::vector<node_info> _info;
+	std::unordered_map<node_key, size_t, node_key_hash> _shared;
+	std::vector<size_t> _emitted;       // tree index of every node emitted, not_emitted if none
+	std::vector<size_t> _emitted_log;   // nodes in the order emitted, to forget those of skipped operands
+	std::vector<emit_frame> _emit_stack;
+	static node_key key(const rewrite_node& node);
+	size_t add(const rewrite_node& node);
+	size_t add_literal(const token_value& value, const rewrite_node& position);
+	size_t add_binary(token_kind op, size_t left, size_t right, const rewrite_node& position);
+	size_t simplify_unary(const rewrite_node& node, size_t operand);
+	size_t simplify_binary(const rewrite_node& node, size_t left, size_t right);
+	size_t simplify_conditional(const rewrite_node& node, size_t condition, size_t then_branch, size_t else_branch);
+	size_t simplify_range(size_t index, size_t left, size_t right);
+	size_t reassociate(size_t index, size_t left, size_t right);
+	bool fold(const rewrite_node& node, token_value& value);
+	bool same(size_t left, size_t right) const;
+	bool is_literal(size_t index, long long value) const;
+	size_t emit(size_t index, expression_tree& tree);
+	void forget_emitted(size_t mark);
+	static size_t emit_branch(token_kind op, size_t operand, const rewrite_node& position, expression_tree& tree);
+};
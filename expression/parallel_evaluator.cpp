@@ -0,0 +1,52 @@
+#include <cstring>
+
+#include "expression_tree.h"
+#include "parallel_evaluator.h"
+#include "parser.h"
+
+std::vector<evaluation> parallel_evaluator::evaluate(std::span<const std::string_view> expressions)
+{
+	std::vector<evaluation> results(expressions.size());
+	_pool.parallel_for(expressions.size(), grain, [&](size_t begin, size_t end) {
+		parser parser;
+		expression_tree tree;
+		diagnostic_buffer diagnostics;
+		for (auto i = begin; i < end; ++i)
+		{
+			auto expression = expressions[i];
+			if (expression.find_first_not_of(" \t\v\f\r") == std::string_view::npos)
+				continue;
+			parser.reset(expression, i + 1);
+			if (!parser.compile(tree))
+			{
+				auto records = parser.diagnostics().records();
+				results[i].diagnostics.assign(records.begin(), records.end());
+				continue;
+			}
+			diagnostics.clear();
+			results[i].valid = tree.evaluate(results[i].value, {}, diagnostics);
+			auto records = diagnostics.records();
+			results[i].diagnostics.assign(records.begin(), records.end());
+		}
+		});
+	return results;
+}
+
+std::vector<evaluation> parallel_evaluator::evaluate(const std::vector<std::string>& expressions)
+{
+	std::vector<std::string_view> views{ expressions.begin(), expressions.end() };
+	return evaluate(views);
+}
+
+std::vector<evaluation> parallel_evaluator::evaluate_lines(std::string_view source)
+{
+	std::vector<std::string_view> lines;
+	while (!source.empty())
+	{
+		auto end = static_cast<const char*>(std::memchr(source.data(), '\n', source.size()));
+		auto length = end ? static_cast<size_t>(end - source.data()) : source.size();
+		lines.push_back(source.substr(0, length));
+		source.remove_prefix(end ? length + 1 : length);
+	}
+	return evaluate(lines);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "diagnostics.h"
+#include "thread_pool.h"
+#include "token.h"
+
+// The value of one expression of a set, valid if it was compiled and
+// evaluated without errors. The diagnostics are those of its compilation or
+// evaluation, and refer to the text of that expression.
+struct evaluation
+{
+	token_value value;
+	bool valid{ false };
+	std::vector<diagnostic> diagnostics;
+};
+
+// Compiles and evaluates a set of independent expressions on all threads of a
+// pool and returns the results in input order. Every chunk of expressions is
+// compiled with a parser and tree of its own, so the threads share nothing but
+// the input and their slices of the results. Parse and evaluation errors are
+// returned with the results rather than written, and give the position of an
+// expression in the set as its line. Blank expressions are not evaluated and are not valid.
+class parallel_evaluator
+{
+public:
+	// 0 threads means one per hardware thread.
+	explicit parallel_evaluator(unsigned int threads = 0) : _pool{ threads }
+	{}
+	std::vector<evaluation> evaluate(std::span<const std::string_view> expressions);
+	std::vector<evaluation> evaluate(const std::vector<std::string>& expressions);
+	// Evaluates every line of source, such as the contents of a mapped_file.
+	std::vector<evaluation> evaluate_lines(std::string_view source);
+	unsigned int threads() const
+	{
+		return _pool.size();
+	}
+private:
+	// Expressions per chunk: enough to amortise taking a chunk, few enough
+	// to balance sets whose expressions differ in cost.
+	static constexpr size_t grain = 64;
+	thread_pool _pool;
+};
@@ -1,81 +1,126 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <variant>
+#include <vector>
 #include <deque>
 
+#include "diagnostics.h"
+#include "expression_tree.h"
+#include "mapped_file.h"
 #include "precedence.h"
 #include "scanner.h"
 #include "token.h"
+#include "variables.h"
 
+// Parses one source at a time and holds the state of that parse, so a parser
+// belongs to one thread. What it compiles does not refer back to it; see
+// compiled_expression for sharing the result between threads. Errors are
+// recorded in a diagnostic_buffer, which reset clears, for the caller to read
+// or write after the parse.
 class parser
 {
+	// What waits on the operator stack of a parse for its operands.
+	enum class pending_kind : unsigned char
+	{
+		UNARY,
+		BINARY,
+		LPAREN,
+		QUESTION,   // a conditional before its :
+		COLON,      // a conditional after its :
+	};
+	struct pending_operator
+	{
+		pending_kind kind;
+		operator_precedence precedence;
+		token op;
+		size_t branch;   // BRANCH node of && and ||, or of the condition or then branch, 0 if none
+	};
+	// A node parsed, and whether it parsed without errors.
+	struct parsed_operand
+	{
+		size_t node;
+		bool valid;
+	};
 public:
 	parser(const std::string& filename);
+	// A parser for sources in memory, given to reset.
+	parser() : _scanner{ *this }
+	{}
+	// Parses source from now on, without copying it; it must outlive the
+	// parsing. line is the line number of its first line in diagnostics.
+	void reset(std::string_view source, size_t line = 1);
 	bool parse(token_value& value);
+	bool compile(expression_tree& tree);
+	bool compile(expression_tree& tree, variables& variables);
+	// Where the diagnostics of a parse are recorded, a buffer of the parser's
+	// own unless set. Its limit and fail_fast setting apply to the parses.
+	void set_diagnostics(diagnostic_buffer& diagnostics)
+	{
+		_diagnostics = &diagnostics;
+	}
+	const diagnostic_buffer& diagnostics() const
+	{
+		return *_diagnostics;
+	}
+	// Whether compile optimizes the tree and lowers its operators to their
+	// operand types, as it does unless set off. The tree as written evaluates
+	// every operator through operations, as a reference for both.
+	void set_optimize(bool optimize)
+	{
+		_optimize = optimize;
+	}
+	// The source being parsed, which diagnostics refer to.
+	std::string_view source() const
+	{
+		return _source;
+	}
 private:
-	std::string _source;
+	mapped_file _file;
 	scanner _scanner;
 	unsigned int _error_distance{ 3 };
 	unsigned int _errors{ 0 };
+	bool _stopped{ false };   // a fail_fast buffer took an error, the rest is not parsed
+	bool _optimize{ true };
+	diagnostic_buffer _own_diagnostics;
+	diagnostic_buffer* _diagnostics{ &_own_diagnostics };
+	std::string_view _source;
 	size_t _line;
 	token _lookahead_token;
 	token _token;
 	size_t _pos;
-	bool check(token_kind expected_token_kind, const std::string& error_message);
-	void error(const std::string& message);
-	void error(std::string&& message);
+	expression_tree* _tree{ nullptr };
+	variables* _variables{ nullptr };
+	std::vector<pending_operator> _operators;
+	std::vector<parsed_operand> _operands;
+	bool check(token_kind expected_token_kind, diagnostic_id id);
+	void error(diagnostic_id id);
 	bool is_primary_expression(token token)
 	{
 		switch (token.kind)
 		{
-		case token_kind::INT_LITERAL:
-		case token_kind::UNSIGNED_INT_LITERAL:
-		case token_kind::LONG_LITERAL:
-		case token_kind::UNSIGNED_LONG_LITERAL:
-		case token_kind::LONG_LONG_LITERAL:
-		case token_kind::UNSIGNED_LONG_LONG_LITERAL:
-		case token_kind::FLOAT_LITERAL:
-		case token_kind::DOUBLE_LITERAL:
+		case token_kind::NUMBER_LITERAL:
+		case token_kind::IDENTIFIER:
 			return true;
 		default:
 			return false;
 		}
 	}
-	void scan(size_t n = 0)
+	void scan()
 	{
+		if (_stopped)
+			return;
 		_token = _lookahead_token;
 		_pos = _scanner.column();
 		_line = _scanner.line();
 		_lookahead_token = _scanner.next();
 		_error_distance++;
 	}
-	bool parse_expression(token_value& value);
-	bool parse_binary_expression(token_value& value);
-	bool parse_binary_expression_prime(token_value& value, operator_precedence minimal_precedence);
-	bool parse_hex_literal(token_value& value, bool& is_hex);
-	bool parse_integer_literal(token_value& value);
-	bool parse_primary_expression(token_value& value);
-	bool parse_unary_expression(token_value& value);
-
-	token_value add(token_value& lhs, token_value& rhs);
-	token_value subtract(token_value& lhs, token_value& rhs);
-	token_value multiply(token_value& lhs, token_value& rhs);
-	token_value divide(token_value& lhs, token_value& rhs);
-	token_value modulus(token_value& lhs, token_value& rhs);
-	token_value left_shift(token_value& left, token_value& right);
-	token_value right_shift(token_value& left, token_value& right);
-	token_value bitwise_and(token_value& left, token_value& right);
-	token_value bitwise_not(token_value& value);
-	token_value bitwise_or(token_value& left, token_value& right);
-	bool greater(token_value& left, token_value& right);
-	bool less(token_value& left, token_value& right);
-	bool greater_equal(token_value& left, token_value& right);
-	bool less_equal(token_value& left, token_value& right);
-	bool logical_and(token_value& left, token_value& right);
-	bool logical_or(token_value& left, token_value& right);
-	token_value bitwise_exclusive_or(token_value& left, token_value& right);
-	token_value negate(token_value& value);
-	token_value not_(token_value& value);
+	bool parse_expression(size_t& node);
+	bool parse_conditional_expression(size_t& node);
+	void parse_operand();
+	void complete_operand();
+	void reduce_binary(operator_precedence minimal_precedence);
+	bool parse_primary_expression(size_t& node);
 };
-
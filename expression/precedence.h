@@ -17,11 +17,50 @@ enum class operator_precedence : size_t
 	POINT,
 };
 
+// Indexed by token kind. In the header, so constant evaluation parses with it.
+inline constexpr operator_precedence precedence_table[static_cast<size_t>(token_kind::BAR_BAR) + 1] =
+{
+	operator_precedence::NO_PRECEDENCE, // no token kind is 0
+	operator_precedence::NO_PRECEDENCE, // token::UNDEFINED
+	operator_precedence::POINT,        // token::STAR
+	operator_precedence::POINT,        // token::SLASH
+	operator_precedence::POINT,        // token::PERCENT
+	operator_precedence::STROKE,       // token::PLUS
+	operator_precedence::STROKE,       // token::DASH
+	operator_precedence::SHIFT,        // token::LESS_LESS
+	operator_precedence::SHIFT,        // token::GREATER_GREATER
+	operator_precedence::RELATIONAL,   // token::LESS
+	operator_precedence::RELATIONAL,   // token::LESS_EQUAL
+	operator_precedence::RELATIONAL,   // token::GREATER
+	operator_precedence::RELATIONAL,   // token::GREATER_EQUAL
+	operator_precedence::NO_PRECEDENCE, // token::EQUAL
+	operator_precedence::EQUALITY,     // token::EQUAL_EQUAL
+	operator_precedence::EQUALITY,     // token::EXCLAIM_EQUAL
+	operator_precedence::AND_,         // token::AMP
+	operator_precedence::EXCLUSIVE_OR, // token::CARET
+	operator_precedence::INCLUSIVE_OR, // token::BAR
+	operator_precedence::LOGICAL_AND,  // token::AMP_AMP
+	operator_precedence::LOGICAL_OR,   // token::BAR_BAR
+};
+
 class precedence
 {
 public:
 	precedence() = default;
-	bool is_binary_operator(token tok, operator_precedence &precedence);
+	static constexpr bool is_binary_operator(token_kind kind, operator_precedence& precedence)
+	{
+		if (static_cast<size_t>(kind) >= sizeof(precedence_table) / sizeof(precedence_table[0]) ||
+			kind == token_kind::UNDEFINED)
+		{
+			return false;
+		}
+		precedence = precedence_table[static_cast<size_t>(kind)];
+		return true;
+	}
+	static constexpr bool is_binary_operator(const token& tok, operator_precedence& precedence)
+	{
+		return is_binary_operator(tok.kind, precedence);
+	}
 	static precedence get_instance()
 	{
 		static precedence instance;
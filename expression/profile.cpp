@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <array>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+
+#include "operators.h"
+#include "profile.h"
+
+namespace
+{
+	struct counter
+	{
+		std::uint64_t count;
+		std::uint64_t cycles;
+		std::uint64_t errors;
+	};
+
+	constexpr token_kind binary_kinds[] = {
+#define X(name, member, kind) token_kind::kind,
+		EXPRESSION_BINARY_OPERATIONS(X)
+#undef X
+	};
+	constexpr const char* binary_names[] = {
+#define X(name, member, kind) #member,
+		EXPRESSION_BINARY_OPERATIONS(X)
+#undef X
+	};
+	constexpr token_kind unary_kinds[] = {
+#define X(name, member, kind) token_kind::kind,
+		EXPRESSION_UNARY_OPERATIONS(X)
+#undef X
+	};
+	constexpr const char* unary_names[] = {
+#define X(name, member, kind) #member,
+		EXPRESSION_UNARY_OPERATIONS(X)
+#undef X
+	};
+	constexpr size_t binary_count = std::size(binary_kinds);
+	constexpr size_t unary_count = std::size(unary_kinds);
+
+	// Counters of one thread, indexed by operator and operand types.
+	struct table
+	{
+		std::array<counter, binary_count * value_type_count * value_type_count> binary{};
+		std::array<counter, unary_count * value_type_count> unary{};
+	};
+
+	// Tables outlive their threads, so the counts of finished threads are kept.
+	std::mutex tables_mutex;
+	std::vector<std::unique_ptr<table>> tables;
+
+	table& local_table()
+	{
+		thread_local table* local{ nullptr };
+		if (!local)
+		{
+			std::lock_guard lock{ tables_mutex };
+			local = tables.emplace_back(std::make_unique<table>()).get();
+		}
+		return *local;
+	}
+
+	template <size_t N>
+	size_t find(const token_kind (&kinds)[N], token_kind op)
+	{
+		return static_cast<size_t>(std::find(kinds, kinds + N, op) - kinds);
+	}
+
+	void add(counter& counter, std::uint64_t count, std::uint64_t cycles, std::uint64_t errors)
+	{
+		counter.count += count;
+		counter.cycles += cycles;
+		counter.errors += errors;
+	}
+}
+
+void profile::record_binary(token_kind op, size_t left, size_t right, std::uint64_t count, std::uint64_t cycles,
+	std::uint64_t errors)
+{
+	auto index = find(binary_kinds, op);
+	if (index == binary_count || left >= value_type_count || right >= value_type_count)
+		return;
+	add(local_table().binary[(index * value_type_count + left) * value_type_count + right], count, cycles, errors);
+}
+
+void profile::record_unary(token_kind op, size_t value, std::uint64_t count, std::uint64_t cycles, std::uint64_t errors)
+{
+	auto index = find(unary_kinds, op);
+	if (index == unary_count || value >= value_type_count)
+		return;
+	add(local_table().unary[index * value_type_count + value], count, cycles, errors);
+}
+
+const char* profile::name(const entry& entry)
+{
+	return entry.unary ? unary_names[find(unary_kinds, entry.op)] : binary_names[find(binary_kinds, entry.op)];
+}
+
+std::vector<profile::entry> profile::entries()
+{
+	table total;
+	{
+		std::lock_guard lock{ tables_mutex };
+		for (const auto& table : tables)
+		{
+			for (size_t i = 0; i < total.binary.size(); ++i)
+				add(total.binary[i], table->binary[i].count, table->binary[i].cycles, table->binary[i].errors);
+			for (size_t i = 0; i < total.unary.size(); ++i)
+				add(total.unary[i], table->unary[i].count, table->unary[i].cycles, table->unary[i].errors);
+		}
+	}
+	std::vector<entry> entries;
+	for (size_t i = 0; i < total.binary.size(); ++i)
+	{
+		const auto& counter = total.binary[i];
+		if (counter.count != 0)
+			entries.push_back({ binary_kinds[i / (value_type_count * value_type_count)], false,
+				i / value_type_count % value_type_count, i % value_type_count,
+				counter.count, counter.cycles, counter.errors });
+	}
+	for (size_t i = 0; i < total.unary.size(); ++i)
+	{
+		const auto& counter = total.unary[i];
+		if (counter.count != 0)
+			entries.push_back({ unary_kinds[i / value_type_count], true, i % value_type_count, dynamic_type,
+				counter.count, counter.cycles, counter.errors });
+	}
+	std::stable_sort(entries.begin(), entries.end(), [](const entry& a, const entry& b)
+	{
+		return a.cycles > b.cycles;
+	});
+	return entries;
+}
+
+void profile::write(std::ostream& output)
+{
+	auto entries = profile::entries();
+	auto flags = output.flags();
+	auto precision = output.precision();
+	std::uint64_t count{ 0 }, cycles{ 0 }, errors{ 0 };
+	output << std::left << std::setw(22) << "operator" << std::setw(20) << "left" << std::setw(20) << "right"
+		<< std::right << std::setw(14) << "count" << std::setw(16) << "cycles" << std::setw(12) << "per op"
+		<< std::setw(10) << "errors" << '\n';
+	for (const auto& entry : entries)
+	{
+		output << std::left << std::setw(22) << name(entry) << std::setw(20) << value_type_names[entry.left]
+			<< std::setw(20) << (entry.unary ? "" : value_type_names[entry.right])
+			<< std::right << std::setw(14) << entry.count << std::setw(16) << entry.cycles
+			<< std::setw(12) << std::fixed << std::setprecision(1)
+			<< static_cast<double>(entry.cycles) / static_cast<double>(entry.count)
+			<< std::setw(10) << entry.errors << '\n';
+		count += entry.count;
+		cycles += entry.cycles;
+		errors += entry.errors;
+	}
+	output << std::left << std::setw(62) << "total" << std::right << std::setw(14) << count << std::setw(16) << cycles
+		<< std::setw(12) << (count ? static_cast<double>(cycles) / static_cast<double>(count) : 0.0)
+		<< std::setw(10) << errors << std::endl;
+	output.flags(flags);
+	output.precision(precision);
+}
+
+void profile::reset()
+{
+	std::lock_guard lock{ tables_mutex };
+	for (auto& table : tables)
+		*table = {};
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "token.h"
+
+// Builds with EXPRESSION_PROFILE defined to 1 count the operations the tree,
+// the vm and the batch evaluator execute. Other builds compile the counting
+// out entirely.
+#ifndef EXPRESSION_PROFILE
+#define EXPRESSION_PROFILE 0
+#endif
+
+#if EXPRESSION_PROFILE
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+#endif
+
+// Counters of the operations evaluated, per operator and operand type pair:
+// how many were executed, the cycles they took and the errors they reported.
+// Every thread counts into a table of its own; read and reset them while no
+// evaluation is running.
+class profile
+{
+public:
+	struct entry
+	{
+		token_kind    op;
+		bool          unary;
+		size_t        left;       // type index of the (only) operand
+		size_t        right;      // type index of the right operand of binary operators
+		std::uint64_t count;      // operations, or rows for the batch evaluator
+		std::uint64_t cycles;
+		std::uint64_t errors;     // error() calls
+	};
+	static void record_binary(token_kind op, size_t left, size_t right, std::uint64_t count, std::uint64_t cycles,
+		std::uint64_t errors);
+	static void record_unary(token_kind op, size_t value, std::uint64_t count, std::uint64_t cycles,
+		std::uint64_t errors);
+	// Counters of all threads, the most cycles first, without unused entries.
+	static std::vector<entry> entries();
+	// Name of the operator of an entry, as in operators.h.
+	static const char* name(const entry& entry);
+	// Writes the entries as a table followed by the totals.
+	static void write(std::ostream& output);
+	static void reset();
+	// Time stamp counter, or nanoseconds where there is none.
+	static std::uint64_t cycles()
+	{
+#if EXPRESSION_PROFILE
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+		return __rdtsc();
+#else
+		return static_cast<std::uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+#else
+		return 0;
+#endif
+	}
+};
+
+#if EXPRESSION_PROFILE
+// Records one operation with the cycles from construction to destruction and
+// the errors the evaluator counted meanwhile.
+class profile_timer
+{
+public:
+	profile_timer(token_kind op, size_t left, size_t right, const unsigned int& errors, std::uint64_t count = 1) :
+		_op{ op }, _left{ left }, _right{ right }, _count{ count }, _errors{ errors }, _errors_before{ errors },
+		_start{ profile::cycles() }
+	{}
+	profile_timer(const profile_timer&) = delete;
+	profile_timer& operator=(const profile_timer&) = delete;
+	~profile_timer()
+	{
+		auto cycles = profile::cycles() - _start;
+		if (_right == no_operand)
+			profile::record_unary(_op, _left, _count, cycles, _errors - _errors_before);
+		else
+			profile::record_binary(_op, _left, _right, _count, cycles, _errors - _errors_before);
+	}
+	static constexpr size_t no_operand = ~size_t{ 0 };
+private:
+	token_kind _op;
+	size_t _left;
+	size_t _right;
+	std::uint64_t _count;
+	const unsigned int& _errors;
+	unsigned int _errors_before;
+	std::uint64_t _start;
+};
+
+#define EXPRESSION_PROFILE_BINARY(op, left, right, errors) \
+	profile_timer expression_profile_timer{ op, left, right, errors }
+#define EXPRESSION_PROFILE_UNARY(op, value, errors) \
+	profile_timer expression_profile_timer{ op, value, profile_timer::no_operand, errors }
+#define EXPRESSION_PROFILE_ROWS(op, left, right, errors, rows) \
+	profile_timer expression_profile_timer{ op, left, right, errors, rows }
+#else
+#define EXPRESSION_PROFILE_BINARY(op, left, right, errors)
+#define EXPRESSION_PROFILE_UNARY(op, value, errors)
+#define EXPRESSION_PROFILE_ROWS(op, left, right, errors, rows)
+#endif
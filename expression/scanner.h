@@ -2,21 +2,172 @@
 
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include "lexer.h"
 #include "token.h"
 
 class parser;
 
+// How a source is cut into tokens, one token at a time. scanner uses it, and
+// it is constexpr, so constant evaluation scans sources the same way.
+namespace scanning
+{
+	// Character classes of the C locale.
+	constexpr bool is_space(char ch)
+	{
+		return ch == ' ' || (ch >= '\t' && ch <= '\r');
+	}
+	constexpr bool is_digit(char ch)
+	{
+		return ch >= '0' && ch <= '9';
+	}
+	constexpr bool is_alpha(char ch)
+	{
+		return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z');
+	}
+	constexpr bool is_alnum(char ch)
+	{
+		return is_alpha(ch) || is_digit(ch);
+	}
+
+	// A number literal is scanned as C scans a preprocessing number, up to the
+	// first character that cannot continue one. The parser converts it and
+	// reports an invalid suffix or digit. position is past its first character.
+	constexpr size_t number_literal_end(std::string_view source, size_t position)
+	{
+		while (position < source.size())
+		{
+			auto ch = source[position];
+			auto previous = source[position - 1];
+			auto exponent = previous == 'e' || previous == 'E' || previous == 'p' || previous == 'P';
+			if (is_alnum(ch) || ch == '_' || ch == '.' || ((ch == '+' || ch == '-') && exponent))
+				++position;
+			else
+				break;
+		}
+		return position;
+	}
+
+	// Skips the whitespace at position in source and returns the kind of the
+	// token after it, with start set to where its text begins and position
+	// moved past it.
+	constexpr token_kind next_token(std::string_view source, size_t& position, size_t& start)
+	{
+		while (position < source.size() && is_space(source[position]))
+			++position;
+		start = position;
+		if (position == source.size())
+			return token_kind::END_OF_FILE;
+		auto next_is = [&](char ch)
+		{
+			if (position < source.size() && source[position] == ch)
+			{
+				++position;
+				return true;
+			}
+			return false;
+		};
+		switch (source[position++])
+		{
+		case '*':
+			return token_kind::STAR;
+		case '/':
+			return token_kind::SLASH;
+		case '%':
+			return token_kind::PERCENT;
+		case '+':
+			return token_kind::PLUS;
+		case '-':
+			return token_kind::DASH;
+		case '<':
+			if (next_is('<'))
+				return token_kind::LESS_LESS;
+			if (next_is('='))
+				return token_kind::LESS_EQUAL;
+			return token_kind::LESS;
+		case '>':
+			if (next_is('>'))
+				return token_kind::GREATER_GREATER;
+			if (next_is('='))
+				return token_kind::GREATER_EQUAL;
+			return token_kind::GREATER;
+		case '=':
+			if (next_is('='))
+				return token_kind::EQUAL_EQUAL;
+			return token_kind::EQUAL;
+		case '!':
+			if (next_is('='))
+				return token_kind::EXCLAIM_EQUAL;
+			return token_kind::EXCLAIM;
+		case '&':
+			if (next_is('&'))
+				return token_kind::AMP_AMP;
+			return token_kind::AMP;
+		case '~':
+			return token_kind::TILDE;
+		case '^':
+			return token_kind::CARET;
+		case '|':
+			if (next_is('|'))
+				return token_kind::BAR_BAR;
+			return token_kind::BAR;
+		case '.':
+			if (position < source.size() && is_digit(source[position]))
+			{
+				position = number_literal_end(source, position);
+				return token_kind::NUMBER_LITERAL;
+			}
+			return token_kind::INVALID_CHARACTER;
+		case '?':
+			return token_kind::QUESTION;
+		case ':':
+			return token_kind::COLON;
+		case '(':
+			return token_kind::LPAREN;
+		case ')':
+			return token_kind::RPAREN;
+		default:
+		{
+			auto ch = source[position - 1];
+			if (is_digit(ch))
+			{
+				position = number_literal_end(source, position);
+				return token_kind::NUMBER_LITERAL;
+			}
+			if (is_alpha(ch) || ch == '_')
+			{
+				while (position < source.size() && (is_alnum(source[position]) || source[position] == '_'))
+					++position;
+				return token_kind::IDENTIFIER;
+			}
+			if (ch == '"')
+			{
+				while (position < source.size() && source[position] != '"')
+					++position;
+				if (position < source.size())
+					++position;
+				return token_kind::STRING_LITERAL;
+			}
+			return token_kind::INVALID_CHARACTER;
+		}
+		}
+	}
+}
+
 class scanner
 {
 public:
-	scanner(const parser& parser) : _parser{ parser } 
+	scanner(const parser& parser) : _parser{ &parser }
 	{}
+	// A scanner of its own, to tokenize a source without parsing it.
+	scanner() = default;
 	token next();
-	std::string identifier() const
+	// Text of a token in the source, which the token does not copy.
+	std::string_view text(const token& token) const
 	{
-		return _identifier;
+		return _source.substr(token.offset, token.length);
 	}
 	size_t line() const
 	{
@@ -26,25 +177,23 @@ public:
 	{
 		return _column;
 	}	
-	std::string value() const
-	{
-		return _value;
-	}
-	void set_source(const std::string& source)
-	{
-		_source = source;
-		_source_iter = _source.begin();;
-		_line = 1;
-	}
+	// Scans source without copying it, so it must outlive the scanning. line
+	// is the line number of its first line. Sources of bulk_threshold bytes or
+	// more are lexed in batches of lexemes, which next then hands out; smaller
+	// ones are scanned a token at a time.
+	void set_source(std::string_view source, size_t line = 1);
+	static constexpr size_t bulk_threshold = 4096;
 private:
-	const parser& _parser;
-	std::string _source;
+	const parser* _parser{ nullptr };
+	std::string_view _source;
 	size_t _column{ 1 };
-	std::string::iterator _source_iter;
+	size_t _position{ 0 };
 	size_t _line{ 1 };
 	token _token{ token_kind::END_OF_FILE };
-	std::string _identifier;
-	std::string _value;
-	token scan_number_literal();
+	lexer _lexer;
+	std::vector<lexeme> _lexemes;   // batch of lexemes next hands out
+	size_t _next_lexeme{ 0 };
+	bool _bulk{ false };
+	token scan();
 };
 
@@ -0,0 +1,147 @@
+#include <atomic>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+#include "simd.h"
+
+namespace
+{
+#if EXPRESSION_SIMD_X86
+	void cpuid(int leaf, int subleaf, unsigned int registers[4])
+	{
+#if defined(_MSC_VER)
+		int values[4];
+		__cpuidex(values, leaf, subleaf);
+		for (int i = 0; i < 4; ++i)
+			registers[i] = static_cast<unsigned int>(values[i]);
+#else
+		__cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+	}
+
+	// Register state the operating system saves on context switches.
+	unsigned long long xgetbv()
+	{
+#if defined(_MSC_VER)
+		return _xgetbv(0);
+#else
+		unsigned int eax, edx;
+		__asm__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+		return (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+	}
+#endif
+
+	instruction_set detect()
+	{
+#if EXPRESSION_SIMD_X86
+		unsigned int registers[4];
+		cpuid(0, 0, registers);
+		auto max_leaf = registers[0];
+		if (max_leaf < 1)
+			return instruction_set::SCALAR;
+		cpuid(1, 0, registers);
+		auto sse42 = (registers[2] & (1u << 20)) != 0;
+		auto osxsave = (registers[2] & (1u << 27)) != 0;
+		auto avx = (registers[2] & (1u << 28)) != 0;
+		if (!sse42)
+			return instruction_set::SCALAR;
+		if (!osxsave || !avx || max_leaf < 7)
+			return instruction_set::SSE42;
+		auto xcr0 = xgetbv();
+		if ((xcr0 & 0x6) != 0x6)
+			return instruction_set::SSE42;
+		cpuid(7, 0, registers);
+		auto avx2 = (registers[1] & (1u << 5)) != 0;
+		auto avx512f = (registers[1] & (1u << 16)) != 0;
+		auto avx512dq = (registers[1] & (1u << 17)) != 0;
+		if (!avx2)
+			return instruction_set::SSE42;
+		if (avx512f && avx512dq && (xcr0 & 0xe6) == 0xe6)
+			return instruction_set::AVX512;
+		return instruction_set::AVX2;
+#else
+		return instruction_set::SCALAR;
+#endif
+	}
+
+	const instruction_set detected{ detect() };
+	std::atomic<instruction_set> selected{ detected };
+}
+
+instruction_set simd_instruction_set()
+{
+	return selected.load(std::memory_order_relaxed);
+}
+
+void limit_simd_instruction_set(instruction_set limit)
+{
+	selected.store(limit < detected ? limit : detected, std::memory_order_relaxed);
+}
+
+simd_type simd_type_of(size_t value_type)
+{
+	if (value_type == value_index<int> || (value_type == value_index<long> && sizeof(long) == 4))
+		return simd_type::INT32;
+	if (value_type == value_index<long long> || (value_type == value_index<long> && sizeof(long) == 8))
+		return simd_type::INT64;
+	if (value_type == value_index<float>)
+		return simd_type::FLOAT;
+	if (value_type == value_index<double>)
+		return simd_type::DOUBLE;
+	return simd_type::NONE;
+}
+
+// Use the widest kernel the processor supports, falling back to narrower
+// instruction sets for operations the wider one lacks.
+simd_binary_kernel find_simd_binary_kernel(token_kind op, simd_type type, bool scalar)
+{
+	if (type == simd_type::NONE)
+		return nullptr;
+	simd_binary_kernel kernel{ nullptr };
+#if EXPRESSION_SIMD_X86
+	auto set = simd_instruction_set();
+	if (set >= instruction_set::AVX512)
+		kernel = avx512_binary_kernel(op, type, scalar);
+	if (!kernel && set >= instruction_set::AVX2)
+		kernel = avx2_binary_kernel(op, type, scalar);
+	if (!kernel && set >= instruction_set::SSE42)
+		kernel = sse42_binary_kernel(op, type, scalar);
+#endif
+	return kernel;
+}
+
+simd_unary_kernel find_simd_unary_kernel(token_kind op, simd_type type)
+{
+	if (type == simd_type::NONE)
+		return nullptr;
+	simd_unary_kernel kernel{ nullptr };
+#if EXPRESSION_SIMD_X86
+	auto set = simd_instruction_set();
+	if (set >= instruction_set::AVX512)
+		kernel = avx512_unary_kernel(op, type);
+	if (!kernel && set >= instruction_set::AVX2)
+		kernel = avx2_unary_kernel(op, type);
+	if (!kernel && set >= instruction_set::SSE42)
+		kernel = sse42_unary_kernel(op, type);
+#endif
+	return kernel;
+}
+
+// Byte compares in AVX-512 need AVX-512 BW, which the detection does not
+// require, so AVX-512 processors classify with AVX2.
+simd_classify_kernel find_simd_classify_kernel()
+{
+#if EXPRESSION_SIMD_X86
+	auto set = simd_instruction_set();
+	if (set >= instruction_set::AVX2)
+		return avx2_classify_kernel();
+	if (set >= instruction_set::SSE42)
+		return sse42_classify_kernel();
+#endif
+	return nullptr;
+}
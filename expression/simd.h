@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+
+#include "token.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define EXPRESSION_SIMD_X86 1
+#else
+#define EXPRESSION_SIMD_X86 0
+#endif
+
+enum class instruction_set : unsigned char
+{
+	SCALAR,
+	SSE42,
+	AVX2,
+	AVX512,     // AVX-512 F and DQ
+};
+
+// Operand types the vector kernels handle. Both operands of an instruction
+// must have the same type.
+enum class simd_type : unsigned char
+{
+	NONE,
+	INT32,
+	INT64,
+	FLOAT,
+	DOUBLE,
+};
+
+// A vector kernel processes a prefix of the rows, a multiple of its lane
+// count, and returns how many rows it processed. The scalar batch kernel
+// handles the rest, including rows whose values need an error reported.
+using simd_binary_kernel = size_t (*)(const void* left, const void* right, void* result, size_t count);
+using simd_unary_kernel = size_t (*)(const void* value, void* result, size_t count);
+
+// Bit i of each mask is set if byte i of a 64 byte block is in the class.
+struct character_masks
+{
+	unsigned long long space;   // whitespace, as std::isspace in the C locale
+	unsigned long long word;    // letters, digits and _
+};
+
+// Classifies the 64 bytes at block for the bulk lexer.
+using simd_classify_kernel = void (*)(const char* block, character_masks& masks);
+
+// Instruction set the kernels use, detected with CPUID on first use.
+instruction_set simd_instruction_set();
+// Restricts the kernels to at most the given instruction set, for example to
+// compare results against the scalar kernels. Cannot exceed what was detected.
+void limit_simd_instruction_set(instruction_set limit);
+
+simd_type simd_type_of(size_t value_type);
+// The vector kernel for op with operands of the given type, nullptr if there is
+// none. scalar means the right operand is a single value for all rows.
+simd_binary_kernel find_simd_binary_kernel(token_kind op, simd_type type, bool scalar);
+simd_unary_kernel find_simd_unary_kernel(token_kind op, simd_type type);
+// The widest classification kernel, nullptr if there is no vector kernel.
+simd_classify_kernel find_simd_classify_kernel();
+
+// Kernels of the individual instruction sets, each compiled for its target.
+simd_binary_kernel sse42_binary_kernel(token_kind op, simd_type type, bool scalar);
+simd_unary_kernel sse42_unary_kernel(token_kind op, simd_type type);
+simd_classify_kernel sse42_classify_kernel();
+simd_binary_kernel avx2_binary_kernel(token_kind op, simd_type type, bool scalar);
+simd_unary_kernel avx2_unary_kernel(token_kind op, simd_type type);
+simd_classify_kernel avx2_classify_kernel();
+simd_binary_kernel avx512_binary_kernel(token_kind op, simd_type type, bool scalar);
+simd_unary_kernel avx512_unary_kernel(token_kind op, simd_type type);
@@ -0,0 +1,156 @@
+#include <cstddef>
+#include <cstring>
+
+#include "simd.h"
+
+#if EXPRESSION_SIMD_X86
+
+#include <immintrin.h>
+
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+
+#include "simd_kernels.h"
+
+namespace
+{
+	struct avx2_int32_base
+	{
+		using type = int;
+		using vec = __m256i;
+		static constexpr size_t lanes = 8;
+		static constexpr unsigned long long full = 0xff;
+		static vec load(const type* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+		static void store(type* p, vec v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+		static vec set1(type value) { return _mm256_set1_epi32(value); }
+		static vec zero() { return _mm256_setzero_si256(); }
+		static vec add(vec a, vec b) { return _mm256_add_epi32(a, b); }
+		static vec sub(vec a, vec b) { return _mm256_sub_epi32(a, b); }
+		static vec mul(vec a, vec b) { return _mm256_mullo_epi32(a, b); }
+		static vec bit_and(vec a, vec b) { return _mm256_and_si256(a, b); }
+		static vec bit_or(vec a, vec b) { return _mm256_or_si256(a, b); }
+		static vec bit_xor(vec a, vec b) { return _mm256_xor_si256(a, b); }
+		static vec shl(vec a, vec b) { return _mm256_sllv_epi32(a, b); }
+		static vec shr(vec a, vec b) { return _mm256_srav_epi32(a, b); }
+		static vec neg(vec a) { return _mm256_sub_epi32(_mm256_setzero_si256(), a); }
+		static vec bit_not(vec a) { return _mm256_xor_si256(a, _mm256_set1_epi32(-1)); }
+		static unsigned long long gt(vec a, vec b) { return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(a, b))); }
+		static unsigned long long eq(vec a, vec b) { return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(a, b))); }
+	};
+
+	// AVX2 has no 64 bit multiply or arithmetic right shift.
+	struct avx2_int64_base
+	{
+		using type = long long;
+		using vec = __m256i;
+		static constexpr size_t lanes = 4;
+		static constexpr unsigned long long full = 0xf;
+		static vec load(const type* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+		static void store(type* p, vec v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+		static vec set1(type value) { return _mm256_set1_epi64x(value); }
+		static vec zero() { return _mm256_setzero_si256(); }
+		static vec add(vec a, vec b) { return _mm256_add_epi64(a, b); }
+		static vec sub(vec a, vec b) { return _mm256_sub_epi64(a, b); }
+		static vec bit_and(vec a, vec b) { return _mm256_and_si256(a, b); }
+		static vec bit_or(vec a, vec b) { return _mm256_or_si256(a, b); }
+		static vec bit_xor(vec a, vec b) { return _mm256_xor_si256(a, b); }
+		static vec shl(vec a, vec b) { return _mm256_sllv_epi64(a, b); }
+		static vec neg(vec a) { return _mm256_sub_epi64(_mm256_setzero_si256(), a); }
+		static vec bit_not(vec a) { return _mm256_xor_si256(a, _mm256_set1_epi32(-1)); }
+		static unsigned long long gt(vec a, vec b) { return _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(a, b))); }
+		static unsigned long long eq(vec a, vec b) { return _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(a, b))); }
+	};
+
+	using avx2_int32 = integer_comparisons<avx2_int32_base>;
+	using avx2_int64 = integer_comparisons<avx2_int64_base>;
+
+	struct avx2_float
+	{
+		using type = float;
+		using vec = __m256;
+		static constexpr size_t lanes = 8;
+		static constexpr unsigned long long full = 0xff;
+		static vec load(const type* p) { return _mm256_loadu_ps(p); }
+		static void store(type* p, vec v) { _mm256_storeu_ps(p, v); }
+		static vec set1(type value) { return _mm256_set1_ps(value); }
+		static vec zero() { return _mm256_setzero_ps(); }
+		static vec add(vec a, vec b) { return _mm256_add_ps(a, b); }
+		static vec sub(vec a, vec b) { return _mm256_sub_ps(a, b); }
+		static vec mul(vec a, vec b) { return _mm256_mul_ps(a, b); }
+		static vec div(vec a, vec b) { return _mm256_div_ps(a, b); }
+		static vec neg(vec a) { return _mm256_xor_ps(a, _mm256_set1_ps(-0.0f)); }
+		static unsigned long long lt(vec a, vec b) { return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LT_OQ)); }
+		static unsigned long long le(vec a, vec b) { return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LE_OQ)); }
+		static unsigned long long gt(vec a, vec b) { return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GT_OQ)); }
+		static unsigned long long ge(vec a, vec b) { return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GE_OQ)); }
+		static unsigned long long eq(vec a, vec b) { return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_EQ_OQ)); }
+		static unsigned long long ne(vec a, vec b) { return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_NEQ_UQ)); }
+	};
+
+	struct avx2_double
+	{
+		using type = double;
+		using vec = __m256d;
+		static constexpr size_t lanes = 4;
+		static constexpr unsigned long long full = 0xf;
+		static vec load(const type* p) { return _mm256_loadu_pd(p); }
+		static void store(type* p, vec v) { _mm256_storeu_pd(p, v); }
+		static vec set1(type value) { return _mm256_set1_pd(value); }
+		static vec zero() { return _mm256_setzero_pd(); }
+		static vec add(vec a, vec b) { return _mm256_add_pd(a, b); }
+		static vec sub(vec a, vec b) { return _mm256_sub_pd(a, b); }
+		static vec mul(vec a, vec b) { return _mm256_mul_pd(a, b); }
+		static vec div(vec a, vec b) { return _mm256_div_pd(a, b); }
+		static vec neg(vec a) { return _mm256_xor_pd(a, _mm256_set1_pd(-0.0)); }
+		static unsigned long long lt(vec a, vec b) { return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_LT_OQ)); }
+		static unsigned long long le(vec a, vec b) { return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_LE_OQ)); }
+		static unsigned long long gt(vec a, vec b) { return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_GT_OQ)); }
+		static unsigned long long ge(vec a, vec b) { return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_GE_OQ)); }
+		static unsigned long long eq(vec a, vec b) { return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_EQ_OQ)); }
+		static unsigned long long ne(vec a, vec b) { return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_NEQ_UQ)); }
+	};
+	// Classifies 32 bytes at a time, as sse42_classify does with 16.
+	void avx2_classify(const char* block, character_masks& masks)
+	{
+		masks = {};
+		for (size_t offset = 0; offset < 64; offset += 32)
+		{
+			auto bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + offset));
+			auto lower = _mm256_or_si256(bytes, _mm256_set1_epi8(0x20));
+			auto digit = _mm256_and_si256(_mm256_cmpgt_epi8(bytes, _mm256_set1_epi8('0' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), bytes));
+			auto letter = _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), lower));
+			auto word = _mm256_or_si256(_mm256_or_si256(digit, letter), _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('_')));
+			auto control = _mm256_and_si256(_mm256_cmpgt_epi8(bytes, _mm256_set1_epi8('\t' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('\r' + 1), bytes));
+			auto space = _mm256_or_si256(control, _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(' ')));
+			masks.space |= static_cast<unsigned long long>(static_cast<unsigned int>(_mm256_movemask_epi8(space))) << offset;
+			masks.word |= static_cast<unsigned long long>(static_cast<unsigned int>(_mm256_movemask_epi8(word))) << offset;
+		}
+	}
+}
+
+simd_binary_kernel avx2_binary_kernel(token_kind op, simd_type type, bool scalar)
+{
+	return binary_kernel<avx2_int32, avx2_int64, avx2_float, avx2_double>(op, type, scalar);
+}
+
+simd_unary_kernel avx2_unary_kernel(token_kind op, simd_type type)
+{
+	return unary_kernel<avx2_int32, avx2_int64, avx2_float, avx2_double>(op, type);
+}
+
+simd_classify_kernel avx2_classify_kernel()
+{
+	return avx2_classify;
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#endif
@@ -0,0 +1,140 @@
+#include <cstddef>
+#include <cstring>
+
+#include "simd.h"
+
+#if EXPRESSION_SIMD_X86
+
+#include <immintrin.h>
+
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx512f,avx512dq"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx512dq")
+#endif
+
+#include "simd_kernels.h"
+
+namespace
+{
+	struct avx512_int32
+	{
+		using type = int;
+		using vec = __m512i;
+		static constexpr size_t lanes = 16;
+		static constexpr unsigned long long full = 0xffff;
+		static vec load(const type* p) { return _mm512_loadu_si512(p); }
+		static void store(type* p, vec v) { _mm512_storeu_si512(p, v); }
+		static vec set1(type value) { return _mm512_set1_epi32(value); }
+		static vec zero() { return _mm512_setzero_si512(); }
+		static vec add(vec a, vec b) { return _mm512_add_epi32(a, b); }
+		static vec sub(vec a, vec b) { return _mm512_sub_epi32(a, b); }
+		static vec mul(vec a, vec b) { return _mm512_mullo_epi32(a, b); }
+		static vec bit_and(vec a, vec b) { return _mm512_and_si512(a, b); }
+		static vec bit_or(vec a, vec b) { return _mm512_or_si512(a, b); }
+		static vec bit_xor(vec a, vec b) { return _mm512_xor_si512(a, b); }
+		static vec shl(vec a, vec b) { return _mm512_sllv_epi32(a, b); }
+		static vec shr(vec a, vec b) { return _mm512_srav_epi32(a, b); }
+		static vec neg(vec a) { return _mm512_sub_epi32(_mm512_setzero_si512(), a); }
+		static vec bit_not(vec a) { return _mm512_xor_si512(a, _mm512_set1_epi32(-1)); }
+		static unsigned long long lt(vec a, vec b) { return _mm512_cmp_epi32_mask(a, b, _MM_CMPINT_LT); }
+		static unsigned long long le(vec a, vec b) { return _mm512_cmp_epi32_mask(a, b, _MM_CMPINT_LE); }
+		static unsigned long long gt(vec a, vec b) { return _mm512_cmp_epi32_mask(a, b, _MM_CMPINT_NLE); }
+		static unsigned long long ge(vec a, vec b) { return _mm512_cmp_epi32_mask(a, b, _MM_CMPINT_NLT); }
+		static unsigned long long eq(vec a, vec b) { return _mm512_cmp_epi32_mask(a, b, _MM_CMPINT_EQ); }
+		static unsigned long long ne(vec a, vec b) { return _mm512_cmp_epi32_mask(a, b, _MM_CMPINT_NE); }
+	};
+
+	struct avx512_int64
+	{
+		using type = long long;
+		using vec = __m512i;
+		static constexpr size_t lanes = 8;
+		static constexpr unsigned long long full = 0xff;
+		static vec load(const type* p) { return _mm512_loadu_si512(p); }
+		static void store(type* p, vec v) { _mm512_storeu_si512(p, v); }
+		static vec set1(type value) { return _mm512_set1_epi64(value); }
+		static vec zero() { return _mm512_setzero_si512(); }
+		static vec add(vec a, vec b) { return _mm512_add_epi64(a, b); }
+		static vec sub(vec a, vec b) { return _mm512_sub_epi64(a, b); }
+		static vec mul(vec a, vec b) { return _mm512_mullo_epi64(a, b); }
+		static vec bit_and(vec a, vec b) { return _mm512_and_si512(a, b); }
+		static vec bit_or(vec a, vec b) { return _mm512_or_si512(a, b); }
+		static vec bit_xor(vec a, vec b) { return _mm512_xor_si512(a, b); }
+		static vec shl(vec a, vec b) { return _mm512_sllv_epi64(a, b); }
+		static vec shr(vec a, vec b) { return _mm512_srav_epi64(a, b); }
+		static vec neg(vec a) { return _mm512_sub_epi64(_mm512_setzero_si512(), a); }
+		static vec bit_not(vec a) { return _mm512_xor_si512(a, _mm512_set1_epi32(-1)); }
+		static unsigned long long lt(vec a, vec b) { return _mm512_cmp_epi64_mask(a, b, _MM_CMPINT_LT); }
+		static unsigned long long le(vec a, vec b) { return _mm512_cmp_epi64_mask(a, b, _MM_CMPINT_LE); }
+		static unsigned long long gt(vec a, vec b) { return _mm512_cmp_epi64_mask(a, b, _MM_CMPINT_NLE); }
+		static unsigned long long ge(vec a, vec b) { return _mm512_cmp_epi64_mask(a, b, _MM_CMPINT_NLT); }
+		static unsigned long long eq(vec a, vec b) { return _mm512_cmp_epi64_mask(a, b, _MM_CMPINT_EQ); }
+		static unsigned long long ne(vec a, vec b) { return _mm512_cmp_epi64_mask(a, b, _MM_CMPINT_NE); }
+	};
+
+	struct avx512_float
+	{
+		using type = float;
+		using vec = __m512;
+		static constexpr size_t lanes = 16;
+		static constexpr unsigned long long full = 0xffff;
+		static vec load(const type* p) { return _mm512_loadu_ps(p); }
+		static void store(type* p, vec v) { _mm512_storeu_ps(p, v); }
+		static vec set1(type value) { return _mm512_set1_ps(value); }
+		static vec zero() { return _mm512_setzero_ps(); }
+		static vec add(vec a, vec b) { return _mm512_add_ps(a, b); }
+		static vec sub(vec a, vec b) { return _mm512_sub_ps(a, b); }
+		static vec mul(vec a, vec b) { return _mm512_mul_ps(a, b); }
+		static vec div(vec a, vec b) { return _mm512_div_ps(a, b); }
+		static vec neg(vec a) { return _mm512_xor_ps(a, _mm512_set1_ps(-0.0f)); }
+		static unsigned long long lt(vec a, vec b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+		static unsigned long long le(vec a, vec b) { return _mm512_cmp_ps_mask(a, b, _CMP_LE_OQ); }
+		static unsigned long long gt(vec a, vec b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+		static unsigned long long ge(vec a, vec b) { return _mm512_cmp_ps_mask(a, b, _CMP_GE_OQ); }
+		static unsigned long long eq(vec a, vec b) { return _mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ); }
+		static unsigned long long ne(vec a, vec b) { return _mm512_cmp_ps_mask(a, b, _CMP_NEQ_UQ); }
+	};
+
+	struct avx512_double
+	{
+		using type = double;
+		using vec = __m512d;
+		static constexpr size_t lanes = 8;
+		static constexpr unsigned long long full = 0xff;
+		static vec load(const type* p) { return _mm512_loadu_pd(p); }
+		static void store(type* p, vec v) { _mm512_storeu_pd(p, v); }
+		static vec set1(type value) { return _mm512_set1_pd(value); }
+		static vec zero() { return _mm512_setzero_pd(); }
+		static vec add(vec a, vec b) { return _mm512_add_pd(a, b); }
+		static vec sub(vec a, vec b) { return _mm512_sub_pd(a, b); }
+		static vec mul(vec a, vec b) { return _mm512_mul_pd(a, b); }
+		static vec div(vec a, vec b) { return _mm512_div_pd(a, b); }
+		static vec neg(vec a) { return _mm512_xor_pd(a, _mm512_set1_pd(-0.0)); }
+		static unsigned long long lt(vec a, vec b) { return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ); }
+		static unsigned long long le(vec a, vec b) { return _mm512_cmp_pd_mask(a, b, _CMP_LE_OQ); }
+		static unsigned long long gt(vec a, vec b) { return _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ); }
+		static unsigned long long ge(vec a, vec b) { return _mm512_cmp_pd_mask(a, b, _CMP_GE_OQ); }
+		static unsigned long long eq(vec a, vec b) { return _mm512_cmp_pd_mask(a, b, _CMP_EQ_OQ); }
+		static unsigned long long ne(vec a, vec b) { return _mm512_cmp_pd_mask(a, b, _CMP_NEQ_UQ); }
+	};
+}
+
+simd_binary_kernel avx512_binary_kernel(token_kind op, simd_type type, bool scalar)
+{
+	return binary_kernel<avx512_int32, avx512_int64, avx512_float, avx512_double>(op, type, scalar);
+}
+
+simd_unary_kernel avx512_unary_kernel(token_kind op, simd_type type)
+{
+	return unary_kernel<avx512_int32, avx512_int64, avx512_float, avx512_double>(op, type);
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#endif
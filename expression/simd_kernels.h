@@ -0,0 +1,360 @@
+#pragma once
+
+// Vector kernels written once against a traits type per operand type. Only
+// the simd_<instruction set>.cpp files include this header, after selecting
+// their compilation target, and supply the traits. Everything here has
+// internal linkage so the linker can never pick code compiled for one
+// instruction set where another one is expected.
+//
+// A traits type V provides type, vec, lanes, full (the mask with one bit per
+// lane), load, store, set1, zero and the comparisons lt, le, gt, ge, eq and ne
+// returning one bit per lane. add, sub, mul, div, bit_and, bit_or, bit_xor,
+// shl, shr, neg and bit_not are optional; operators whose member is missing
+// have no kernel for that traits type.
+
+#include <cstddef>
+#include <cstring>
+
+#include "simd.h"
+
+namespace
+{
+	// The bytes of a bool for each bit of an 8 bit lane mask.
+	struct mask_table
+	{
+		unsigned long long bytes[256];
+		constexpr mask_table() : bytes{}
+		{
+			for (unsigned int mask = 0; mask < 256; ++mask)
+			{
+				for (unsigned int bit = 0; bit < 8; ++bit)
+				{
+					if (mask & (1u << bit))
+						bytes[mask] |= 1ull << (bit * 8);
+				}
+			}
+		}
+	};
+
+	constexpr mask_table mask_bytes;
+
+	inline void store_mask(bool* result, unsigned long long mask, size_t lanes)
+	{
+		for (size_t lane = 0; lane < lanes; lane += 8)
+		{
+			auto bytes = mask_bytes.bytes[(mask >> lane) & 0xff];
+			std::memcpy(result + lane, &bytes, lanes - lane < 8 ? lanes - lane : 8);
+		}
+	}
+
+	// Derives lt, le, ge and ne of an integer traits type from its gt and eq.
+	template <typename V>
+	struct integer_comparisons : V
+	{
+		using vec = typename V::vec;
+		static unsigned long long lt(vec a, vec b)
+		{
+			return V::gt(b, a);
+		}
+		static unsigned long long le(vec a, vec b)
+		{
+			return V::full & ~V::gt(a, b);
+		}
+		static unsigned long long ge(vec a, vec b)
+		{
+			return V::full & ~V::gt(b, a);
+		}
+		static unsigned long long ne(vec a, vec b)
+		{
+			return V::full & ~V::eq(a, b);
+		}
+	};
+
+#define EXPRESSION_SIMD_OPERATION(name, member) \
+	struct name \
+	{ \
+		template <typename V> \
+		static constexpr bool available = requires(typename V::vec a) { V::member(a, a); }; \
+		template <typename V> \
+		static auto apply(typename V::vec a, typename V::vec b) \
+		{ \
+			return V::member(a, b); \
+		} \
+	};
+
+	EXPRESSION_SIMD_OPERATION(simd_add, add)
+	EXPRESSION_SIMD_OPERATION(simd_subtract, sub)
+	EXPRESSION_SIMD_OPERATION(simd_multiply, mul)
+	EXPRESSION_SIMD_OPERATION(simd_divide, div)
+	EXPRESSION_SIMD_OPERATION(simd_bitwise_and, bit_and)
+	EXPRESSION_SIMD_OPERATION(simd_bitwise_or, bit_or)
+	EXPRESSION_SIMD_OPERATION(simd_bitwise_exclusive_or, bit_xor)
+	EXPRESSION_SIMD_OPERATION(simd_left_shift, shl)
+	EXPRESSION_SIMD_OPERATION(simd_right_shift, shr)
+	EXPRESSION_SIMD_OPERATION(simd_less, lt)
+	EXPRESSION_SIMD_OPERATION(simd_less_equal, le)
+	EXPRESSION_SIMD_OPERATION(simd_greater, gt)
+	EXPRESSION_SIMD_OPERATION(simd_greater_equal, ge)
+	EXPRESSION_SIMD_OPERATION(simd_equal, eq)
+	EXPRESSION_SIMD_OPERATION(simd_not_equal, ne)
+#undef EXPRESSION_SIMD_OPERATION
+
+	// Logical operators are only defined for int, so they need an integer type.
+	struct simd_logical_and
+	{
+		template <typename V>
+		static constexpr bool available = requires(typename V::vec a) { V::bit_and(a, a); };
+		template <typename V>
+		static unsigned long long apply(typename V::vec a, typename V::vec b)
+		{
+			auto zero = V::zero();
+			return V::full & ~V::eq(a, zero) & ~V::eq(b, zero);
+		}
+	};
+
+	struct simd_logical_or
+	{
+		template <typename V>
+		static constexpr bool available = requires(typename V::vec a) { V::bit_and(a, a); };
+		template <typename V>
+		static unsigned long long apply(typename V::vec a, typename V::vec b)
+		{
+			auto zero = V::zero();
+			return V::full & ~(V::eq(a, zero) & V::eq(b, zero));
+		}
+	};
+
+	template <typename V, typename operation, bool scalar>
+	struct arithmetic_kernel
+	{
+		static size_t run(const void* left, const void* right, void* result, size_t count)
+		{
+			using T = typename V::type;
+			auto a = static_cast<const T*>(left);
+			auto b = static_cast<const T*>(right);
+			auto r = static_cast<T*>(result);
+			size_t i{ 0 };
+			if constexpr (scalar)
+			{
+				auto vb = V::set1(b[0]);
+				for (; i + V::lanes <= count; i += V::lanes)
+					V::store(r + i, operation::template apply<V>(V::load(a + i), vb));
+			}
+			else
+			{
+				for (; i + V::lanes <= count; i += V::lanes)
+					V::store(r + i, operation::template apply<V>(V::load(a + i), V::load(b + i)));
+			}
+			return i;
+		}
+	};
+
+	// Shifts stop before the first vector with a count that is negative or not
+	// less than the operand width and leave it, and the error, to the scalar
+	// kernel, so every lane shifted has a count the scalar shift accepts.
+	template <typename V, typename operation, bool scalar>
+	struct shift_kernel
+	{
+		static size_t run(const void* left, const void* right, void* result, size_t count)
+		{
+			using T = typename V::type;
+			auto a = static_cast<const T*>(left);
+			auto b = static_cast<const T*>(right);
+			auto r = static_cast<T*>(result);
+			constexpr auto width = static_cast<T>(sizeof(T) * 8);
+			size_t i{ 0 };
+			if constexpr (scalar)
+			{
+				if (b[0] < 0 || b[0] >= width)
+					return 0;
+				auto vb = V::set1(b[0]);
+				for (; i + V::lanes <= count; i += V::lanes)
+					V::store(r + i, operation::template apply<V>(V::load(a + i), vb));
+			}
+			else
+			{
+				auto zero = V::zero();
+				auto last = V::set1(static_cast<T>(width - 1));
+				for (; i + V::lanes <= count; i += V::lanes)
+				{
+					auto vb = V::load(b + i);
+					if (V::lt(vb, zero) || V::gt(vb, last))
+						break;
+					V::store(r + i, operation::template apply<V>(V::load(a + i), vb));
+				}
+			}
+			return i;
+		}
+	};
+
+	template <typename V, typename operation, bool scalar>
+	struct compare_kernel
+	{
+		static size_t run(const void* left, const void* right, void* result, size_t count)
+		{
+			using T = typename V::type;
+			auto a = static_cast<const T*>(left);
+			auto b = static_cast<const T*>(right);
+			auto r = static_cast<bool*>(result);
+			size_t i{ 0 };
+			if constexpr (scalar)
+			{
+				auto vb = V::set1(b[0]);
+				for (; i + V::lanes <= count; i += V::lanes)
+					store_mask(r + i, operation::template apply<V>(V::load(a + i), vb), V::lanes);
+			}
+			else
+			{
+				for (; i + V::lanes <= count; i += V::lanes)
+					store_mask(r + i, operation::template apply<V>(V::load(a + i), V::load(b + i)), V::lanes);
+			}
+			return i;
+		}
+	};
+
+	template <typename V>
+	size_t negate_kernel(const void* value, void* result, size_t count)
+	{
+		using T = typename V::type;
+		auto a = static_cast<const T*>(value);
+		auto r = static_cast<T*>(result);
+		size_t i{ 0 };
+		for (; i + V::lanes <= count; i += V::lanes)
+			V::store(r + i, V::neg(V::load(a + i)));
+		return i;
+	}
+
+	template <typename V>
+	size_t bitwise_not_kernel(const void* value, void* result, size_t count)
+	{
+		using T = typename V::type;
+		auto a = static_cast<const T*>(value);
+		auto r = static_cast<T*>(result);
+		size_t i{ 0 };
+		for (; i + V::lanes <= count; i += V::lanes)
+			V::store(r + i, V::bit_not(V::load(a + i)));
+		return i;
+	}
+
+	template <typename V>
+	size_t not_kernel(const void* value, void* result, size_t count)
+	{
+		using T = typename V::type;
+		auto a = static_cast<const T*>(value);
+		auto r = static_cast<bool*>(result);
+		auto zero = V::zero();
+		size_t i{ 0 };
+		for (; i + V::lanes <= count; i += V::lanes)
+			store_mask(r + i, V::eq(V::load(a + i), zero), V::lanes);
+		return i;
+	}
+
+	template <typename V, typename operation, template <typename, typename, bool> typename kernel>
+	simd_binary_kernel select(bool scalar)
+	{
+		if constexpr (operation::template available<V>)
+			return scalar ? &kernel<V, operation, true>::run : &kernel<V, operation, false>::run;
+		else
+			return nullptr;
+	}
+
+	template <typename V>
+	simd_binary_kernel binary_kernel(token_kind op, bool scalar)
+	{
+		switch (op)
+		{
+		case token_kind::PLUS:
+			return select<V, simd_add, arithmetic_kernel>(scalar);
+		case token_kind::DASH:
+			return select<V, simd_subtract, arithmetic_kernel>(scalar);
+		case token_kind::STAR:
+			return select<V, simd_multiply, arithmetic_kernel>(scalar);
+		case token_kind::SLASH:
+			return select<V, simd_divide, arithmetic_kernel>(scalar);
+		case token_kind::AMP:
+			return select<V, simd_bitwise_and, arithmetic_kernel>(scalar);
+		case token_kind::BAR:
+			return select<V, simd_bitwise_or, arithmetic_kernel>(scalar);
+		case token_kind::CARET:
+			return select<V, simd_bitwise_exclusive_or, arithmetic_kernel>(scalar);
+		case token_kind::LESS_LESS:
+			return select<V, simd_left_shift, shift_kernel>(scalar);
+		case token_kind::GREATER_GREATER:
+			return select<V, simd_right_shift, shift_kernel>(scalar);
+		case token_kind::LESS:
+			return select<V, simd_less, compare_kernel>(scalar);
+		case token_kind::LESS_EQUAL:
+			return select<V, simd_less_equal, compare_kernel>(scalar);
+		case token_kind::GREATER:
+			return select<V, simd_greater, compare_kernel>(scalar);
+		case token_kind::GREATER_EQUAL:
+			return select<V, simd_greater_equal, compare_kernel>(scalar);
+		case token_kind::EQUAL_EQUAL:
+			return select<V, simd_equal, compare_kernel>(scalar);
+		case token_kind::EXCLAIM_EQUAL:
+			return select<V, simd_not_equal, compare_kernel>(scalar);
+		case token_kind::AMP_AMP:
+			return select<V, simd_logical_and, compare_kernel>(scalar);
+		case token_kind::BAR_BAR:
+			return select<V, simd_logical_or, compare_kernel>(scalar);
+		default:
+			return nullptr;
+		}
+	}
+
+	template <typename V>
+	simd_unary_kernel unary_kernel(token_kind op)
+	{
+		switch (op)
+		{
+		case token_kind::DASH:
+			if constexpr (requires(typename V::vec a) { V::neg(a); })
+				return &negate_kernel<V>;
+			return nullptr;
+		case token_kind::TILDE:
+			if constexpr (requires(typename V::vec a) { V::bit_not(a); })
+				return &bitwise_not_kernel<V>;
+			return nullptr;
+		case token_kind::EXCLAIM:
+			return &not_kernel<V>;
+		default:
+			return nullptr;
+		}
+	}
+
+	template <typename int32, typename int64, typename float32, typename float64>
+	simd_binary_kernel binary_kernel(token_kind op, simd_type type, bool scalar)
+	{
+		switch (type)
+		{
+		case simd_type::INT32:
+			return binary_kernel<int32>(op, scalar);
+		case simd_type::INT64:
+			return binary_kernel<int64>(op, scalar);
+		case simd_type::FLOAT:
+			return binary_kernel<float32>(op, scalar);
+		case simd_type::DOUBLE:
+			return binary_kernel<float64>(op, scalar);
+		default:
+			return nullptr;
+		}
+	}
+
+	template <typename int32, typename int64, typename float32, typename float64>
+	simd_unary_kernel unary_kernel(token_kind op, simd_type type)
+	{
+		switch (type)
+		{
+		case simd_type::INT32:
+			return unary_kernel<int32>(op);
+		case simd_type::INT64:
+			return unary_kernel<int64>(op);
+		case simd_type::FLOAT:
+			return unary_kernel<float32>(op);
+		case simd_type::DOUBLE:
+			return unary_kernel<float64>(op);
+		default:
+			return nullptr;
+		}
+	}
+}
@@ -0,0 +1,153 @@
+#include <cstddef>
+#include <cstring>
+
+#include "simd.h"
+
+#if EXPRESSION_SIMD_X86
+
+#include <immintrin.h>
+
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("sse4.2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("sse4.2")
+#endif
+
+#include "simd_kernels.h"
+
+namespace
+{
+	struct sse42_int32_base
+	{
+		using type = int;
+		using vec = __m128i;
+		static constexpr size_t lanes = 4;
+		static constexpr unsigned long long full = 0xf;
+		static vec load(const type* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+		static void store(type* p, vec v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+		static vec set1(type value) { return _mm_set1_epi32(value); }
+		static vec zero() { return _mm_setzero_si128(); }
+		static vec add(vec a, vec b) { return _mm_add_epi32(a, b); }
+		static vec sub(vec a, vec b) { return _mm_sub_epi32(a, b); }
+		static vec mul(vec a, vec b) { return _mm_mullo_epi32(a, b); }
+		static vec bit_and(vec a, vec b) { return _mm_and_si128(a, b); }
+		static vec bit_or(vec a, vec b) { return _mm_or_si128(a, b); }
+		static vec bit_xor(vec a, vec b) { return _mm_xor_si128(a, b); }
+		static vec neg(vec a) { return _mm_sub_epi32(_mm_setzero_si128(), a); }
+		static vec bit_not(vec a) { return _mm_xor_si128(a, _mm_set1_epi32(-1)); }
+		static unsigned long long gt(vec a, vec b) { return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(a, b))); }
+		static unsigned long long eq(vec a, vec b) { return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(a, b))); }
+	};
+
+	struct sse42_int64_base
+	{
+		using type = long long;
+		using vec = __m128i;
+		static constexpr size_t lanes = 2;
+		static constexpr unsigned long long full = 0x3;
+		static vec load(const type* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+		static void store(type* p, vec v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+		static vec set1(type value) { return _mm_set1_epi64x(value); }
+		static vec zero() { return _mm_setzero_si128(); }
+		static vec add(vec a, vec b) { return _mm_add_epi64(a, b); }
+		static vec sub(vec a, vec b) { return _mm_sub_epi64(a, b); }
+		static vec bit_and(vec a, vec b) { return _mm_and_si128(a, b); }
+		static vec bit_or(vec a, vec b) { return _mm_or_si128(a, b); }
+		static vec bit_xor(vec a, vec b) { return _mm_xor_si128(a, b); }
+		static vec neg(vec a) { return _mm_sub_epi64(_mm_setzero_si128(), a); }
+		static vec bit_not(vec a) { return _mm_xor_si128(a, _mm_set1_epi32(-1)); }
+		static unsigned long long gt(vec a, vec b) { return _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(a, b))); }
+		static unsigned long long eq(vec a, vec b) { return _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpeq_epi64(a, b))); }
+	};
+
+	using sse42_int32 = integer_comparisons<sse42_int32_base>;
+	using sse42_int64 = integer_comparisons<sse42_int64_base>;
+
+	struct sse42_float
+	{
+		using type = float;
+		using vec = __m128;
+		static constexpr size_t lanes = 4;
+		static constexpr unsigned long long full = 0xf;
+		static vec load(const type* p) { return _mm_loadu_ps(p); }
+		static void store(type* p, vec v) { _mm_storeu_ps(p, v); }
+		static vec set1(type value) { return _mm_set1_ps(value); }
+		static vec zero() { return _mm_setzero_ps(); }
+		static vec add(vec a, vec b) { return _mm_add_ps(a, b); }
+		static vec sub(vec a, vec b) { return _mm_sub_ps(a, b); }
+		static vec mul(vec a, vec b) { return _mm_mul_ps(a, b); }
+		static vec div(vec a, vec b) { return _mm_div_ps(a, b); }
+		static vec neg(vec a) { return _mm_xor_ps(a, _mm_set1_ps(-0.0f)); }
+		static unsigned long long lt(vec a, vec b) { return _mm_movemask_ps(_mm_cmplt_ps(a, b)); }
+		static unsigned long long le(vec a, vec b) { return _mm_movemask_ps(_mm_cmple_ps(a, b)); }
+		static unsigned long long gt(vec a, vec b) { return _mm_movemask_ps(_mm_cmpgt_ps(a, b)); }
+		static unsigned long long ge(vec a, vec b) { return _mm_movemask_ps(_mm_cmpge_ps(a, b)); }
+		static unsigned long long eq(vec a, vec b) { return _mm_movemask_ps(_mm_cmpeq_ps(a, b)); }
+		static unsigned long long ne(vec a, vec b) { return _mm_movemask_ps(_mm_cmpneq_ps(a, b)); }
+	};
+
+	struct sse42_double
+	{
+		using type = double;
+		using vec = __m128d;
+		static constexpr size_t lanes = 2;
+		static constexpr unsigned long long full = 0x3;
+		static vec load(const type* p) { return _mm_loadu_pd(p); }
+		static void store(type* p, vec v) { _mm_storeu_pd(p, v); }
+		static vec set1(type value) { return _mm_set1_pd(value); }
+		static vec zero() { return _mm_setzero_pd(); }
+		static vec add(vec a, vec b) { return _mm_add_pd(a, b); }
+		static vec sub(vec a, vec b) { return _mm_sub_pd(a, b); }
+		static vec mul(vec a, vec b) { return _mm_mul_pd(a, b); }
+		static vec div(vec a, vec b) { return _mm_div_pd(a, b); }
+		static vec neg(vec a) { return _mm_xor_pd(a, _mm_set1_pd(-0.0)); }
+		static unsigned long long lt(vec a, vec b) { return _mm_movemask_pd(_mm_cmplt_pd(a, b)); }
+		static unsigned long long le(vec a, vec b) { return _mm_movemask_pd(_mm_cmple_pd(a, b)); }
+		static unsigned long long gt(vec a, vec b) { return _mm_movemask_pd(_mm_cmpgt_pd(a, b)); }
+		static unsigned long long ge(vec a, vec b) { return _mm_movemask_pd(_mm_cmpge_pd(a, b)); }
+		static unsigned long long eq(vec a, vec b) { return _mm_movemask_pd(_mm_cmpeq_pd(a, b)); }
+		static unsigned long long ne(vec a, vec b) { return _mm_movemask_pd(_mm_cmpneq_pd(a, b)); }
+	};
+	// Classifies 16 bytes at a time. SSE has no unsigned byte compares, but the
+	// classes are all ASCII and bytes above 127 compare as negative.
+	void sse42_classify(const char* block, character_masks& masks)
+	{
+		masks = {};
+		for (size_t offset = 0; offset < 64; offset += 16)
+		{
+			auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + offset));
+			auto lower = _mm_or_si128(bytes, _mm_set1_epi8(0x20));
+			auto digit = _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(bytes, _mm_set1_epi8('9' + 1)));
+			auto letter = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1)));
+			auto word = _mm_or_si128(_mm_or_si128(digit, letter), _mm_cmpeq_epi8(bytes, _mm_set1_epi8('_')));
+			auto control = _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8('\t' - 1)), _mm_cmplt_epi8(bytes, _mm_set1_epi8('\r' + 1)));
+			auto space = _mm_or_si128(control, _mm_cmpeq_epi8(bytes, _mm_set1_epi8(' ')));
+			masks.space |= static_cast<unsigned long long>(static_cast<unsigned int>(_mm_movemask_epi8(space))) << offset;
+			masks.word |= static_cast<unsigned long long>(static_cast<unsigned int>(_mm_movemask_epi8(word))) << offset;
+		}
+	}
+}
+
+simd_binary_kernel sse42_binary_kernel(token_kind op, simd_type type, bool scalar)
+{
+	return binary_kernel<sse42_int32, sse42_int64, sse42_float, sse42_double>(op, type, scalar);
+}
+
+simd_unary_kernel sse42_unary_kernel(token_kind op, simd_type type)
+{
+	return unary_kernel<sse42_int32, sse42_int64, sse42_float, sse42_double>(op, type);
+}
+
+simd_classify_kernel sse42_classify_kernel()
+{
+	return sse42_classify;
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#endif
@@ -0,0 +1,119 @@
+#include <algorithm>
+
+#include "thread_pool.h"
+
+thread_pool::thread_pool(unsigned int threads)
+{
+	if (threads == 0)
+		threads = std::thread::hardware_concurrency();
+	if (threads == 0)
+		threads = 1;
+	for (unsigned int i = 0; i < threads; ++i)
+		_queues.push_back(std::make_unique<queue>());
+	for (unsigned int i = 0; i < threads; ++i)
+		_threads.emplace_back(&thread_pool::work, this, i);
+}
+
+thread_pool::~thread_pool()
+{
+	{
+		std::lock_guard lock{ _mutex };
+		_stopping = true;
+	}
+	_start.notify_all();
+	for (auto& thread : _threads)
+		thread.join();
+}
+
+void thread_pool::parallel_for(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& body)
+{
+	if (count == 0)
+		return;
+	if (grain == 0)
+		grain = 1;
+	std::lock_guard loop{ _loop };
+	auto chunks = (count + grain - 1) / grain;
+	auto workers = _queues.size();
+	// Worker i starts with the i-th contiguous share of the chunks.
+	for (size_t i = 0; i < workers; ++i)
+	{
+		auto first = chunks * i / workers;
+		auto last = chunks * (i + 1) / workers;
+		std::lock_guard lock{ _queues[i]->mutex };
+		for (auto chunk = first; chunk < last; ++chunk)
+			_queues[i]->ranges.push_back({ chunk * grain, std::min(count, (chunk + 1) * grain) });
+	}
+	std::unique_lock lock{ _mutex };
+	_body = &body;
+	_exception = nullptr;
+	_busy = workers;
+	++_generation;
+	_start.notify_all();
+	_done.wait(lock, [this] { return _busy == 0; });
+	_body = nullptr;
+	if (_exception)
+		std::rethrow_exception(_exception);
+}
+
+void thread_pool::work(unsigned int index)
+{
+	size_t generation{ 0 };
+	for (;;)
+	{
+		const std::function<void(size_t, size_t)>* body;
+		{
+			std::unique_lock lock{ _mutex };
+			_start.wait(lock, [&] { return _stopping || _generation != generation; });
+			if (_stopping)
+				return;
+			generation = _generation;
+			body = _body;
+		}
+		range chunk;
+		while (take(index, chunk))
+		{
+			try
+			{
+				(*body)(chunk.begin, chunk.end);
+			}
+			catch (...)
+			{
+				std::lock_guard lock{ _mutex };
+				if (!_exception)
+					_exception = std::current_exception();
+			}
+		}
+		std::lock_guard lock{ _mutex };
+		if (--_busy == 0)
+			_done.notify_one();
+	}
+}
+
+bool thread_pool::take(unsigned int index, range& chunk)
+{
+	{
+		auto& own = *_queues[index];
+		std::lock_guard lock{ own.mutex };
+		if (!own.ranges.empty())
+		{
+			chunk = own.ranges.back();
+			own.ranges.pop_back();
+			return true;
+		}
+	}
+	// No new chunks are queued during a loop, so one pass over the other
+	// queues finds whatever is left.
+	auto workers = _queues.size();
+	for (size_t i = 1; i < workers; ++i)
+	{
+		auto& victim = *_queues[(index + i) % workers];
+		std::lock_guard lock{ victim.mutex };
+		if (!victim.ranges.empty())
+		{
+			chunk = victim.ranges.front();
+			victim.ranges.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
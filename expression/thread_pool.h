@@ -0,0 +1,59 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads that run parallel loops. A loop is split into
+// chunks, and every worker starts with a contiguous share of them in its own
+// queue. Workers take chunks from the back of their own queue and, once it is
+// empty, steal from the front of the others, so uneven chunks balance out
+// without a shared queue every worker contends on.
+class thread_pool
+{
+public:
+	// 0 threads means one per hardware thread.
+	explicit thread_pool(unsigned int threads = 0);
+	thread_pool(const thread_pool&) = delete;
+	thread_pool& operator=(const thread_pool&) = delete;
+	~thread_pool();
+	unsigned int size() const
+	{
+		return static_cast<unsigned int>(_threads.size());
+	}
+	// Calls body(begin, end) for chunks of at most grain indices that cover
+	// [0, count), and returns when all calls have returned. The first
+	// exception a call throws is rethrown here once the others are done.
+	// One loop runs at a time.
+	void parallel_for(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& body);
+private:
+	struct range
+	{
+		size_t begin;
+		size_t end;
+	};
+	struct alignas(64) queue
+	{
+		std::mutex mutex;
+		std::deque<range> ranges;
+	};
+	std::vector<std::thread> _threads;
+	std::vector<std::unique_ptr<queue>> _queues;
+	std::mutex _mutex;                     // guards the fields below
+	std::condition_variable _start;
+	std::condition_variable _done;
+	std::mutex _loop;                      // held while a loop runs
+	const std::function<void(size_t, size_t)>* _body{ nullptr };
+	std::exception_ptr _exception;
+	size_t _generation{ 0 };
+	size_t _busy{ 0 };                     // workers still in the current loop
+	bool _stopping{ false };
+	void work(unsigned int index);
+	bool take(unsigned int index, range& chunk);
+};
@@ -39,7 +39,10 @@ enum class token_kind : unsigned int
 	OR_EQ = 33,
 	XOR = 34,
 	XOR_EQ = 35,
+	QUESTION = 36,
+	COLON = 37,
 	INT_LITERAL = 100,
+	NUMBER_LITERAL = 101,   // any number literal before the parser converts it
 	UNSIGNED_INT_LITERAL = 102,
 	LONG_LITERAL = 103,
 	UNSIGNED_LONG_LITERAL = 104,
@@ -48,6 +51,7 @@ enum class token_kind : unsigned int
 	FLOAT_LITERAL = 107,
 	DOUBLE_LITERAL = 108,
 	STRING_LITERAL = 109,
+	IDENTIFIER = 110,
 	INVALID_CHARACTER = 200,
 	END_OF_FILE = 300,
 };
@@ -58,8 +62,26 @@ using token_value = std::variant<bool, char, unsigned char, short, unsigned shor
 struct token 
 {
 	token_kind kind;
-	size_t    line;	  // token line (starts at 1)
-	size_t    column;	  // token column (starts at 1)
-	token_value value;
-	std::string str;
-};
\ No newline at end of file
+	size_t    line{ 0 };	  // token line (starts at 1)
+	size_t    column{ 0 };	  // token column (starts at 1)
+	token_value value{};
+	size_t    offset{ 0 };	  // start of the token text in the source
+	size_t    length{ 0 };	  // length of the token text
+};
+
+// Index of T among the alternatives of token_value.
+template <typename T>
+constexpr size_t value_index = token_value{ T{} }.index();
+
+constexpr size_t value_type_count = std::variant_size_v<token_value>;
+
+// Alternative of token_value with index I.
+template <size_t I>
+using value_t = std::variant_alternative_t<I, token_value>;
+
+// Type index of a value whose type is only known when the expression is evaluated.
+constexpr size_t dynamic_type = value_type_count;
+
+// Names of the alternatives of token_value, for diagnostics.
+constexpr const char* value_type_names[value_type_count] = { "bool", "char", "unsigned char", "short",
+	"unsigned short", "int", "unsigned int", "long", "unsigned long", "long long", "unsigned long long", "float", "double" };
@@ -0,0 +1,36 @@
+#include "variables.h"
+
+size_t variables::declare(std::string_view name, size_t type)
+{
+	size_t slot;
+	if (find(name, slot))
+	{
+		if (type != dynamic_type)
+			_types[slot] = type;
+		return slot;
+	}
+	slot = _names.size();
+	_slots.emplace(name, slot);
+	_names.emplace_back(name);
+	_types.push_back(type);
+	return slot;
+}
+
+bool variables::resolve(std::string_view name, size_t& slot)
+{
+	if (find(name, slot))
+		return true;
+	if (_sealed)
+		return false;
+	slot = declare(name);
+	return true;
+}
+
+bool variables::find(std::string_view name, size_t& slot) const
+{
+	auto iter = _slots.find(name);
+	if (iter == _slots.end())
+		return false;
+	slot = iter->second;
+	return true;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "token.h"
+
+// Maps variable names to slots. Identifiers are resolved to their slot when an
+// expression is compiled, so evaluation reads the value from a flat array and
+// never looks up a name. Several expressions compiled against the same table
+// share one slot layout.
+//
+// A variable can be declared with the type index of its values. The optimizer
+// relies on it, and evaluation reports values of any other type as an error.
+class variables
+{
+public:
+	variables() = default;
+	variables(std::initializer_list<std::string> names)
+	{
+		for (const auto& name : names)
+			declare(name);
+	}
+	size_t declare(std::string_view name, size_t type = dynamic_type);
+	bool resolve(std::string_view name, size_t& slot);
+	bool find(std::string_view name, size_t& slot) const;
+	// Once sealed, unknown identifiers are compile errors instead of new slots.
+	void seal()
+	{
+		_sealed = true;
+	}
+	bool sealed() const
+	{
+		return _sealed;
+	}
+	size_t size() const
+	{
+		return _names.size();
+	}
+	const std::string& name(size_t slot) const
+	{
+		return _names[slot];
+	}
+	size_t type(size_t slot) const
+	{
+		return _types[slot];
+	}
+private:
+	// Looks names up by string_view, so resolving an identifier in the source
+	// does not copy it.
+	struct name_hash
+	{
+		using is_transparent = void;
+		size_t operator()(std::string_view name) const
+		{
+			return std::hash<std::string_view>{}(name);
+		}
+	};
+	std::unordered_map<std::string, size_t, name_hash, std::equal_to<>> _slots;
+	std::vector<std::string> _names;
+	std::vector<size_t> _types;
+	bool _sealed{ false };
+};
@@ -0,0 +1,134 @@
+#include <iostream>
+
+#include "profile.h"
+#include "vm.h"
+
+bool vm::execute(const bytecode& program, token_value& value, std::span<const token_value> slots)
+{
+	auto result = run(program, value, slots);
+	if (!_own_diagnostics.empty())
+	{
+		_own_diagnostics.write(std::cerr, {});
+		_own_diagnostics.clear();
+	}
+	return result;
+}
+
+bool vm::run(const bytecode& program, token_value& value, std::span<const token_value> slots)
+{
+	if (program.code().empty())
+		return false;
+	if (!check_slot_values(program.slot_types(), program.slot_positions(), slots.size(),
+		[&slots](size_t slot) { return slots[slot].index(); }, *_diagnostics))
+		return false;
+	if (_registers.size() < program.register_count())
+		_registers.resize(program.register_count());
+	_program = &program;
+	_errors = 0;
+	auto registers = _registers.data();
+	auto constants = program.constants().data();
+	auto code = program.code().data();
+	auto lowered = program.lowered().data();
+	_ip = code;
+
+#if EXPRESSION_COMPUTED_GOTO
+	static void* const dispatch_table[] =
+	{
+#define X(name) &&name##_label,
+		EXPRESSION_OPCODES
+#undef X
+	};
+#define OPCODE(name) name##_label
+#define DISPATCH() goto *dispatch_table[static_cast<size_t>(_ip->op)]
+#define NEXT() { ++_ip; DISPATCH(); }
+#define JUMP() { _ip = code + _ip->b; DISPATCH(); }
+	DISPATCH();
+#else
+#define OPCODE(name) case opcode::name
+#define NEXT() { ++_ip; continue; }
+#define JUMP() { _ip = code + _ip->b; continue; }
+	for (;;)
+	switch (_ip->op)
+	{
+#endif
+	OPCODE(LOAD_CONST):
+		registers[_ip->dst] = constants[_ip->a];
+		NEXT();
+	OPCODE(LOAD_VAR):
+		registers[_ip->dst] = slots[_ip->a];
+		NEXT();
+	OPCODE(MOVE):
+		registers[_ip->dst] = registers[_ip->a];
+		NEXT();
+	// Instructions whose operand types are known call their lowered operator,
+	// the others visit the operand variants.
+#define APPLY(kind, member, left, right) \
+	EXPRESSION_PROFILE_BINARY(token_kind::kind, (left).index(), (right).index(), _errors); \
+	if (auto operation = lowered[_ip - code]) \
+		apply(operation, left, right, registers[_ip->dst]); \
+	else \
+		registers[_ip->dst] = member(left, right);
+#define X(name, member, kind) \
+	OPCODE(name): \
+		{ APPLY(kind, member, registers[_ip->a], registers[_ip->b]) } \
+		NEXT(); \
+	OPCODE(name##_K): \
+		{ APPLY(kind, member, registers[_ip->a], constants[_ip->b]) } \
+		NEXT(); \
+	OPCODE(name##_VK): \
+		{ APPLY(kind, member, slots[_ip->a], constants[_ip->b]) } \
+		NEXT();
+	EXPRESSION_BINARY_OPERATIONS(X)
+#undef X
+#define X(name, member, kind) \
+	OPCODE(name): \
+		{ \
+			EXPRESSION_PROFILE_UNARY(token_kind::kind, registers[_ip->a].index(), _errors); \
+			if (auto operation = lowered[_ip - code]) \
+				apply(operation, registers[_ip->a], registers[_ip->a], registers[_ip->dst]); \
+			else \
+				registers[_ip->dst] = member(registers[_ip->a]); \
+		} \
+		NEXT();
+	EXPRESSION_UNARY_OPERATIONS(X)
+#undef X
+#undef APPLY
+	OPCODE(JUMP):
+		JUMP();
+	OPCODE(JUMP_IF_FALSE):
+		if (!truth(registers[_ip->a]))
+			JUMP();
+		NEXT();
+	// Operands && and || are not defined for are left to the operator.
+	OPCODE(AND_JUMP):
+		if (is_logical_type(registers[_ip->a].index()) && !truth(registers[_ip->a]))
+		{
+			registers[_ip->dst] = false;
+			JUMP();
+		}
+		NEXT();
+	OPCODE(OR_JUMP):
+		if (is_logical_type(registers[_ip->a].index()) && truth(registers[_ip->a]))
+		{
+			registers[_ip->dst] = true;
+			JUMP();
+		}
+		NEXT();
+	OPCODE(RETURN):
+		value = registers[_ip->a];
+		return _errors == 0;
+#if !EXPRESSION_COMPUTED_GOTO
+	}
+#endif
+#undef OPCODE
+#undef DISPATCH
+#undef NEXT
+#undef JUMP
+}
+
+void vm::error(const char* message)
+{
+	const auto& position = _program->position(_ip - _program->code().data());
+	_diagnostics->add(message, position.line, position.column);
+	_errors++;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <span>
+#include <vector>
+
+#include "bytecode.h"
+#include "diagnostics.h"
+#include "operations.h"
+
+#if defined(__GNUC__) || defined(__clang__)
+#define EXPRESSION_COMPUTED_GOTO 1
+#else
+#define EXPRESSION_COMPUTED_GOTO 0
+#endif
+
+// Executes bytecode. The vm owns the register file, so one vm per thread can
+// run any number of programs; the programs themselves are never modified.
+class vm : public operations
+{
+public:
+	bool execute(const bytecode& program, token_value& value, std::span<const token_value> slots = {});
+	// Where errors are recorded, unless set a buffer of the vm's own that is
+	// written to std::cerr after each evaluation. A buffer the thread owns
+	// keeps evaluations with errors from contending on a shared stream.
+	void set_diagnostics(diagnostic_buffer& diagnostics)
+	{
+		_diagnostics = &diagnostics;
+	}
+protected:
+	void error(const char* message) override;
+private:
+	std::vector<token_value> _registers;
+	diagnostic_buffer _own_diagnostics;
+	diagnostic_buffer* _diagnostics{ &_own_diagnostics };
+	const bytecode* _program{ nullptr };
+	const instruction* _ip{ nullptr };
+	unsigned int _errors{ 0 };
+	bool run(const bytecode& program, token_value& value, std::span<const token_value> slots);
+	void apply(typed_operation operation, const token_value& left, const token_value& right, token_value& result)
+	{
+		if (auto message = operation(left, right, result))
+			error(message);
+	}
+};
@@ -0,0 +1,237 @@
+#include <algorithm>
+#include <iterator>
+
+#include "operations.h"
+#include "workload.h"
+
+namespace
+{
+	struct operator_spelling
+	{
+		token_kind kind;
+		const char* text;
+	};
+
+	constexpr operator_spelling binary_operators[] = {
+		{ token_kind::STAR, "*" }, { token_kind::SLASH, "/" }, { token_kind::PERCENT, "%" },
+		{ token_kind::PLUS, "+" }, { token_kind::DASH, "-" }, { token_kind::LESS_LESS, "<<" },
+		{ token_kind::GREATER_GREATER, ">>" }, { token_kind::LESS, "<" }, { token_kind::LESS_EQUAL, "<=" },
+		{ token_kind::GREATER, ">" }, { token_kind::GREATER_EQUAL, ">=" }, { token_kind::EQUAL_EQUAL, "==" },
+		{ token_kind::EXCLAIM_EQUAL, "!=" }, { token_kind::AMP, "&" }, { token_kind::CARET, "^" },
+		{ token_kind::BAR, "|" }, { token_kind::AMP_AMP, "&&" }, { token_kind::BAR_BAR, "||" },
+	};
+
+	constexpr operator_spelling unary_operators[] = {
+		{ token_kind::DASH, "-" }, { token_kind::TILDE, "~" }, { token_kind::EXCLAIM, "!" },
+	};
+
+	// Literal suffix and variable name of the types number literals can have.
+	struct literal_type
+	{
+		size_t type;
+		const char* suffix;
+		const char* variable;
+	};
+
+	constexpr literal_type literal_types[] = {
+		{ value_index<int>, "", "i" },
+		{ value_index<unsigned int>, "u", "u" },
+		{ value_index<long>, "l", "l" },
+		{ value_index<unsigned long>, "ul", "ul" },
+		{ value_index<long long>, "ll", "ll" },
+		{ value_index<unsigned long long>, "ull", "ull" },
+		{ value_index<float>, "f", "f" },
+		{ value_index<double>, "", "d" },
+	};
+
+	const literal_type& find_literal_type(size_t type)
+	{
+		for (const auto& entry : literal_types)
+			if (entry.type == type)
+				return entry;
+		return literal_types[0];
+	}
+
+	bool is_floating(size_t type)
+	{
+		return type == value_index<float> || type == value_index<double>;
+	}
+
+	// Operators whose right operand the generator writes as a literal: a
+	// positive divisor, or a shift count smaller than the width of any type.
+	bool takes_literal(token_kind op)
+	{
+		return op == token_kind::SLASH || op == token_kind::PERCENT
+			|| op == token_kind::LESS_LESS || op == token_kind::GREATER_GREATER;
+	}
+
+	token_value variable_value(size_t type)
+	{
+		switch (type)
+		{
+		case value_index<unsigned int>: return 7u;
+		case value_index<long>: return -7l;
+		case value_index<unsigned long>: return 11ul;
+		case value_index<long long>: return 13ll;
+		case value_index<unsigned long long>: return 17ull;
+		case value_index<float>: return 1.5f;
+		case value_index<double>: return -2.25;
+		default: return 5;
+		}
+	}
+}
+
+workload_generator::workload_generator(const workload_options& options) : _options{ options }, _random{ options.seed }
+{
+	_options.width = std::max(_options.width, 2u);
+	if (_options.operators.empty())
+		for (const auto& entry : binary_operators)
+			_options.operators.emplace_back(entry.kind, 1.0);
+	if (_options.types.empty())
+		_options.types = { { value_index<int>, 1.0 }, { value_index<double>, 1.0 } };
+	std::vector<double> weights;
+	for (const auto& [op, weight] : _options.operators)
+		weights.push_back(weight);
+	_operator_choice = { weights.begin(), weights.end() };
+	weights.clear();
+	for (const auto& [type, weight] : _options.types)
+	{
+		weights.push_back(weight);
+		_names.emplace_back(find_literal_type(type).variable);
+		_values.push_back(variable_value(type));
+	}
+	_type_choice = { weights.begin(), weights.end() };
+}
+
+std::string workload_generator::expression()
+{
+	size_t type;
+	return generate(_options.depth, type);
+}
+
+std::string workload_generator::file(size_t count)
+{
+	std::string text;
+	for (size_t i{ 0 }; i < count; i++)
+	{
+		text += expression();
+		text += '\n';
+	}
+	return text;
+}
+
+void workload_generator::declare(variables& variables) const
+{
+	for (size_t i{ 0 }; i < _names.size(); i++)
+		variables.declare(_names[i], _values[i].index());
+}
+
+size_t workload_generator::type_index(std::string_view name)
+{
+	for (const auto& entry : literal_types)
+		if (name == value_type_names[entry.type])
+			return entry.type;
+	return dynamic_type;
+}
+
+const char* workload_generator::type_name(size_t type)
+{
+	return type < value_type_count ? value_type_names[type] : "dynamic";
+}
+
+bool workload_generator::binary_operator(std::string_view text, token_kind& op)
+{
+	for (const auto& entry : binary_operators)
+		if (text == entry.text)
+		{
+			op = entry.kind;
+			return true;
+		}
+	return false;
+}
+
+const char* workload_generator::spelling(token_kind op)
+{
+	for (const auto& entry : binary_operators)
+		if (entry.kind == op)
+			return entry.text;
+	return "?";
+}
+
+std::string workload_generator::generate(unsigned int depth, size_t& type)
+{
+	if (depth == 0)
+		return operand(type);
+	auto text{ generate(depth - 1, type) };
+	for (unsigned int i{ 1 }; i < _options.width; i++)
+	{
+		auto op{ _options.operators[_operator_choice(_random)].first };
+		size_t right_type;
+		std::string right;
+		if (takes_literal(op))
+		{
+			right_type = _options.types[_type_choice(_random)].first;
+			right = literal(right_type, true);
+		}
+		else
+			right = generate(depth - 1, right_type);
+		size_t result;
+		if (!operations::binary_type(op, type, right_type, result) && !choose_operator(type, right_type, op, result))
+		{
+			op = token_kind::PLUS;
+			operations::binary_type(op, type, right_type, result);
+		}
+		text = '(' + text + ' ' + spelling(op) + ' ' + right + ')';
+		type = result;
+	}
+	return text;
+}
+
+std::string workload_generator::operand(size_t& type)
+{
+	std::uniform_real_distribution<double> share;
+	auto index{ _type_choice(_random) };
+	type = _options.types[index].first;
+	auto variable{ share(_random) < _options.variable_share };
+	auto text{ variable ? _names[index] : literal(type, false) };
+	if (share(_random) < _options.unary_share)
+	{
+		std::uniform_int_distribution<size_t> choice{ 0, std::size(unary_operators) - 1 };
+		const auto& op{ unary_operators[choice(_random)] };
+		size_t result;
+		if (operations::unary_type(op.kind, type, result))
+		{
+			type = result;
+			return op.text + text;
+		}
+	}
+	return text;
+}
+
+std::string workload_generator::literal(size_t type, bool divisor)
+{
+	const auto& literal_type{ find_literal_type(type) };
+	if (is_floating(type))
+	{
+		std::uniform_int_distribution<int> units{ divisor ? 1 : 0, 999 };
+		std::uniform_int_distribution<int> hundredths{ 0, 99 };
+		auto h{ hundredths(_random) };
+		return std::to_string(units(_random)) + (h < 10 ? ".0" : ".") + std::to_string(h) + literal_type.suffix;
+	}
+	std::uniform_int_distribution<int> value{ divisor ? 2 : 0, divisor ? 7 : 999 };
+	return std::to_string(value(_random)) + literal_type.suffix;
+}
+
+// Chooses an operator among the weighted ones that is defined for the operand
+// types and does not need a literal right operand.
+bool workload_generator::choose_operator(size_t left, size_t right, token_kind& op, size_t& type)
+{
+	std::vector<double> weights;
+	for (const auto& [kind, weight] : _options.operators)
+		weights.push_back(!takes_literal(kind) && operations::binary_type(kind, left, right, type) ? weight : 0.0);
+	if (std::none_of(weights.begin(), weights.end(), [](double weight) { return weight > 0.0; }))
+		return false;
+	std::discrete_distribution<size_t> choice{ weights.begin(), weights.end() };
+	op = _options.operators[choice(_random)].first;
+	return operations::binary_type(op, left, right, type);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "token.h"
+#include "variables.h"
+
+// Shape of the random expressions a workload_generator writes.
+struct workload_options
+{
+	unsigned int depth{ 3 };          // levels of operators above the operands
+	unsigned int width{ 2 };          // operands each level combines, at least 2
+	double variable_share{ 0.3 };     // share of operands that are variables
+	double unary_share{ 0.1 };        // share of operands with a unary operator
+	// Binary operators and their relative weights; all of them alike if empty.
+	std::vector<std::pair<token_kind, double>> operators;
+	// Value types of literals and variables and their relative weights; int
+	// and double alike if empty.
+	std::vector<std::pair<size_t, double>> types;
+	std::uint64_t seed{ 1 };
+};
+
+// Writes random expressions that compile. Operators are chosen among those
+// defined for the types of their operands, so the mix is what the options
+// ask for where the types allow it. Divisors are positive literals, so
+// evaluation does not trap on an integer division by zero.
+class workload_generator
+{
+public:
+	explicit workload_generator(const workload_options& options);
+	std::string expression();
+	// count expressions, one per line.
+	std::string file(size_t count);
+	// Declares the variables the expressions use, one for each type.
+	void declare(variables& variables) const;
+	// Values of the variables in the order declare declares them.
+	const std::vector<token_value>& values() const
+	{
+		return _values;
+	}
+	// Options with the defaults of empty operator and type lists filled in.
+	const workload_options& options() const
+	{
+		return _options;
+	}
+	// Type index of the literal type name, as in "unsigned long", or
+	// dynamic_type if it has no literals.
+	static size_t type_index(std::string_view name);
+	static const char* type_name(size_t type);
+	// Binary operator with the spelling text, as in "<<".
+	static bool binary_operator(std::string_view text, token_kind& op);
+	static const char* spelling(token_kind op);
+private:
+	workload_options _options;
+	std::mt19937_64 _random;
+	std::discrete_distribution<size_t> _operator_choice;
+	std::discrete_distribution<size_t> _type_choice;
+	std::vector<std::string> _names;
+	std::vector<token_value> _values;
+	std::string generate(unsigned int depth, size_t& type);
+	std::string operand(size_t& type);
+	std::string literal(size_t type, bool divisor);
+	bool choose_operator(size_t left, size_t right, token_kind& op, size_t& type);
+};
@@ -0,0 +1,89 @@
+// deep_expression_test.cpp : Compiles and evaluates expressions a million
+// operators deep with the vm, the jit and the incremental evaluator, which
+// must neither run out of stack nor compute other values than the tree.
+//
+// deep_expression_test [depth]
+
+#include <charconv>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+#include "compiled_expression.h"
+#include "incremental_evaluator.h"
+#include "jit.h"
+#include "variables.h"
+
+namespace
+{
+	unsigned int failures{ 0 };
+
+	void check(bool condition, std::string_view name, std::string_view what)
+	{
+		if (condition)
+			return;
+		std::cerr << name << ": " << what << std::endl;
+		failures++;
+	}
+
+	// Evaluates source, whose value for x is expected(x), with every evaluator.
+	template <typename F>
+	void test(std::string_view name, const std::string& source, F expected)
+	{
+		variables variables;
+		variables.declare("x", value_index<int>);
+		diagnostic_buffer diagnostics;
+		auto expression = compiled_expression::compile(source, variables, diagnostics);
+		check(expression != nullptr, name, "does not compile");
+		if (!expression)
+			return;
+		const token_value slots[] = { 1 };
+		token_value value;
+		check(expression->tree().evaluate(value, slots) && value == expected(1), name, "tree value differs");
+
+		evaluation_context context;
+		check(expression->evaluate(value, slots, context) && value == expected(1), name, "vm value differs");
+
+		jit jit;
+		jit.compile(expression->tree());
+		check(jit.evaluate(value, slots) && value == expected(1), name, "jit value differs");
+
+		incremental_evaluator incremental{ expression->tree() };
+		incremental.set_diagnostics(diagnostics);
+		check(incremental.reset(slots) && incremental.evaluate(value) && value == expected(1), name,
+			"incremental value differs");
+		check(incremental.set(0, 2) && incremental.evaluate(value) && value == expected(2), name,
+			"incremental value differs after a change");
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	int depth{ 1000000 };
+	if (argc > 1)
+	{
+		std::string_view text{ argv[1] };
+		auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), depth);
+		if (error != std::errc{} || end != text.data() + text.size() || depth < 1)
+		{
+			std::cerr << "Invalid depth " << text << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	std::string sum{ "x" };
+	std::string all{ "x > 0" };
+	for (int i = 1; i < depth; ++i)
+	{
+		sum += " + x";
+		all += " && x > 0";
+	}
+	test("sum", sum, [depth](int x) { return token_value{ depth * x }; });
+	test("logical", all, [](int) { return token_value{ true }; });
+
+	if (failures != 0)
+		return EXIT_FAILURE;
+	std::cout << "Expressions " << depth << " operators deep evaluate as the tree does" << std::endl;
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,269 @@
+// differential_test.cpp : Evaluates generated and hand-written expressions
+// with every evaluator and checks the values and errors against those of the
+// tree as written, which the optimizer did not rewrite and whose operators
+// are not lowered: the optimized tree, the vm, the jit, the incremental
+// evaluator and batch. Every variable takes a range of values, one per row of
+// columns that span several batches, and batch runs under every instruction
+// set the processor has.
+//
+// differential_test [count]
+//   count   expressions generated per workload (100)
+
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "batch.h"
+#include "bytecode.h"
+#include "expression_tree.h"
+#include "incremental_evaluator.h"
+#include "jit.h"
+#include "parser.h"
+#include "simd.h"
+#include "variables.h"
+#include "vm.h"
+#include "workload.h"
+
+namespace
+{
+	// Two batches and part of a third.
+	constexpr size_t row_count = 2 * batch_size + 37;
+
+	constexpr instruction_set instruction_sets[] = {
+		instruction_set::SCALAR, instruction_set::SSE42, instruction_set::AVX2, instruction_set::AVX512 };
+	constexpr const char* batch_names[] = { "batch scalar", "batch sse4.2", "batch avx2", "batch avx512" };
+
+	unsigned int failures{ 0 };
+
+	// The first differences are written in full, the others only counted.
+	void mismatch(std::string_view source, std::string_view evaluator, size_t row)
+	{
+		if (failures++ < 20)
+			std::cerr << evaluator << " differs from the tree in row " << row << " of " << source << std::endl;
+	}
+
+	// Same type and bits, or both NaN.
+	bool same_value(const token_value& a, const token_value& b)
+	{
+		if (a.index() != b.index())
+			return false;
+		return std::visit([&b](auto value)
+		{
+			auto other = std::get<decltype(value)>(b);
+			if constexpr (std::is_floating_point_v<decltype(value)>)
+			{
+				if (std::isnan(value) && std::isnan(other))
+					return true;
+			}
+			return std::memcmp(&value, &other, sizeof(value)) == 0;
+		}, a);
+	}
+
+	// The values of the variables in every row, around the values they start
+	// from, as slots and as columns.
+	class rows
+	{
+	public:
+		explicit rows(std::span<const token_value> values) : _slots(row_count)
+		{
+			_storage.reserve(values.size());
+			for (const auto& value : values)
+			{
+				std::visit([this](auto start)
+				{
+					using T = decltype(start);
+					auto& storage = _storage.emplace_back(row_count);
+					auto data = reinterpret_cast<T*>(storage.data());
+					for (size_t row = 0; row < row_count; ++row)
+					{
+						data[row] = static_cast<T>(start + static_cast<T>(row % 11) - static_cast<T>(5));
+						_slots[row].push_back(data[row]);
+					}
+					_columns.emplace_back(std::span<const T>{ data, row_count });
+				}, value);
+			}
+		}
+		std::span<const token_value> slots(size_t row) const
+		{
+			return _slots[row];
+		}
+		std::span<const column> columns() const
+		{
+			return _columns;
+		}
+	private:
+		std::vector<std::vector<token_value>> _slots;
+		std::vector<std::vector<std::uint64_t>> _storage;   // a value of any type per row
+		std::vector<column> _columns;
+	};
+
+	class tester
+	{
+	public:
+		tester()
+		{
+			_vm.set_diagnostics(_diagnostics);
+			_batch.set_diagnostics(_diagnostics);
+		}
+		void test(std::string_view source, variables& variables, const rows& rows)
+		{
+			expression_tree reference;
+			expression_tree tree;
+			_parser.set_diagnostics(_diagnostics);
+			_parser.reset(source);
+			_parser.set_optimize(false);
+			auto compiled = _parser.compile(reference, variables);
+			_parser.reset(source);
+			_parser.set_optimize(true);
+			compiled = _parser.compile(tree, variables) && compiled;
+			_diagnostics.clear();
+			if (!compiled)
+			{
+				mismatch(source, "compile", 0);
+				return;
+			}
+			bytecode program;
+			program.compile(tree);
+			jit jit;
+			jit.compile(tree);
+			incremental_evaluator incremental{ tree };
+			incremental.set_diagnostics(_diagnostics);
+			incremental.reset(rows.slots(0));
+
+			std::vector<token_value> expected(row_count);
+			std::vector<bool> succeeded(row_count);
+			auto all_succeeded{ true };
+			for (size_t row = 0; row < row_count; ++row)
+			{
+				auto slots = rows.slots(row);
+				succeeded[row] = reference.evaluate(expected[row], slots, _diagnostics);
+				all_succeeded = all_succeeded && succeeded[row];
+				auto check = [&](std::string_view evaluator, bool ok, const token_value& value)
+				{
+					if (ok != succeeded[row] || (ok && !same_value(value, expected[row])))
+						mismatch(source, evaluator, row);
+				};
+				token_value value;
+				check("optimized tree", tree.evaluate(value, slots, _diagnostics), value);
+				check("vm", _vm.execute(program, value, slots), value);
+				check("jit", jit.evaluate(value, slots, _diagnostics), value);
+				for (size_t slot = 0; slot < tree.slot_count(); ++slot)
+					incremental.set(slot, slots[slot]);
+				check("incremental", incremental.evaluate(value), value);
+				_diagnostics.clear();
+			}
+
+			for (size_t i = 0; i < std::size(instruction_sets) && instruction_sets[i] <= _widest; ++i)
+			{
+				limit_simd_instruction_set(instruction_sets[i]);
+				result_column result;
+				if (_batch.execute(program, rows.columns(), result) != all_succeeded)
+					mismatch(source, batch_names[i], 0);
+				for (size_t row = 0; row < row_count && row < result.size(); ++row)
+				{
+					if (succeeded[row] && !same_value(result.value(row), expected[row]))
+						mismatch(source, batch_names[i], row);
+				}
+				_diagnostics.clear();
+			}
+			limit_simd_instruction_set(_widest);
+		}
+	private:
+		const instruction_set _widest{ simd_instruction_set() };
+		parser _parser;
+		vm _vm;
+		batch _batch;
+		diagnostic_buffer _diagnostics;
+	};
+
+	// Operands && and || and conditionals skip, whose errors only the rows
+	// that evaluate them report, and divisions and shifts that fail in some rows.
+	constexpr const char* guards[] = {
+		"n >= 0 && (1 << n) > 4",
+		"n < 0 || (1 << n) > 4",
+		"n < 0 ? 0 : 1 << n",
+		"n >= 0 ? 1 << n : -1",
+		"n != 0 && 60 / n > 2",
+		"n == 0 ? 0 : 60 % n",
+		"n > 0 ? (n > 2 ? 1 << (n - 3) : 5) : (n < -2 ? 7 : 1 << -n)",
+		"n > 10 && (1 << -1) > 0 || n < 10",
+		"!(n > 2) || (n << 28) > 0",
+		"n >= 0 && n < 3 ? n >> n : ((n > 0 || -n >= 0) && n != 0 ? 1 : 0)",
+		"(n > 0 ? 1 << -n : 0) + 1",
+		"n > 0 && 1 << -n",
+		"n > 0 || 1.5",
+		"n < 0 && 1.5",
+		"60 / n + 60 % n",
+		"(n - 2147483647 - 1) / (n - 1)",
+		"n-1 > -n -2 ? n+1 : 2-n",
+		"1 << (n + 28)",
+		"n << n * 7 | 5ll >> (n + 60)",
+		"n > 3 ? n : n >> 40",
+	};
+}
+
+int main(int argc, char* argv[])
+{
+	size_t count{ 100 };
+	if (argc > 1)
+	{
+		std::string_view text{ argv[1] };
+		auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), count);
+		if (error != std::errc{} || end != text.data() + text.size())
+		{
+			std::cerr << "Invalid count " << text << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+	tester tester;
+
+	variables guard_variables;
+	guard_variables.declare("n", value_index<int>);
+	const token_value guard_values[] = { 0 };
+	rows guard_rows{ guard_values };
+	for (auto source : guards)
+		tester.test(source, guard_variables, guard_rows);
+
+	std::vector<workload_options> workloads(4);
+	workloads[1].types = { { value_index<int>, 2.0 }, { value_index<unsigned int>, 1.0 }, { value_index<long>, 1.0 },
+		{ value_index<long long>, 1.0 }, { value_index<unsigned long long>, 1.0 } };
+	workloads[1].operators = { { token_kind::LESS_LESS, 2.0 }, { token_kind::GREATER_GREATER, 2.0 },
+		{ token_kind::SLASH, 1.0 }, { token_kind::PERCENT, 1.0 }, { token_kind::AMP, 1.0 }, { token_kind::BAR, 1.0 },
+		{ token_kind::CARET, 1.0 }, { token_kind::PLUS, 2.0 }, { token_kind::DASH, 2.0 }, { token_kind::STAR, 1.0 },
+		{ token_kind::LESS, 1.0 } };
+	workloads[1].depth = 4;
+	workloads[1].unary_share = 0.2;
+	workloads[2].types = { { value_index<float>, 1.0 }, { value_index<double>, 1.0 } };
+	workloads[2].operators = { { token_kind::PLUS, 2.0 }, { token_kind::DASH, 2.0 }, { token_kind::STAR, 2.0 },
+		{ token_kind::SLASH, 1.0 }, { token_kind::LESS_EQUAL, 1.0 }, { token_kind::GREATER, 1.0 },
+		{ token_kind::EXCLAIM_EQUAL, 1.0 } };
+	workloads[3].operators = { { token_kind::AMP_AMP, 2.0 }, { token_kind::BAR_BAR, 2.0 }, { token_kind::LESS, 1.0 },
+		{ token_kind::GREATER_EQUAL, 1.0 }, { token_kind::EQUAL_EQUAL, 1.0 }, { token_kind::PLUS, 1.0 } };
+	workloads[3].depth = 4;
+	for (size_t i = 0; i < workloads.size(); ++i)
+	{
+		workloads[i].seed = i + 1;
+		workload_generator generator{ workloads[i] };
+		variables variables;
+		generator.declare(variables);
+		variables.seal();
+		rows rows{ generator.values() };
+		for (size_t n = 0; n < count; ++n)
+			tester.test(generator.expression(), variables, rows);
+	}
+
+	if (failures != 0)
+	{
+		std::cerr << failures << " differences from the tree" << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::cout << "All evaluators agree with the tree" << std::endl;
+	return EXIT_SUCCESS;
+}
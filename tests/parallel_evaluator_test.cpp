@@ -0,0 +1,62 @@
+// parallel_evaluator_test.cpp : Evaluates a set of expressions, some of which
+// divide by zero, on several threads. The failing expressions must give
+// invalid results with their diagnostics, and all others their values.
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "parallel_evaluator.h"
+
+namespace
+{
+	unsigned int failures{ 0 };
+
+	void check(bool condition, size_t index, std::string_view what)
+	{
+		if (condition)
+			return;
+		std::cerr << "Expression " << index + 1 << ": " << what << std::endl;
+		failures++;
+	}
+}
+
+int main()
+{
+	// Several chunks of expressions, with a failing one in most of them.
+	constexpr size_t count = 1000;
+	const char* failing[] = { "1 / 0", "7 % 0", "(-2147483647 - 1) / -1", "(-2147483647 - 1) % -1" };
+	std::vector<std::string> expressions;
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (i % 50 == 7)
+			expressions.push_back(failing[i / 50 % std::size(failing)]);
+		else
+			expressions.push_back(std::to_string(i) + " / 3 + " + std::to_string(i) + " % 3");
+	}
+
+	parallel_evaluator evaluator{ 4 };
+	auto results = evaluator.evaluate(expressions);
+	check(results.size() == count, 0, "results are missing");
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const auto& result = results[i];
+		if (i % 50 == 7)
+		{
+			check(!result.valid, i, "is valid");
+			check(!result.diagnostics.empty() && result.diagnostics.front().id == diagnostic_id::EVALUATION_ERROR
+				&& result.diagnostics.front().line == i + 1, i, "has no evaluation error");
+			continue;
+		}
+		auto expected = static_cast<int>(i / 3 + i % 3);
+		check(result.valid && result.value == token_value{ expected } && result.diagnostics.empty(), i,
+			"value differs");
+	}
+
+	if (failures != 0)
+		return EXIT_FAILURE;
+	std::cout << "Expressions that fail leave the others to evaluate" << std::endl;
+	return EXIT_SUCCESS;
+}